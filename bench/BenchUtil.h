@@ -0,0 +1,370 @@
+#pragma once
+
+#include "EventLoop.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 压测程序共用的小工具, 客户端一律用阻塞socket, 不依赖库本身
+namespace bench
+{
+
+// 读取 --name value 形式的参数
+inline const char* getArg(int argc, char* argv[], const char* name, const char* def)
+{
+    for(int i = 1; i + 1 < argc; ++i)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return def;
+}
+
+inline long getIntArg(int argc, char* argv[], const char* name, long def)
+{
+    const char* v = getArg(argc, argv, name, nullptr);
+    return v ? atol(v) : def;
+}
+
+inline int64_t nowMicros()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+inline int64_t nowNanos()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline int64_t threadCpuMicros()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 阻塞连接127.0.0.1:port, 失败返回-1
+inline int connectLoopback(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        return -1;
+    }
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+// 阻塞连接Unix域流式socket, "@name"为abstract namespace, 失败返回-1
+inline int connectUnix(const std::string& path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        return -1;
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    size_t n = std::min(path.size(), sizeof addr.sun_path - 1);
+    memcpy(addr.sun_path, path.data(), n);
+    socklen_t len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n + 1);
+    if(!path.empty() && path[0] == '@')
+    {
+        addr.sun_path[0] = '\0';
+        --len;
+    }
+    if(::connect(fd, (sockaddr*)&addr, len) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline bool writeAll(int fd, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while(len > 0)
+    {
+        ssize_t n = ::write(fd, p, len);
+        if(n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+inline bool readAll(int fd, void* data, size_t len)
+{
+    char* p = static_cast<char*>(data);
+    while(len > 0)
+    {
+        ssize_t n = ::read(fd, p, len);
+        if(n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 在每个loop线程里读取该线程累计的CPU时间(us)
+inline std::vector<int64_t> loopCpuMicros(const std::vector<EventLoop*>& loops)
+{
+    std::vector<std::shared_ptr<std::promise<int64_t>>> promises;
+    for(EventLoop* loop : loops)
+    {
+        auto p = std::make_shared<std::promise<int64_t>>();
+        promises.push_back(p);
+        loop->runInLoop([p]() { p->set_value(threadCpuMicros()); });
+    }
+    std::vector<int64_t> result;
+    for(auto& p : promises)
+    {
+        result.push_back(p->get_future().get());
+    }
+    return result;
+}
+
+/**
+ * HDR风格的延迟直方图: 小于2^kSubBits的值精确记录, 更大的值按2的幂分段,
+ * 每段线性分成2^(kSubBits-1)格, 相对误差不超过1/64. 内存固定, 记录O(1), 可以合并.
+ * 每个线程各用一个, 结束后merge
+ * 与库里的StatsHistogram分开: 那个常驻在每个loop上, 桶是原子的、精度1/8以节省内存;
+ * 这里记录在客户端热循环里, 用普通计数, 精度要够比较不同版本之间几个百分点的尾延迟差异
+ */
+class Histogram
+{
+public:
+    static const int kSubBits = 7;
+
+    Histogram() : counts_(kHalf * (64 - kSubBits + 2), 0), count_(0), sum_(0), max_(0) {}
+
+    void record(int64_t value)
+    {
+        uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+        ++counts_[indexOf(v)];
+        ++count_;
+        sum_ += v;
+        max_ = std::max(max_, v);
+    }
+
+    void merge(const Histogram& other)
+    {
+        for(size_t i = 0; i < counts_.size(); ++i)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ == 0 ? 0 : static_cast<double>(sum_) / count_; }
+
+    /// p取0~1, 返回不小于该比例样本的值(所在格的上界, 不超过max)
+    uint64_t percentile(double p) const
+    {
+        if(count_ == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count_ + 0.5));
+        uint64_t seen = 0;
+        for(size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if(seen >= rank)
+            {
+                return std::min(highestEquivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    static const uint64_t kHalf = 1ull << (kSubBits - 1);
+
+    static size_t indexOf(uint64_t v)
+    {
+        int msb = v == 0 ? 0 : 63 - __builtin_clzll(v);
+        int shift = std::max(0, msb - kSubBits + 1);
+        return static_cast<size_t>(kHalf * shift + (v >> shift));
+    }
+
+    static uint64_t highestEquivalent(size_t index)
+    {
+        if(index < 2 * kHalf)
+        {
+            return index;
+        }
+        uint64_t shift = index / kHalf - 1;
+        uint64_t sub = index - kHalf * shift;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+/**
+ * 机器可读的结果: 命令行带 --json FILE 时, emit把一行JSON追加到FILE, 便于不同版本之间对比.
+ * --tag 的值(例如版本号)和当前时间一并写入. 人看的结果仍输出到stderr
+ *
+ * JsonResult("echo").add("loops", 4).add("messages_per_sec", rate).emit(argc, argv);
+ */
+class JsonResult
+{
+public:
+    explicit JsonResult(const char* bench)
+    {
+        add("bench", bench);
+    }
+
+    JsonResult& add(const char* key, const char* value)
+    {
+        std::string quoted = "\"";
+        for(const char* p = value; *p != '\0'; ++p)
+        {
+            if(*p == '"' || *p == '\\')
+            {
+                quoted += '\\';
+            }
+            quoted += *p;
+        }
+        quoted += '"';
+        return addRaw(key, quoted);
+    }
+    JsonResult& add(const char* key, const std::string& value) { return add(key, value.c_str()); }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value, JsonResult&>::type add(const char* key, T value)
+    {
+        char text[32];
+        if(std::is_integral<T>::value)
+        {
+            snprintf(text, sizeof text, "%lld", static_cast<long long>(value));
+        }
+        else
+        {
+            snprintf(text, sizeof text, "%.6g", static_cast<double>(value));
+        }
+        return addRaw(key, text);
+    }
+
+    /// 写入prefix_p50/p99/p999/max/mean, 单位与记录时相同
+    JsonResult& addPercentiles(const std::string& prefix, const Histogram& h)
+    {
+        add((prefix + "_p50").c_str(), h.percentile(0.5));
+        add((prefix + "_p99").c_str(), h.percentile(0.99));
+        add((prefix + "_p999").c_str(), h.percentile(0.999));
+        add((prefix + "_max").c_str(), h.max());
+        return add((prefix + "_mean").c_str(), h.mean());
+    }
+
+    void emit(int argc, char* argv[]) const
+    {
+        const char* path = getArg(argc, argv, "--json", nullptr);
+        if(path == nullptr)
+        {
+            return;
+        }
+        FILE* fp = ::fopen(path, "a");
+        if(fp == nullptr)
+        {
+            fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+            return;
+        }
+        JsonResult line(*this);
+        line.add("tag", getArg(argc, argv, "--tag", "")).add("time", static_cast<long long>(::time(nullptr)));
+        fprintf(fp, "{%s}\n", line.fields_.c_str());
+        ::fclose(fp);
+    }
+
+private:
+    JsonResult& addRaw(const char* key, const std::string& value)
+    {
+        if(!fields_.empty())
+        {
+            fields_ += ", ";
+        }
+        fields_ += "\"";
+        fields_ += key;
+        fields_ += "\": ";
+        fields_ += value;
+        return *this;
+    }
+
+    std::string fields_;
+};
+
+/// 微基准: 跑repeats轮、每轮iterations次op, 取最快一轮的ns/op. 迭代次数固定, 结果可以在不同提交之间比较
+template <typename F>
+double bestNsPerOp(long iterations, int repeats, F&& op)
+{
+    double best = 0;
+    for(int r = 0; r < repeats; ++r)
+    {
+        int64_t start = nowNanos();
+        for(long i = 0; i < iterations; ++i)
+        {
+            op();
+        }
+        double ns = static_cast<double>(nowNanos() - start) / iterations;
+        best = r == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+/// 微基准的一行结果: stderr上对齐输出, 带 --json 时追加 {"bench", "case", "ns_per_op"}
+inline void reportNsPerOp(int argc, char* argv[], const char* bench, const std::string& name, double ns)
+{
+    fprintf(stderr, "%-40s %10.1f ns/op\n", name.c_str(), ns);
+    JsonResult(bench).add("case", name).add("ns_per_op", ns).emit(argc, argv);
+}
+
+}
@@ -0,0 +1,93 @@
+// Buffer微基准:
+//   append+retrieveAll: 稳态下的拷贝开销, 不扩容也不搬移
+//   append+retrieve keep=K: 每次取走的与追加的一样多, 始终留着K字节未读, 写满后makeSpace把它们搬回头部
+//   new+append: 新Buffer追加size字节, 超过初始大小时makeSpace扩容
+//   writeFd+readFd: socketpair上一端writeFd、另一端readFd同样多的字节
+// 每项取repeats轮中最快的一轮
+//
+// ./buffer_bench --sizes 16,256,4096,65536 --repeats 5 > /dev/null
+#include "BenchUtil.h"
+#include "Buffer.h"
+
+using namespace bench;
+
+static const char* volatile g_sink;     // 防止整段操作被优化掉
+
+int main(int argc, char* argv[])
+{
+    std::vector<size_t> sizes;
+    const char* arg = getArg(argc, argv, "--sizes", "16,256,4096,65536");
+    for(const char* p = arg; p != nullptr && *p; p = strchr(p, ','), p = p ? p + 1 : p)
+    {
+        sizes.push_back(static_cast<size_t>(atol(p)));
+    }
+    int repeats = static_cast<int>(getIntArg(argc, argv, "--repeats", 5));
+
+    int fds[2];
+    if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        fprintf(stderr, "socketpair: %s\n", strerror(errno));
+        return 1;
+    }
+    char name[64];
+    for(size_t size : sizes)
+    {
+        // 每项总共处理约64MB数据, 小消息多跑几次
+        long iterations = std::max<long>(10000, static_cast<long>((64u << 20) / size));
+        std::string data(size, 'b');
+
+        Buffer steady;
+        double ns = bestNsPerOp(iterations, repeats, [&]() {
+            steady.append(data.data(), size);
+            g_sink = steady.peek();
+            steady.retrieveAll();
+        });
+        snprintf(name, sizeof name, "append+retrieveAll size=%zu", size);
+        reportNsPerOp(argc, argv, "buffer", name, ns);
+
+        const size_t keep = 4 * size;
+        Buffer partial;
+        partial.append(std::string(keep, 'k').data(), keep);
+        ns = bestNsPerOp(iterations, repeats, [&]() {
+            partial.append(data.data(), size);
+            g_sink = partial.peek();
+            partial.retrieve(size);
+        });
+        snprintf(name, sizeof name, "append+retrieve keep=%zu size=%zu", keep, size);
+        reportNsPerOp(argc, argv, "buffer", name, ns);
+
+        ns = bestNsPerOp(iterations / 4 + 1, repeats, [&]() {
+            Buffer fresh;
+            fresh.append(data.data(), data.size());
+            g_sink = fresh.peek();
+        });
+        snprintf(name, sizeof name, "new+append size=%zu", size);
+        reportNsPerOp(argc, argv, "buffer", name, ns);
+
+        // socketpair的缓冲区放得下64KB, 一次writeFd/readFd都能完整完成
+        Buffer out;
+        Buffer in;
+        int savedErrno = 0;
+        ns = bestNsPerOp(iterations / 16 + 1, repeats, [&]() {
+            out.append(data.data(), size);
+            ssize_t n = out.writeFd(fds[0], &savedErrno);
+            out.retrieve(n > 0 ? n : 0);
+            size_t got = 0;
+            while(got < size)
+            {
+                n = in.readFd(fds[1], &savedErrno);
+                if(n <= 0)
+                {
+                    break;
+                }
+                got += n;
+            }
+            in.retrieveAll();
+        });
+        snprintf(name, sizeof name, "writeFd+readFd size=%zu", size);
+        reportNsPerOp(argc, argv, "buffer", name, ns);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
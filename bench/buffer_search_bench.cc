@@ -0,0 +1,81 @@
+// Buffer查找微基准: 64B/4KB/1MB缓冲区, 分隔符放在末尾(最坏情况)
+// 对比std::search/逐字节扫描/memchr与Buffer::findCRLF/findEOL
+//
+// ./buffer_search_bench --sizes 64,4096,1048576
+#include "BenchUtil.h"
+#include "Buffer.h"
+
+#include <algorithm>
+
+using namespace bench;
+
+static const char* volatile g_sink;   // 防止查找被优化掉
+
+// 让编译器看不出指针来源, 逐字节扫描和memchr才不会被整体提到循环外
+static const char* opaque(const char* p)
+{
+    asm volatile("" : "+r"(p));
+    return p;
+}
+
+template <typename F>
+static void run(const char* name, size_t size, F&& find)
+{
+    // 总扫描量约256MB, 小缓冲区多跑几次
+    long iterations = std::max<long>(1000, static_cast<long>((256u << 20) / size));
+    int64_t start = nowMicros();
+    for(long i = 0; i < iterations; ++i)
+    {
+        g_sink = find();
+    }
+    int64_t elapsed = nowMicros() - start;
+    double ns = elapsed * 1000.0 / iterations;
+    fprintf(stderr, "%-10zu %-16s %12.1f ns/op %8.2f GB/s\n", size, name, ns, size / ns);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<size_t> sizes;
+    const char* arg = getArg(argc, argv, "--sizes", "64,4096,1048576");
+    for(const char* p = arg; p != nullptr && *p; p = strchr(p, ','), p = p ? p + 1 : p)
+    {
+        sizes.push_back(static_cast<size_t>(atol(p)));
+    }
+
+    fprintf(stderr, "kernel=%s\n", Buffer::searchKernel());
+    for(size_t size : sizes)
+    {
+        // 内容是不含'\n'的文本, 偶尔出现单独的'\r', 末尾是"\r\n"
+        std::string data(size - 2, 'a');
+        for(size_t i = 37; i < data.size(); i += 101)
+        {
+            data[i] = '\r';
+        }
+        data += "\r\n";
+        Buffer buf;
+        buf.append(data.data(), data.size());
+        const char* begin = buf.peek();
+        const char* end = begin + buf.readableBytes();
+        static const char kCRLF[] = "\r\n";
+
+        run("std::search", size, [&]() {
+            return std::search(opaque(begin), end, kCRLF, kCRLF + 2);
+        });
+        run("byte-loop", size, [&]() -> const char* {
+            for(const char* p = opaque(begin); p + 1 < end; ++p)
+            {
+                if(p[0] == '\r' && p[1] == '\n')
+                {
+                    return p;
+                }
+            }
+            return nullptr;
+        });
+        run("findCRLF", size, [&]() { return buf.findCRLF(); });
+        run("memchr", size, [&]() {
+            return static_cast<const char*>(::memchr(opaque(begin), '\n', end - begin));
+        });
+        run("findEOL", size, [&]() { return buf.findEOL(); });
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+// 建连/断连吞吐: 每个客户端线程反复connect后立即close
+// 替换全局operator new统计服务端线程(非客户端线程)上的堆分配次数，
+// 报告每条连接的分配次数和耗时
+//
+// ./churn_bench --loops 4 --clients 4 --seconds 3 > /dev/null
+// ./churn_bench --json results.jsonl --tag v1.2    # 追加一行JSON结果
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+using namespace bench;
+
+static std::atomic<long> g_allocations(0);
+static thread_local bool t_clientThread = false;    // 客户端线程的分配不计入
+
+void* operator new(size_t size)
+{
+    if(!t_clientThread)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = ::malloc(size ? size : 1);
+    if(p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    ::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 4));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9983));
+
+    std::atomic<long> closed(0);
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "ChurnBench");
+    server.setConnectionCallback([&closed](const TcpConnectionPtr& conn) {
+        if(!conn->connected())
+        {
+            ++closed;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        t_clientThread = true;
+        std::atomic_bool stop(false);
+        std::vector<std::thread> clients;
+        long closedBefore = closed;
+        long allocBefore = g_allocations;
+        int64_t start = nowMicros();
+        for(int i = 0; i < numClients; ++i)
+        {
+            clients.emplace_back([&]() {
+                t_clientThread = true;
+                while(!stop)
+                {
+                    int fd = connectLoopback(port);
+                    if(fd < 0)
+                    {
+                        usleep(1000);   // TIME_WAIT耗尽端口时稍等
+                        continue;
+                    }
+                    ::close(fd);
+                }
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        usleep(200 * 1000);     // 等服务端处理完剩余的关闭
+        long conns = closed - closedBefore;
+        int64_t elapsed = nowMicros() - start;
+        long allocs = g_allocations - allocBefore;
+
+        fprintf(stderr, "loops=%d clients=%d seconds=%d\n", numLoops, numClients, seconds);
+        fprintf(stderr, "connections=%ld connections/s=%.0f\n", conns, conns * 1e6 / elapsed);
+        if(conns > 0)
+        {
+            fprintf(stderr, "ns/connection=%.0f allocations/connection=%.1f\n",
+                    elapsed * 1000.0 / conns, static_cast<double>(allocs) / conns);
+        }
+        JsonResult("churn")
+            .add("loops", numLoops).add("clients", numClients).add("seconds", seconds)
+            .add("connections", conns).add("connections_per_sec", conns * 1e6 / elapsed)
+            .add("allocations_per_connection", conns > 0 ? static_cast<double>(allocs) / conns : 0.0)
+            .emit(argc, argv);
+        for(EventLoop* l : server.threadPool()->getAllLoops())
+        {
+            const std::shared_ptr<MemoryPool>& pool = l->connectionPool();
+            fprintf(stderr, "loop %p: pool chunks=%zu free=%zu blockSize=%zu\n",
+                    l, pool->numChunks(), pool->numFree(), pool->blockSize());
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
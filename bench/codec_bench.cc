@@ -0,0 +1,105 @@
+// 小消息分帧吞吐: 客户端每批发送batch条长度前缀帧，最后跟一个空帧作为批结束标记，
+// 服务端用LengthHeaderCodec解帧计数，收到空帧回一个空帧，客户端收到后发下一批
+//
+// ./codec_bench --header varint --size 32 --batch 256 --clients 4 --seconds 3 > /dev/null
+#include "BenchUtil.h"
+#include "LengthHeaderCodec.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 4));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 32));
+    int batch = static_cast<int>(getIntArg(argc, argv, "--batch", 256));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9985));
+    const char* header = getArg(argc, argv, "--header", "varint");
+    LengthHeaderCodec::HeaderType type = LengthHeaderCodec::kVarint;
+    if(strcmp(header, "16") == 0)
+    {
+        type = LengthHeaderCodec::kHeader16;
+    }
+    else if(strcmp(header, "32") == 0)
+    {
+        type = LengthHeaderCodec::kHeader32;
+    }
+
+    std::atomic<long> frames(0);
+    std::atomic<long> payloadBytes(0);
+    LengthHeaderCodec codec(type, [&](const TcpConnectionPtr& conn, StringPiece message, Timestamp) {
+        if(message.empty())
+        {
+            Buffer ack;
+            codec.send(conn, &ack);
+            return;
+        }
+        frames.fetch_add(1, std::memory_order_relaxed);
+        payloadBytes.fetch_add(message.size(), std::memory_order_relaxed);
+    });
+
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "CodecBench");
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server.setThreadNum(numLoops);
+    server.start();
+
+    // 客户端预先编好一批帧
+    std::string request;
+    for(int i = 0; i < batch; ++i)
+    {
+        Buffer frame;
+        frame.append(std::string(size, 'x').data(), size);
+        codec.encode(&frame);
+        request.append(frame.peek(), frame.readableBytes());
+    }
+    Buffer end;
+    codec.encode(&end);
+    const size_t ackLen = end.readableBytes();
+    request.append(end.peek(), end.readableBytes());
+
+    std::thread driver([&]() {
+        std::atomic_bool stop(false);
+        std::vector<std::thread> clients;
+        int64_t start = nowMicros();
+        for(int i = 0; i < numClients; ++i)
+        {
+            clients.emplace_back([&]() {
+                int fd = connectLoopback(port);
+                char ack[LengthHeaderCodec::kMaxVarintLen];
+                while(fd >= 0 && !stop)
+                {
+                    if(!writeAll(fd, request.data(), request.size()) || !readAll(fd, ack, ackLen))
+                    {
+                        break;
+                    }
+                }
+                ::close(fd);
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        int64_t elapsed = nowMicros() - start;
+        fprintf(stderr, "header=%s size=%zu batch=%d loops=%d clients=%d\n",
+                header, size, batch, numLoops, numClients);
+        fprintf(stderr, "frames=%ld frames/s=%.0f payload MB/s=%.1f\n",
+                frames.load(), frames * 1e6 / elapsed, payloadBytes / static_cast<double>(elapsed));
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,156 @@
+// 主动连接建立速度: 子进程运行TcpServer, 父进程在若干客户端loop上用TcpClient发起connections条
+// 非阻塞连接, 同时进行中的连接不超过window条, 报告connections/s和单条连接建立耗时分位数
+// 服务端和客户端各占一个进程, 各自的RLIMIT_NOFILE都只需容纳connections条
+//
+// ./connect_bench --connections 10000 --window 512 --client-loops 2 > /dev/null
+#include "BenchUtil.h"
+#include "EventLoopThread.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <atomic>
+
+using namespace bench;
+
+static void raiseFdLimit()
+{
+    rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static void runServer(uint16_t port, int numLoops)
+{
+    raiseFdLimit();
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "ConnectBenchServer");
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); });
+    server.setThreadNum(numLoops);
+    server.start();
+    loop.loop();
+}
+
+int main(int argc, char* argv[])
+{
+    long numConnections = getIntArg(argc, argv, "--connections", 10000);
+    long window = getIntArg(argc, argv, "--window", 512);
+    int numClientLoops = static_cast<int>(getIntArg(argc, argv, "--client-loops", 2));
+    int numServerLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 2));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9988));
+
+    pid_t server = ::fork();
+    if(server == 0)
+    {
+        runServer(port, numServerLoops);
+        return 0;
+    }
+    raiseFdLimit();
+    for(int ms = 0; ; ++ms)
+    {
+        int fd = connectLoopback(port);
+        if(fd >= 0)
+        {
+            ::close(fd);
+            break;
+        }
+        if(ms == 5000)
+        {
+            fprintf(stderr, "server did not start on port %u\n", port);
+            ::kill(server, SIGKILL);
+            return 1;
+        }
+        usleep(1000);
+    }
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop*> loops;
+    for(int i = 0; i < numClientLoops; ++i)
+    {
+        threads.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "client"));
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    std::vector<std::unique_ptr<TcpClient>> clients(numConnections);
+    std::vector<int64_t> startTimes(numConnections);
+    std::vector<int64_t> latencies(numConnections, -1);     // -1: 未建立
+    std::atomic_long next(0);
+    std::atomic_long established(0);
+    std::function<void()> startNext = [&]() {
+        long j = next++;
+        if(j < numConnections)
+        {
+            startTimes[j] = nowMicros();
+            clients[j]->connect();
+        }
+    };
+    for(long i = 0; i < numConnections; ++i)
+    {
+        clients[i].reset(new TcpClient(loops[i % loops.size()], InetAddress(port), "client"));
+        clients[i]->setConnectionCallback([&, i](const TcpConnectionPtr& conn) {
+            if(conn->connected())
+            {
+                latencies[i] = nowMicros() - startTimes[i];
+                ++established;
+                startNext();
+            }
+        });
+    }
+
+    int64_t start = nowMicros();
+    for(long i = 0; i < std::min(window, numConnections); ++i)
+    {
+        startNext();
+    }
+    int64_t lastProgress = start;
+    long lastEstablished = 0;
+    while(established < numConnections && nowMicros() - lastProgress < 10 * 1000 * 1000)
+    {
+        usleep(1000);
+        if(established != lastEstablished)
+        {
+            lastEstablished = established;
+            lastProgress = nowMicros();
+        }
+    }
+    int64_t elapsed = nowMicros() - start;
+    long done = established;
+
+    // 在各自loop中析构客户端, 关闭连接
+    int64_t closeStart = nowMicros();
+    for(size_t k = 0; k < loops.size(); ++k)
+    {
+        std::promise<void> destroyed;
+        loops[k]->runInLoop([&, k]() {
+            for(size_t i = k; i < clients.size(); i += loops.size())
+            {
+                clients[i].reset();
+            }
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+    }
+    int64_t closeElapsed = nowMicros() - closeStart;
+    ::kill(server, SIGKILL);
+    ::waitpid(server, nullptr, 0);
+
+    latencies.erase(std::remove(latencies.begin(), latencies.end(), -1), latencies.end());
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> long long {
+        return latencies.empty() ? 0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    fprintf(stderr, "connections=%ld window=%ld client-loops=%d server-loops=%d\n",
+            numConnections, window, numClientLoops, numServerLoops);
+    fprintf(stderr, "established=%ld in %.3fs, connections/s=%.0f\n",
+            done, elapsed / 1e6, done * 1e6 / elapsed);
+    fprintf(stderr, "connect latency us: p50=%lld p90=%lld p99=%lld p999=%lld max=%lld\n",
+            percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+    fprintf(stderr, "teardown %.3fs\n", closeElapsed / 1e6);
+    return done == numConnections ? 0 : 1;
+}
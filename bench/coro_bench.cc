@@ -0,0 +1,220 @@
+// 同一个回显协议(4字节长度头 + payload)的三种服务端写法:
+//   codec: LengthHeaderCodec解帧回调, 手写状态机的代表
+//   chain: 嵌套回调, 每读一段数据注册一个新的std::function继续
+//   coro:  coServe + CoStream, co_await fill(4)/fill(4 + n)/write, 帧直接从输入缓冲区发回
+// 客户端每轮发送depth条请求再读回depth条响应, 报告requests/s和服务端每条请求的CPU时间,
+// coro另报告协程帧池的分配次数与向系统申请的字节数
+//
+// ./coro_bench --size 64 --depth 16 --clients 4 --seconds 3 > /dev/null
+#include "BenchUtil.h"
+#include "CoStream.h"
+#include "LengthHeaderCodec.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+namespace
+{
+
+uint32_t readLength(Buffer* input)
+{
+    uint32_t be;
+    memcpy(&be, input->peek(), sizeof be);
+    input->retrieve(sizeof be);
+    return ntohl(be);
+}
+
+// ---- chain ----
+struct ChainContext
+{
+    size_t need;
+    std::function<void(const TcpConnectionPtr&, Buffer*)> next;
+};
+
+void expect(const TcpConnectionPtr& conn, size_t n, std::function<void(const TcpConnectionPtr&, Buffer*)> next)
+{
+    ChainContext* ctx = static_cast<ChainContext*>(conn->getContext().get());
+    ctx->need = n;
+    ctx->next = std::move(next);
+}
+
+void readRequest(const TcpConnectionPtr& conn)
+{
+    expect(conn, sizeof(uint32_t), [](const TcpConnectionPtr& conn, Buffer* input) {
+        uint32_t len = readLength(input);
+        expect(conn, len, [len](const TcpConnectionPtr& conn, Buffer* input) {
+            Buffer reply;
+            reply.append(input->peek(), len);
+            input->retrieve(len);
+            uint32_t be = htonl(len);
+            reply.prepend(&be, sizeof be);
+            conn->send(&reply);
+            readRequest(conn);
+        });
+    });
+}
+
+void onChainMessage(const TcpConnectionPtr& conn, Buffer* input, Timestamp)
+{
+    ChainContext* ctx = static_cast<ChainContext*>(conn->getContext().get());
+    while(ctx->next && input->readableBytes() >= ctx->need)
+    {
+        std::function<void(const TcpConnectionPtr&, Buffer*)> next = std::move(ctx->next);
+        ctx->next = nullptr;
+        next(conn, input);
+    }
+}
+
+// ---- coro ----
+CoTask<void> echoSession(CoStreamPtr stream)
+{
+    stream->connection()->setTcpNoDelay(true);
+    for(;;)
+    {
+        // 请求原样就是响应, 在输入缓冲区里凑齐一帧后直接发回, 不拷贝
+        if(!co_await stream->fill(sizeof(uint32_t)))
+        {
+            break;
+        }
+        uint32_t be;
+        memcpy(&be, stream->input()->peek(), sizeof be);
+        size_t frameLen = sizeof be + ntohl(be);
+        if(!co_await stream->fill(frameLen))
+        {
+            break;
+        }
+        bool connected = co_await stream->write(stream->input()->peek(), frameLen);
+        stream->input()->retrieve(frameLen);
+        if(!connected)
+        {
+            break;
+        }
+    }
+}
+
+struct Result
+{
+    long requests;
+    int64_t elapsed;
+    int64_t cpu;
+};
+
+Result drive(uint16_t port, int numClients, int depth, size_t size, int seconds,
+             const std::vector<EventLoop*>& loops)
+{
+    std::string request;
+    for(int i = 0; i < depth; ++i)
+    {
+        uint32_t be = htonl(static_cast<uint32_t>(size));
+        request.append(reinterpret_cast<const char*>(&be), sizeof be);
+        request.append(size, 'x');
+    }
+    std::atomic_bool stop(false);
+    std::atomic<long> requests(0);
+    std::vector<int64_t> cpuBefore = loopCpuMicros(loops);
+    int64_t start = nowMicros();
+    std::vector<std::thread> clients;
+    for(int i = 0; i < numClients; ++i)
+    {
+        clients.emplace_back([&]() {
+            int fd = connectLoopback(port);
+            std::string reply(request.size(), '\0');
+            while(fd >= 0 && !stop)
+            {
+                if(!writeAll(fd, request.data(), request.size()) || !readAll(fd, &reply[0], reply.size()))
+                {
+                    break;
+                }
+                requests.fetch_add(depth, std::memory_order_relaxed);
+            }
+            ::close(fd);
+        });
+    }
+    sleep(seconds);
+    stop = true;
+    for(auto& t : clients)
+    {
+        t.join();
+    }
+    Result result = { requests.load(), nowMicros() - start, 0 };
+    std::vector<int64_t> cpuAfter = loopCpuMicros(loops);
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        result.cpu += cpuAfter[i] - cpuBefore[i];
+    }
+    return result;
+}
+
+void report(const char* mode, const Result& r)
+{
+    fprintf(stderr, "%-5s requests/s=%.0f server cpu ns/request=%.0f\n",
+            mode, r.requests * 1e6 / r.elapsed, r.requests > 0 ? r.cpu * 1e3 / r.requests : 0.0);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 1));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 4));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    int depth = static_cast<int>(getIntArg(argc, argv, "--depth", 16));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9990));
+
+    EventLoop loop;
+    LengthHeaderCodec codec(LengthHeaderCodec::kHeader32, [&codec](const TcpConnectionPtr& conn, StringPiece message, Timestamp) {
+        codec.send(conn, message);
+    });
+    TcpServer codecServer(&loop, InetAddress(port), "CodecEcho");
+    // 每条响应单独发送, 关掉Nagle
+    codecServer.setConnectionCallback([](const TcpConnectionPtr& conn) { conn->setTcpNoDelay(true); });
+    codecServer.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    codecServer.setThreadNum(numLoops);
+    codecServer.start();
+
+    TcpServer chainServer(&loop, InetAddress(port + 1), "ChainEcho");
+    chainServer.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->setContext(std::make_shared<ChainContext>());
+            readRequest(conn);
+        }
+    });
+    chainServer.setMessageCallback(onChainMessage);
+    chainServer.setThreadNum(numLoops);
+    chainServer.start();
+
+    TcpServer coroServer(&loop, InetAddress(port + 2), "CoroEcho");
+    coServe(&coroServer, echoSession);
+    coroServer.setThreadNum(numLoops);
+    coroServer.start();
+
+    std::thread driver([&]() {
+        fprintf(stderr, "size=%zu depth=%d loops=%d clients=%d\n", size, depth, numLoops, numClients);
+        report("codec", drive(port, numClients, depth, size, seconds, codecServer.threadPool()->getAllLoops()));
+        report("chain", drive(port + 1, numClients, depth, size, seconds, chainServer.threadPool()->getAllLoops()));
+        std::vector<EventLoop*> coroLoops = coroServer.threadPool()->getAllLoops();
+        report("coro", drive(port + 2, numClients, depth, size, seconds, coroLoops));
+        for(EventLoop* l : coroLoops)
+        {
+            std::promise<void> done;
+            l->runInLoop([&done]() {
+                CoFramePool& pool = CoFramePool::current();
+                fprintf(stderr, "  frame pool: allocations=%zu chunk bytes=%zu\n", pool.allocations(), pool.chunkBytes());
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
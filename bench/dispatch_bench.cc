@@ -0,0 +1,113 @@
+// 偏斜负载下各分发策略的loop间CPU不均衡程度
+//
+// 每一轮先建立1条长连接(heavy)，再建立loops-1条短连接(light)并立即关闭，
+// round-robin会把所有heavy连接分到同一个loop上；随后heavy连接持续ping-pong，
+// 统计这段时间内每个loop线程消耗的CPU时间，报告max/mean。
+//
+// ./dispatch_bench --policy rr|lc|lpb|p2c|hash --loops 4 --heavy 8 --seconds 3 --size 4096 > /dev/null
+#include "BenchUtil.h"
+#include "Buffer.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+static EventLoopThreadPool::DispatchPolicy parsePolicy(const std::string& name)
+{
+    if(name == "lc") return EventLoopThreadPool::kLeastConnections;
+    if(name == "lpb") return EventLoopThreadPool::kLeastPendingBytes;
+    if(name == "p2c") return EventLoopThreadPool::kPowerOfTwoChoices;
+    if(name == "hash") return EventLoopThreadPool::kConsistentHash;
+    return EventLoopThreadPool::kRoundRobin;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string policy = getArg(argc, argv, "--policy", "rr");
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numHeavy = static_cast<int>(getIntArg(argc, argv, "--heavy", 8));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 4096));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9981));
+
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "DispatchBench");
+    server.setDispatchPolicy(parsePolicy(policy));
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<int> heavy;
+        for(int i = 0; i < numHeavy; ++i)
+        {
+            heavy.push_back(connectLoopback(port));
+            for(int j = 0; j < numLoops - 1; ++j)
+            {
+                int fd = connectLoopback(port);
+                char c = 'x';
+                writeAll(fd, &c, 1);
+                readAll(fd, &c, 1);
+                ::close(fd);
+            }
+            usleep(20 * 1000);  // 等短连接在服务端销毁，计数回落
+        }
+
+        std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+        std::vector<int> conns;
+        for(EventLoop* l : loops)
+        {
+            conns.push_back(l->connectionCount());
+        }
+
+        std::atomic_bool stop(false);
+        std::vector<std::thread> clients;
+        std::vector<int64_t> before = loopCpuMicros(loops);
+        for(int fd : heavy)
+        {
+            clients.emplace_back([fd, size, &stop]() {
+                std::string msg(size, 'h');
+                std::string reply(size, 0);
+                while(!stop && writeAll(fd, msg.data(), size) && readAll(fd, &reply[0], size))
+                {
+                }
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        std::vector<int64_t> after = loopCpuMicros(loops);
+
+        double total = 0, max = 0;
+        fprintf(stderr, "policy=%s loops=%d heavy=%d seconds=%d size=%zu\n",
+                policy.c_str(), numLoops, numHeavy, seconds, size);
+        for(size_t i = 0; i < loops.size(); ++i)
+        {
+            double ms = (after[i] - before[i]) / 1000.0;
+            total += ms;
+            max = std::max(max, ms);
+            fprintf(stderr, "loop %zu: conns=%d cpu=%.1fms\n", i, conns[i], ms);
+        }
+        double mean = total / loops.size();
+        fprintf(stderr, "imbalance max/mean=%.2f\n", mean > 0 ? max / mean : 0.0);
+
+        for(int fd : heavy)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,138 @@
+// 多连接回显吞吐: 服务端loops个loop回显, 客户端threads个线程平分connections条连接,
+// 每条连接每轮写入depth条size字节的消息, 再读回同样多的字节.
+// 报告messages/s、MB/s(单向有效载荷)、服务端每条消息的CPU时间和各loop的运行统计
+//
+// ./echo_bench --loops 4 --connections 64 --threads 4 --size 64 --depth 16 --seconds 3 > /dev/null
+// ./echo_bench --json results.jsonl --tag v1.2    # 追加一行JSON结果
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numConnections = static_cast<int>(getIntArg(argc, argv, "--connections", 64));
+    int numThreads = static_cast<int>(getIntArg(argc, argv, "--threads", 4));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    int depth = static_cast<int>(getIntArg(argc, argv, "--depth", 16));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9991));
+    numThreads = std::max(1, std::min(numThreads, numConnections));
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "EchoBench");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        conn->send(input);
+    });
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        const std::string request(size * depth, 'e');
+        std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+        std::atomic_bool stop(false);
+        std::atomic<long> rounds(0);
+        std::atomic<int> failed(0);
+        std::vector<std::thread> clients;
+        std::vector<int64_t> cpuBefore = loopCpuMicros(loops);
+        std::vector<LoopStatsSnapshot> statsBefore = server.threadPool()->loopStats();
+        int64_t start = nowMicros();
+        for(int t = 0; t < numThreads; ++t)
+        {
+            int conns = numConnections / numThreads + (t < numConnections % numThreads ? 1 : 0);
+            clients.emplace_back([&, conns]() {
+                std::vector<int> fds;
+                for(int i = 0; i < conns; ++i)
+                {
+                    int fd = connectLoopback(port);
+                    if(fd < 0)
+                    {
+                        ++failed;
+                        break;
+                    }
+                    fds.push_back(fd);
+                }
+                std::string reply(request.size(), '\0');
+                bool ok = !fds.empty();
+                while(ok && !stop)
+                {
+                    // 先把本线程所有连接的请求都发出去, 服务端同时处理多条连接
+                    for(int fd : fds)
+                    {
+                        ok = ok && writeAll(fd, request.data(), request.size());
+                    }
+                    for(int fd : fds)
+                    {
+                        ok = ok && readAll(fd, &reply[0], reply.size());
+                    }
+                    if(ok)
+                    {
+                        rounds.fetch_add(static_cast<long>(fds.size()), std::memory_order_relaxed);
+                    }
+                }
+                for(int fd : fds)
+                {
+                    ::close(fd);
+                }
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        int64_t elapsed = nowMicros() - start;
+        std::vector<int64_t> cpuAfter = loopCpuMicros(loops);
+        int64_t cpu = 0;
+        for(size_t i = 0; i < loops.size(); ++i)
+        {
+            cpu += cpuAfter[i] - cpuBefore[i];
+        }
+        // 各loop的增量: 汇总看每轮poll处理多少事件, 最忙和最闲的loop看负载偏斜
+        std::vector<LoopStatsSnapshot> statsAfter = server.threadPool()->loopStats();
+        LoopStatsSnapshot total;
+        double busyMax = 0;
+        double busyMin = 1;
+        for(size_t i = 0; i < statsAfter.size(); ++i)
+        {
+            LoopStatsSnapshot d = statsAfter[i].delta(statsBefore[i]);
+            total += d;
+            busyMax = std::max(busyMax, d.busyRatio());
+            busyMin = std::min(busyMin, d.busyRatio());
+        }
+
+        long messages = rounds * depth;
+        double messagesPerSec = messages * 1e6 / elapsed;
+        double mbPerSec = messages * size / (elapsed / 1e6) / (1 << 20);
+        double cpuNsPerMessage = messages > 0 ? cpu * 1e3 / messages : 0;
+        fprintf(stderr, "loops=%d connections=%d threads=%d size=%zu depth=%d failed=%d\n",
+                numLoops, numConnections, numThreads, size, depth, failed.load());
+        fprintf(stderr, "messages/s=%.0f MB/s=%.1f server cpu ns/message=%.0f\n",
+                messagesPerSec, mbPerSec, cpuNsPerMessage);
+        fprintf(stderr, "loop stats: %s busy_min=%.3f busy_max=%.3f\n",
+                total.toString().c_str(), busyMin, busyMax);
+        JsonResult("echo")
+            .add("loops", numLoops).add("connections", numConnections).add("threads", numThreads)
+            .add("size", size).add("depth", depth).add("seconds", seconds).add("failed_connects", failed.load())
+            .add("messages_per_sec", messagesPerSec).add("mb_per_sec", mbPerSec)
+            .add("server_cpu_ns_per_message", cpuNsPerMessage)
+            .add("events_per_poll", total.eventsPerPoll()).add("loop_busy_min", busyMin).add("loop_busy_max", busyMax)
+            .emit(argc, argv);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,198 @@
+// 广播扇出: 建立N个订阅连接，把同一条消息发给所有连接
+// shared模式用TcpServer::broadcast共享一份数据，copy模式逐个conn->send(string)
+// 报告每秒送达的消息数和进程RSS，订阅数超过fd上限的规模会跳过
+//
+// ./fanout_bench --subscribers 1000,10000,100000 --mode shared > /dev/null
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace bench;
+
+// 读取/proc/self/status中的某一项(kB)
+static long procStatusKb(const char* key)
+{
+    FILE* fp = ::fopen("/proc/self/status", "r");
+    if(fp == nullptr)
+    {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    size_t keyLen = strlen(key);
+    while(::fgets(line, sizeof line, fp))
+    {
+        if(strncmp(line, key, keyLen) == 0 && line[keyLen] == ':')
+        {
+            value = atol(line + keyLen + 1);
+            break;
+        }
+    }
+    ::fclose(fp);
+    return value;
+}
+
+static std::vector<long> parseList(const char* s)
+{
+    std::vector<long> result;
+    while(*s)
+    {
+        result.push_back(atol(s));
+        const char* comma = strchr(s, ',');
+        if(comma == nullptr)
+        {
+            break;
+        }
+        s = comma + 1;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    std::vector<long> subscriberCounts = parseList(getArg(argc, argv, "--subscribers", "1000,10000,100000"));
+    int messages = static_cast<int>(getIntArg(argc, argv, "--messages", 100));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 1024));
+    bool copyMode = strcmp(getArg(argc, argv, "--mode", "shared"), "copy") == 0;
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9984));
+
+    // 每个订阅占客户端和服务端两个fd
+    rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+    long maxSubscribers = static_cast<long>(rl.rlim_cur / 2) - 64;
+
+    std::mutex mutex;
+    std::set<TcpConnectionPtr> subscribers;
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "FanoutBench");
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(conn->connected())
+        {
+            subscribers.insert(conn);
+        }
+        else
+        {
+            subscribers.erase(conn);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+    auto numSubscribers = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return subscribers.size();
+    };
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        fprintf(stderr, "loops=%d messages=%d size=%zu mode=%s\n",
+                numLoops, messages, size, copyMode ? "copy" : "shared");
+        for(long count : subscriberCounts)
+        {
+            if(count > maxSubscribers)
+            {
+                fprintf(stderr, "subscribers=%ld skipped (RLIMIT_NOFILE=%llu)\n",
+                        count, (unsigned long long)rl.rlim_cur);
+                continue;
+            }
+            long rssBefore = procStatusKb("VmRSS");
+            std::vector<int> fds;
+            int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+            for(long i = 0; i < count; ++i)
+            {
+                int fd = connectLoopback(port);
+                if(fd < 0)
+                {
+                    break;
+                }
+                epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+                fds.push_back(fd);
+            }
+            while(numSubscribers() < fds.size())
+            {
+                usleep(1000);
+            }
+            std::vector<TcpConnectionPtr> conns;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                conns.assign(subscribers.begin(), subscribers.end());
+            }
+
+            // 客户端读线程, 收满所有字节后结束
+            const int64_t expected = static_cast<int64_t>(fds.size()) * messages * size;
+            std::atomic<int64_t> received(0);
+            std::thread reader([&]() {
+                std::vector<epoll_event> events(1024);
+                char buf[64 * 1024];
+                while(received < expected)
+                {
+                    int n = ::epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 1000);
+                    for(int i = 0; i < n; ++i)
+                    {
+                        ssize_t r = ::read(events[i].data.fd, buf, sizeof buf);
+                        if(r > 0)
+                        {
+                            received += r;
+                        }
+                    }
+                }
+            });
+
+            int64_t start = nowMicros();
+            for(int m = 0; m < messages; ++m)
+            {
+                SharedMessage message = std::make_shared<const std::string>(size, 'a' + m % 26);
+                if(copyMode)
+                {
+                    for(const TcpConnectionPtr& conn : conns)
+                    {
+                        conn->send(*message);
+                    }
+                }
+                else
+                {
+                    server.broadcast(conns, message);
+                }
+            }
+            reader.join();
+            int64_t elapsed = nowMicros() - start;
+            long rssAfter = procStatusKb("VmRSS");
+
+            fprintf(stderr, "subscribers=%zu deliveries/s=%.0f MB/s=%.1f elapsed_ms=%.1f "
+                    "rss_kb=%ld rss_delta_kb=%ld hwm_kb=%ld\n",
+                    fds.size(), static_cast<double>(fds.size()) * messages * 1e6 / elapsed,
+                    expected / static_cast<double>(elapsed), elapsed / 1000.0,
+                    rssAfter, rssAfter - rssBefore, procStatusKb("VmHWM"));
+
+            conns.clear();
+            for(int fd : fds)
+            {
+                ::close(fd);
+            }
+            ::close(epfd);
+            while(numSubscribers() > 0)
+            {
+                usleep(1000);
+            }
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
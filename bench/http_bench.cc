@@ -0,0 +1,133 @@
+// HTTP吞吐和延迟: 每个客户端线程一条keep-alive连接, 每轮流水线发送pipeline个GET,
+// 收齐响应后记录本轮耗时, 报告requests/s和延迟分位数
+//
+// ./http_bench --connections 8 --pipeline 16 --body 64 --seconds 3 > /dev/null
+#include "BenchUtil.h"
+#include "HttpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace bench;
+
+// 读一个完整响应, 返回它的总长度, 失败返回0. 本压测的响应都带Content-Length
+static size_t readOneResponse(int fd)
+{
+    std::string data;
+    char buf[4096];
+    while(true)
+    {
+        size_t headerEnd = data.find("\r\n\r\n");
+        if(headerEnd != std::string::npos)
+        {
+            size_t pos = data.find("Content-Length: ");
+            size_t bodyLen = pos < headerEnd ? atol(data.c_str() + pos + 16) : 0;
+            size_t total = headerEnd + 4 + bodyLen;
+            if(data.size() >= total)
+            {
+                return total;
+            }
+        }
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if(n <= 0)
+        {
+            return 0;
+        }
+        data.append(buf, n);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numConnections = static_cast<int>(getIntArg(argc, argv, "--connections", 8));
+    int pipeline = static_cast<int>(getIntArg(argc, argv, "--pipeline", 1));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    size_t bodySize = static_cast<size_t>(getIntArg(argc, argv, "--body", 64));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9986));
+
+    const std::string body(bodySize, 'x');
+    EventLoop loop;
+    InetAddress addr(port);
+    HttpServer server(&loop, addr, "HttpBench");
+    server.setHttpCallback([&body](const HttpRequest&, HttpResponse* resp) {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain");
+        resp->setBody(body);
+    });
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::string request;
+        for(int i = 0; i < pipeline; ++i)
+        {
+            request += "GET /hello HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\n\r\n";
+        }
+        std::atomic_bool stop(false);
+        std::mutex mutex;
+        std::vector<int64_t> latencies;     // 每轮耗时(us)
+        long requests = 0;
+        std::vector<std::thread> clients;
+        int64_t start = nowMicros();
+        for(int i = 0; i < numConnections; ++i)
+        {
+            clients.emplace_back([&]() {
+                int fd = connectLoopback(port);
+                // 先发一个请求得到响应长度, Date首部定长, 之后每个响应长度相同
+                size_t responseLen = 0;
+                if(fd >= 0 && writeAll(fd, request.data(), request.size() / pipeline))
+                {
+                    responseLen = readOneResponse(fd);
+                }
+                std::vector<int64_t> local;
+                std::string responses(responseLen * pipeline, '\0');
+                while(responseLen > 0 && !stop)
+                {
+                    int64_t begin = nowMicros();
+                    if(!writeAll(fd, request.data(), request.size())
+                        || !readAll(fd, &responses[0], responses.size()))
+                    {
+                        break;
+                    }
+                    local.push_back(nowMicros() - begin);
+                }
+                ::close(fd);
+                std::lock_guard<std::mutex> lock(mutex);
+                latencies.insert(latencies.end(), local.begin(), local.end());
+                requests += static_cast<long>(local.size()) * pipeline;
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        int64_t elapsed = nowMicros() - start;
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) -> int64_t {
+            if(latencies.empty())
+            {
+                return 0;
+            }
+            size_t idx = static_cast<size_t>(p * (latencies.size() - 1));
+            return latencies[idx];
+        };
+        fprintf(stderr, "loops=%d connections=%d pipeline=%d body=%zu\n",
+                numLoops, numConnections, pipeline, bodySize);
+        fprintf(stderr, "requests=%ld requests/s=%.0f\n", requests, requests * 1e6 / elapsed);
+        fprintf(stderr, "round latency us: p50=%lld p90=%lld p99=%lld p999=%lld max=%lld\n",
+                (long long)percentile(0.5), (long long)percentile(0.9), (long long)percentile(0.99),
+                (long long)percentile(0.999), (long long)percentile(1.0));
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
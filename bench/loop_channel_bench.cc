@@ -0,0 +1,134 @@
+// loop之间传递消息: queueInLoop(加锁 + 每条一个std::function) 与 LoopChannel(无锁环, 按需唤醒) 的对比.
+// 生产者loop每轮发送batch条消息后把自己重新排队, 模拟"处理一批请求后转发给其他分片";
+// 报告messages/s、消费者处理时刻与发送时刻之差的分位数, 以及写消费者eventfd的次数
+//
+// ./loop_channel_bench --count 2000000 --batch 64 > /dev/null
+#include "BenchUtil.h"
+#include "EventLoopThread.h"
+#include "LoopChannel.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace bench;
+
+namespace
+{
+
+struct Message
+{
+    uint64_t seq;
+    int64_t sendTime;
+};
+
+struct Run
+{
+    long count;
+    int batch;
+    long sent;
+    long received;
+    long full;                  // LoopChannel满而推迟到下一轮的次数
+    std::vector<int64_t> latencies;
+    std::promise<int64_t> done;
+};
+
+void onMessage(Run* run, const Message& m)
+{
+    if(m.seq % 16 == 0)
+    {
+        run->latencies.push_back(nowMicros() - m.sendTime);
+    }
+    if(++run->received == run->count)
+    {
+        run->done.set_value(nowMicros());
+    }
+}
+
+void produceQueue(Run* run, EventLoop* producer, EventLoop* consumer)
+{
+    for(int i = 0; i < run->batch && run->sent < run->count; ++i)
+    {
+        Message m = { static_cast<uint64_t>(run->sent++), nowMicros() };
+        consumer->queueInLoop([run, m]() { onMessage(run, m); });
+    }
+    if(run->sent < run->count)
+    {
+        producer->queueInLoop([run, producer, consumer]() { produceQueue(run, producer, consumer); });
+    }
+}
+
+void produceChannel(Run* run, LoopChannel<Message>* channel)
+{
+    for(int i = 0; i < run->batch && run->sent < run->count; ++i)
+    {
+        Message m = { static_cast<uint64_t>(run->sent), nowMicros() };
+        if(!channel->trySend(m))
+        {
+            ++run->full;
+            break;
+        }
+        ++run->sent;
+    }
+    if(run->sent < run->count)
+    {
+        channel->producer()->queueInLoop([run, channel]() { produceChannel(run, channel); });
+    }
+}
+
+void report(const char* mode, Run* run, int64_t elapsed, uint64_t wakeups)
+{
+    std::vector<int64_t>& lat = run->latencies;
+    std::sort(lat.begin(), lat.end());
+    auto percentile = [&lat](double p) -> long long {
+        return lat.empty() ? 0 : lat[static_cast<size_t>(p * (lat.size() - 1))];
+    };
+    fprintf(stderr, "%-7s batch=%d messages/s=%.0f latency us: p50=%lld p99=%lld p999=%lld",
+            mode, run->batch, run->count * 1e6 / elapsed, percentile(0.5), percentile(0.99), percentile(0.999));
+    if(wakeups > 0 || strcmp(mode, "channel") == 0)
+    {
+        fprintf(stderr, " wakeups=%llu full=%ld", (unsigned long long)wakeups, run->full);
+    }
+    fprintf(stderr, "\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    long count = getIntArg(argc, argv, "--count", 2000000);
+    int batch = static_cast<int>(getIntArg(argc, argv, "--batch", 64));
+    size_t capacity = static_cast<size_t>(getIntArg(argc, argv, "--capacity", 65536));
+
+    EventLoopThread producerThread(EventLoopThread::ThreadInitCallback(), "producer");
+    EventLoopThread consumerThread(EventLoopThread::ThreadInitCallback(), "consumer");
+    EventLoop* producer = producerThread.startLoop();
+    EventLoop* consumer = consumerThread.startLoop();
+
+    {
+        Run run = { count, batch, 0, 0, 0, {}, {} };
+        run.latencies.reserve(count / 16 + 1);
+        std::future<int64_t> done = run.done.get_future();
+        int64_t start = nowMicros();
+        producer->runInLoop([&run, producer, consumer]() { produceQueue(&run, producer, consumer); });
+        report("queue", &run, done.get() - start, 0);
+    }
+    {
+        Run run = { count, batch, 0, 0, 0, {}, {} };
+        run.latencies.reserve(count / 16 + 1);
+        std::future<int64_t> done = run.done.get_future();
+        std::unique_ptr<LoopChannel<Message>> channel(new LoopChannel<Message>(producer, consumer, capacity,
+                [&run](Message& m) { onMessage(&run, m); }));
+        int64_t start = nowMicros();
+        producer->runInLoop([&run, &channel]() { produceChannel(&run, channel.get()); });
+        int64_t end = done.get();
+        report("channel", &run, end - start, channel->wakeups());
+        // 在consumer loop中注销并析构
+        std::promise<void> destroyed;
+        consumer->runInLoop([&channel, &destroyed]() {
+            channel.reset();
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+    }
+    return 0;
+}
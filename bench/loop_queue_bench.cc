@@ -0,0 +1,113 @@
+// EventLoop任务队列微基准:
+//   runInLoop in loop thread: loop线程内调用, 直接执行
+//   queueInLoop from loop thread: loop线程内排队, 下一轮执行
+//   queueInLoop producers=N: N个线程同时向一个loop排队, 从开始到最后一个任务执行完的墙钟时间 / 任务数
+// 任务只给loop线程内的计数器加一, 测的是排队、唤醒和执行std::function本身的开销
+//
+// ./loop_queue_bench --producers 1,2,4,8 --count 2000000 > /dev/null
+#include "BenchUtil.h"
+#include "EventLoopThread.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+namespace
+{
+
+struct Counter
+{
+    long executed;
+    long target;
+    std::promise<int64_t> done;
+};
+
+void increment(Counter* counter)
+{
+    if(++counter->executed == counter->target)
+    {
+        counter->done.set_value(nowNanos());
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    long count = getIntArg(argc, argv, "--count", 2000000);
+    int repeats = static_cast<int>(getIntArg(argc, argv, "--repeats", 5));
+    std::vector<int> producerCounts;
+    const char* arg = getArg(argc, argv, "--producers", "1,2,4,8");
+    for(const char* p = arg; p != nullptr && *p; p = strchr(p, ','), p = p ? p + 1 : p)
+    {
+        producerCounts.push_back(atoi(p));
+    }
+
+    EventLoopThread loopThread(EventLoopThread::ThreadInitCallback(), "queue-bench");
+    EventLoop* loop = loopThread.startLoop();
+
+    // loop线程内的两种调用方式. 在定时器回调中测: 若在pending functor中, queueInLoop每次都要唤醒
+    {
+        // 排队的任务在定时器回调返回之后才执行, 计数器放在这一层, 等任务全部执行完再离开
+        long executed = 0;
+        std::promise<std::pair<double, double>> result;
+        std::promise<void> drained;
+        loop->runAfter(0, [&]() {
+            double direct = bestNsPerOp(count, repeats, [&]() {
+                loop->runInLoop([&executed]() { ++executed; });
+            });
+            // 排队的任务在本回调返回后的doPendingFunctors中执行, 这里只测入队
+            long queued = std::min<long>(count, 200000);
+            double queue = bestNsPerOp(queued, 1, [&]() {
+                loop->queueInLoop([&executed]() { ++executed; });
+            });
+            loop->queueInLoop([&drained]() { drained.set_value(); });   // 排在所有计数任务之后
+            result.set_value(std::make_pair(direct, queue));
+        });
+        std::pair<double, double> ns = result.get_future().get();
+        drained.get_future().wait();
+        reportNsPerOp(argc, argv, "loop_queue", "runInLoop in loop thread", ns.first);
+        reportNsPerOp(argc, argv, "loop_queue", "queueInLoop from loop thread", ns.second);
+    }
+
+    for(int producers : producerCounts)
+    {
+        double best = 0;
+        for(int r = 0; r < repeats; ++r)
+        {
+            Counter counter;
+            counter.executed = 0;
+            counter.target = count / producers * producers;
+            std::future<int64_t> done = counter.done.get_future();
+            std::atomic_bool go(false);
+            std::vector<std::thread> threads;
+            for(int i = 0; i < producers; ++i)
+            {
+                threads.emplace_back([&]() {
+                    while(!go)
+                    {
+                        std::this_thread::yield();
+                    }
+                    for(long n = counter.target / producers; n > 0; --n)
+                    {
+                        loop->queueInLoop(std::bind(increment, &counter));
+                    }
+                });
+            }
+            int64_t start = nowNanos();
+            go = true;
+            int64_t end = done.get();
+            for(auto& t : threads)
+            {
+                t.join();
+            }
+            double ns = static_cast<double>(end - start) / counter.target;
+            best = r == 0 ? ns : std::min(best, ns);
+        }
+        char name[64];
+        snprintf(name, sizeof name, "queueInLoop producers=%d", producers);
+        reportNsPerOp(argc, argv, "loop_queue", name, best);
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+// 绑核与NUMA本地分配对跨节点内存访问的影响
+//
+// 客户端线程不断建立连接、ping-pong若干次后关闭，期间统计
+// /sys/devices/system/node/node*/numastat 的增量:
+//   local_node / other_node: 本节点CPU分配的页落在本地 / 远端节点
+//   numa_miss: 希望分配在本节点但落到了其它节点
+// other_node和numa_miss占比越低，跨节点内存访问越少。单节点机器上这两项恒为0。
+//
+// ./numa_bench --pin 1 --steer 1 --loops 4 --clients 8 --seconds 3 > /dev/null
+#include "BenchUtil.h"
+#include "Buffer.h"
+#include "TcpServer.h"
+
+#include <dirent.h>
+
+#include <atomic>
+#include <map>
+#include <thread>
+
+using namespace bench;
+
+using NumaStat = std::map<std::string, std::map<std::string, long>>;   // node -> 项 -> 页数
+
+static NumaStat readNumaStat()
+{
+    NumaStat stat;
+    const char* root = "/sys/devices/system/node";
+    DIR* dir = ::opendir(root);
+    if(dir == nullptr)
+    {
+        return stat;
+    }
+    while(dirent* ent = ::readdir(dir))
+    {
+        if(strncmp(ent->d_name, "node", 4) != 0 || !isdigit(ent->d_name[4]))
+        {
+            continue;
+        }
+        std::string path = std::string(root) + "/" + ent->d_name + "/numastat";
+        FILE* fp = ::fopen(path.c_str(), "r");
+        if(fp == nullptr)
+        {
+            continue;
+        }
+        char key[64];
+        long value;
+        while(fscanf(fp, "%63s %ld", key, &value) == 2)
+        {
+            stat[ent->d_name][key] = value;
+        }
+        ::fclose(fp);
+    }
+    ::closedir(dir);
+    return stat;
+}
+
+int main(int argc, char* argv[])
+{
+    bool pin = getIntArg(argc, argv, "--pin", 1) != 0;
+    bool steer = getIntArg(argc, argv, "--steer", 0) != 0;
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 8));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    int rounds = static_cast<int>(getIntArg(argc, argv, "--rounds", 16));   // 每条连接ping-pong次数
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 16384));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9982));
+
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "NumaBench");
+    if(pin)
+    {
+        // 每个subloop一个cpu，按编号轮流使用在线cpu
+        long ncpu = ::sysconf(_SC_NPROCESSORS_ONLN);
+        std::vector<std::vector<int>> cpuSets;
+        for(int i = 0; i < numLoops; ++i)
+        {
+            cpuSets.push_back(std::vector<int>(1, static_cast<int>(i % ncpu)));
+        }
+        server.setThreadCpuSets(cpuSets);
+        server.setSteerByIncomingCpu(steer);
+    }
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::atomic_bool stop(false);
+        std::atomic<long> connections(0);
+        NumaStat before = readNumaStat();
+        int64_t start = nowMicros();
+        std::vector<std::thread> clients;
+        for(int i = 0; i < numClients; ++i)
+        {
+            clients.emplace_back([&]() {
+                std::string msg(size, 'n');
+                std::string reply(size, 0);
+                while(!stop)
+                {
+                    int fd = connectLoopback(port);
+                    for(int r = 0; r < rounds; ++r)
+                    {
+                        if(!writeAll(fd, msg.data(), size) || !readAll(fd, &reply[0], size))
+                        {
+                            break;
+                        }
+                    }
+                    ::close(fd);
+                    ++connections;
+                }
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        double elapsed = (nowMicros() - start) / 1e6;
+        NumaStat after = readNumaStat();
+
+        fprintf(stderr, "pin=%d steer=%d loops=%d clients=%d size=%zu rounds=%d\n",
+                pin, steer, numLoops, numClients, size, rounds);
+        fprintf(stderr, "connections/s=%.0f\n", connections / elapsed);
+        long local = 0, other = 0, miss = 0;
+        for(auto& node : after)
+        {
+            std::map<std::string, long>& b = before[node.first];
+            long l = node.second["local_node"] - b["local_node"];
+            long o = node.second["other_node"] - b["other_node"];
+            long m = node.second["numa_miss"] - b["numa_miss"];
+            fprintf(stderr, "%s: local_node=%ld other_node=%ld numa_miss=%ld\n",
+                    node.first.c_str(), l, o, m);
+            local += l;
+            other += o;
+            miss += m;
+        }
+        if(local + other > 0)
+        {
+            fprintf(stderr, "cross-node pages=%.2f%% numa_miss=%ld\n",
+                    100.0 * other / (local + other), miss);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,103 @@
+// ping-pong往返延迟: 服务端loops个loop回显, 每条连接一个客户端线程,
+// 每次写size字节、读回size字节后才发下一条, 往返时间记入HDR直方图(ns精度),
+// 报告round-trips/s和p50/p99/p999/max, 以及服务端连接统计中的响应时间(收到请求到写完响应)
+//
+// ./pingpong_bench --loops 1 --connections 1 --size 64 --seconds 3 > /dev/null
+// ./pingpong_bench --connections 16 --json results.jsonl --tag v1.2
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace bench;
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 1));
+    int numConnections = static_cast<int>(getIntArg(argc, argv, "--connections", 1));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9992));
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "PingPongBench");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        conn->send(input);
+    });
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::atomic_bool stop(false);
+        std::atomic<int> failed(0);
+        std::mutex mutex;
+        Histogram total;
+        std::vector<std::thread> clients;
+        int64_t start = nowMicros();
+        for(int i = 0; i < numConnections; ++i)
+        {
+            clients.emplace_back([&]() {
+                int fd = connectLoopback(port);
+                if(fd < 0)
+                {
+                    ++failed;
+                    return;
+                }
+                std::string message(size, 'p');
+                std::string reply(size, '\0');
+                Histogram latency;
+                while(!stop)
+                {
+                    int64_t begin = nowNanos();
+                    if(!writeAll(fd, message.data(), size) || !readAll(fd, &reply[0], size))
+                    {
+                        ++failed;
+                        break;
+                    }
+                    latency.record(nowNanos() - begin);
+                }
+                ::close(fd);
+                std::lock_guard<std::mutex> lock(mutex);
+                total.merge(latency);
+            });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : clients)
+        {
+            t.join();
+        }
+        int64_t elapsed = nowMicros() - start;
+        StatsHistogram::Snapshot response = server.connectionHistograms().responseMicros;
+
+        double roundTripsPerSec = total.count() * 1e6 / elapsed;
+        fprintf(stderr, "loops=%d connections=%d size=%zu failed=%d\n", numLoops, numConnections, size, failed.load());
+        fprintf(stderr, "round-trips/s=%.0f latency us: p50=%.1f p99=%.1f p999=%.1f max=%.1f mean=%.1f\n",
+                roundTripsPerSec, total.percentile(0.5) / 1e3, total.percentile(0.99) / 1e3,
+                total.percentile(0.999) / 1e3, total.max() / 1e3, total.mean() / 1e3);
+        fprintf(stderr, "server response us: p50=%llu p99=%llu max=%llu\n",
+                (unsigned long long)response.percentile(0.5), (unsigned long long)response.percentile(0.99),
+                (unsigned long long)response.max);
+        JsonResult("pingpong")
+            .add("loops", numLoops).add("connections", numConnections).add("size", size)
+            .add("seconds", seconds).add("failures", failed.load())
+            .add("round_trips_per_sec", roundTripsPerSec)
+            .addPercentiles("latency_ns", total)
+            .add("server_response_us_p50", response.percentile(0.5))
+            .add("server_response_us_p99", response.percentile(0.99))
+            .emit(argc, argv);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Poller与Channel微基准:
+//   enable+disableAll+remove: EPOLL_CTL_ADD, EPOLL_CTL_DEL, 再从poller的map中删除, 即一条短连接的注册开销
+//   enableWriting+disableWriting: 已注册channel上两次EPOLL_CTL_MOD, 即每次写不完时的开销
+//   handleEvent untied/tied: 直接调用Channel::handleEvent分发到空的读回调, tied多一次weak_ptr::lock
+//   loop dispatch channels=K: K个始终可读的eventfd, 每轮loop poll到K个事件并逐个分发, 墙钟时间 / 事件数
+//
+// ./poller_bench --channels 1,16,256 --repeats 5 > /dev/null
+#include "BenchUtil.h"
+#include "Channel.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+using namespace bench;
+
+int main(int argc, char* argv[])
+{
+    int repeats = static_cast<int>(getIntArg(argc, argv, "--repeats", 5));
+    long iterations = getIntArg(argc, argv, "--iterations", 200000);
+    std::vector<int> channelCounts;
+    const char* arg = getArg(argc, argv, "--channels", "1,16,256");
+    for(const char* p = arg; p != nullptr && *p; p = strchr(p, ','), p = p ? p + 1 : p)
+    {
+        channelCounts.push_back(atoi(p));
+    }
+
+    EventLoop loop;
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    {
+        Channel channel(&loop, fd);
+        double ns = bestNsPerOp(iterations, repeats, [&]() {
+            channel.enableReading();
+            channel.disableAll();
+            channel.remove();
+        });
+        reportNsPerOp(argc, argv, "poller", "enable+disableAll+remove", ns);
+
+        channel.enableReading();
+        ns = bestNsPerOp(iterations, repeats, [&]() {
+            channel.enableWriting();
+            channel.disableWriting();
+        });
+        reportNsPerOp(argc, argv, "poller", "enableWriting+disableWriting", ns);
+        channel.disableAll();
+        channel.remove();
+
+        long reads = 0;
+        channel.setReadCallback([&reads](Timestamp) { ++reads; });
+        channel.set_revents(EPOLLIN);
+        Timestamp now = Timestamp::now();
+        ns = bestNsPerOp(iterations * 10, repeats, [&]() { channel.handleEvent(now); });
+        reportNsPerOp(argc, argv, "poller", "handleEvent untied", ns);
+
+        std::shared_ptr<int> owner = std::make_shared<int>(0);
+        channel.tie(owner);
+        ns = bestNsPerOp(iterations * 10, repeats, [&]() { channel.handleEvent(now); });
+        reportNsPerOp(argc, argv, "poller", "handleEvent tied", ns);
+    }
+    ::close(fd);
+
+    for(int k : channelCounts)
+    {
+        std::vector<int> fds;
+        std::vector<std::unique_ptr<Channel>> channels;
+        long events = 0;
+        long target = 0;
+        for(int i = 0; i < k; ++i)
+        {
+            int efd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);     // 计数非零且从不读, 一直可读
+            fds.push_back(efd);
+            channels.emplace_back(new Channel(&loop, efd));
+            channels.back()->setReadCallback([&](Timestamp) {
+                if(++events == target)
+                {
+                    loop.quit();
+                }
+            });
+            channels.back()->enableReading();
+        }
+        double best = 0;
+        for(int r = 0; r < repeats; ++r)
+        {
+            events = 0;
+            target = std::max<long>(iterations * 5 / k, 1) * k;
+            int64_t start = nowNanos();
+            loop.loop();
+            double ns = static_cast<double>(nowNanos() - start) / events;
+            best = r == 0 ? ns : std::min(best, ns);
+        }
+        char name[64];
+        snprintf(name, sizeof name, "loop dispatch channels=%d", k);
+        reportNsPerOp(argc, argv, "poller", name, best);
+        for(size_t i = 0; i < channels.size(); ++i)
+        {
+            channels[i]->disableAll();
+            channels[i]->remove();
+            ::close(fds[i]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// RESP负载生成器, 类似redis-benchmark: 对已运行的example/kv_server(或redis-server)
+// 发送流水线SET/GET, 报告ops/s和每轮延迟分位数
+//
+// ./kv_server 6380 4 &
+// ./resp_bench --port 6380 --test get --clients 50 --pipeline 16 --seconds 5
+#include "BenchUtil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace bench;
+
+static std::string encodeCommand(const std::vector<std::string>& args)
+{
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for(const std::string& a : args)
+    {
+        out += "$" + std::to_string(a.size()) + "\r\n" + a + "\r\n";
+    }
+    return out;
+}
+
+// 读满count个响应(简单/整数/错误/bulk), 不支持数组响应
+static bool readReplies(int fd, int count, std::string* pending)
+{
+    char buf[64 * 1024];
+    size_t pos = 0;
+    while(count > 0)
+    {
+        size_t eol = pending->find("\r\n", pos);
+        if(eol != std::string::npos)
+        {
+            char type = (*pending)[pos];
+            size_t next = eol + 2;
+            if(type == '$')
+            {
+                long len = atol(pending->c_str() + pos + 1);
+                if(len >= 0)
+                {
+                    next += len + 2;
+                }
+            }
+            if(next <= pending->size())
+            {
+                pos = next;
+                --count;
+                continue;
+            }
+        }
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if(n <= 0)
+        {
+            return false;
+        }
+        pending->append(buf, n);
+    }
+    pending->erase(0, pos);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 6380));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 50));
+    int pipeline = static_cast<int>(getIntArg(argc, argv, "--pipeline", 1));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 5));
+    long keyspace = getIntArg(argc, argv, "--keyspace", 100000);
+    size_t valueSize = static_cast<size_t>(getIntArg(argc, argv, "--value", 3));
+    bool isSet = strcmp(getArg(argc, argv, "--test", "set"), "set") == 0;
+
+    std::atomic_bool stop(false);
+    std::mutex mutex;
+    std::vector<int64_t> latencies;
+    long ops = 0;
+    int failed = 0;
+    std::vector<std::thread> clients;
+    int64_t start = nowMicros();
+    for(int i = 0; i < numClients; ++i)
+    {
+        clients.emplace_back([&, i]() {
+            std::minstd_rand rand(i + 1);
+            std::string value(valueSize, 'x');
+            int fd = connectLoopback(port);
+            std::vector<int64_t> local;
+            std::string pending;
+            while(fd >= 0 && !stop)
+            {
+                std::string batch;
+                for(int j = 0; j < pipeline; ++j)
+                {
+                    std::string key = "key:" + std::to_string(rand() % keyspace);
+                    batch += isSet ? encodeCommand({ "SET", key, value }) : encodeCommand({ "GET", key });
+                }
+                int64_t begin = nowMicros();
+                if(!writeAll(fd, batch.data(), batch.size()) || !readReplies(fd, pipeline, &pending))
+                {
+                    break;
+                }
+                local.push_back(nowMicros() - begin);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if(fd < 0)
+            {
+                ++failed;
+            }
+            else
+            {
+                ::close(fd);
+            }
+            latencies.insert(latencies.end(), local.begin(), local.end());
+            ops += static_cast<long>(local.size()) * pipeline;
+        });
+    }
+    sleep(seconds);
+    stop = true;
+    for(auto& t : clients)
+    {
+        t.join();
+    }
+    int64_t elapsed = nowMicros() - start;
+    if(failed == numClients)
+    {
+        fprintf(stderr, "cannot connect to 127.0.0.1:%u, start example/kv_server first\n", port);
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> long long {
+        return latencies.empty() ? 0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    fprintf(stderr, "test=%s clients=%d pipeline=%d keyspace=%ld value=%zu\n",
+            isSet ? "set" : "get", numClients, pipeline, keyspace, valueSize);
+    fprintf(stderr, "ops=%ld ops/s=%.0f\n", ops, ops * 1e6 / elapsed);
+    fprintf(stderr, "round latency us: p50=%lld p99=%lld p999=%lld max=%lld\n",
+            percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0));
+    return 0;
+}
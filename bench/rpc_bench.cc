@@ -0,0 +1,183 @@
+// RPC吞吐和延迟: 进程内起RpcServer, clients个RpcClient分布在若干客户端loop上,
+// 每个客户端始终保持inflight个未完成调用(收到一个响应立即补发一个), 报告calls/s和单次调用延迟分位数
+//
+// ./rpc_bench --loops 4 --clients 16 --inflight 64 --payload 64 --seconds 3 > /dev/null
+// ./rpc_bench --async 1       # 服务端用异步方法, 回复经Reply排队发送
+#include "BenchUtil.h"
+#include "EventLoopThread.h"
+#include "RpcClient.h"
+#include "RpcServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+namespace
+{
+
+struct ClientDriver
+{
+    EventLoop* loop;
+    std::unique_ptr<RpcClient> client;
+    std::vector<int64_t> latencies;     // 只在loop线程中访问
+    long failed = 0;
+};
+
+std::atomic_bool g_stop(false);
+uint32_t g_echoId = 0;
+std::string g_payload;
+
+void issue(ClientDriver* d)
+{
+    int64_t begin = nowMicros();
+    d->client->call(g_echoId, g_payload, [d, begin](rpc::RpcStatus status, StringPiece) {
+        if(status == rpc::kOk)
+        {
+            d->latencies.push_back(nowMicros() - begin);
+        }
+        else
+        {
+            ++d->failed;
+        }
+        if(!g_stop)
+        {
+            issue(d);
+        }
+    });
+}
+
+// 启动前的正确性检查: 未知方法, 超时, 响应内容
+bool sanityCheck(RpcClient* client, uint32_t sleepId)
+{
+    std::promise<bool> unknown, timeout, echo;
+    client->call("NoSuchMethod", "x", [&unknown](rpc::RpcStatus s, StringPiece) {
+        unknown.set_value(s == rpc::kMethodNotFound);
+    });
+    client->call(sleepId, "", [&timeout](rpc::RpcStatus s, StringPiece) {
+        timeout.set_value(s == rpc::kDeadlineExceeded);
+    }, 0.05);
+    client->call(g_echoId, "hello", [&echo](rpc::RpcStatus s, StringPiece r) {
+        echo.set_value(s == rpc::kOk && r == "hello");
+    });
+    bool ok = unknown.get_future().get() & timeout.get_future().get() & echo.get_future().get();
+    fprintf(stderr, "sanity check: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 4));
+    int numClientLoops = static_cast<int>(getIntArg(argc, argv, "--client-loops", 1));
+    int numClients = static_cast<int>(getIntArg(argc, argv, "--clients", 16));
+    int inflight = static_cast<int>(getIntArg(argc, argv, "--inflight", 64));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    size_t payloadSize = static_cast<size_t>(getIntArg(argc, argv, "--payload", 64));
+    bool async = getIntArg(argc, argv, "--async", 0) != 0;
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9987));
+
+    g_payload.assign(payloadSize, 'x');
+    EventLoop loop;
+    RpcServer server(&loop, InetAddress(port), "RpcBench");
+    if(async)
+    {
+        g_echoId = server.registerAsyncMethod("Echo", [](StringPiece request, const RpcServer::Reply& reply) {
+            reply.send(request);
+        });
+    }
+    else
+    {
+        g_echoId = server.registerMethod("Echo", [](StringPiece request, Buffer* response) {
+            response->append(request.data(), request.size());
+        });
+    }
+    // 永不回复, 用于检查客户端超时
+    uint32_t sleepId = server.registerAsyncMethod("Sleep", [](StringPiece, const RpcServer::Reply&) {});
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<std::unique_ptr<EventLoopThread>> threads;
+        std::vector<EventLoop*> clientLoops;
+        for(int i = 0; i < numClientLoops; ++i)
+        {
+            threads.emplace_back(new EventLoopThread(EventLoopThread::ThreadInitCallback(), "client"));
+            clientLoops.push_back(threads.back()->startLoop());
+        }
+        std::vector<std::unique_ptr<ClientDriver>> drivers;
+        for(int i = 0; i < numClients; ++i)
+        {
+            std::unique_ptr<ClientDriver> d(new ClientDriver);
+            d->loop = clientLoops[i % clientLoops.size()];
+            d->client.reset(new RpcClient(d->loop, InetAddress(port), "client" + std::to_string(i)));
+            d->client->connect();
+            drivers.push_back(std::move(d));
+        }
+        for(auto& d : drivers)
+        {
+            for(int ms = 0; !d->client->connected(); ++ms)
+            {
+                if(ms == 5000)
+                {
+                    fprintf(stderr, "cannot connect to 127.0.0.1:%u\n", port);
+                    exit(1);
+                }
+                usleep(1000);
+            }
+        }
+        if(!sanityCheck(drivers[0]->client.get(), sleepId))
+        {
+            exit(1);
+        }
+
+        int64_t start = nowMicros();
+        for(auto& d : drivers)
+        {
+            ClientDriver* p = d.get();
+            p->loop->runInLoop([p, inflight]() {
+                for(int j = 0; j < inflight; ++j)
+                {
+                    issue(p);
+                }
+            });
+        }
+        sleep(seconds);
+        g_stop = true;
+        int64_t elapsed = nowMicros() - start;
+
+        // 在各自loop中取走结果并断开, 之后客户端在loop线程中析构
+        std::vector<int64_t> latencies;
+        long failed = 0;
+        for(auto& d : drivers)
+        {
+            std::promise<void> done;
+            ClientDriver* p = d.get();
+            p->loop->runInLoop([p, &latencies, &failed, &done]() {
+                latencies.insert(latencies.end(), p->latencies.begin(), p->latencies.end());
+                failed += p->failed;
+                p->client.reset();
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+        long calls = static_cast<long>(latencies.size());
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) -> long long {
+            return latencies.empty() ? 0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+        };
+        fprintf(stderr, "loops=%d client-loops=%d clients=%d inflight=%d payload=%zu handler=%s\n",
+                numLoops, numClientLoops, numClients, inflight, payloadSize, async ? "async" : "sync");
+        fprintf(stderr, "calls=%ld calls/s=%.0f failed=%ld\n", calls, calls * 1e6 / elapsed, failed);
+        fprintf(stderr, "call latency us: p50=%lld p90=%lld p99=%lld p999=%lld max=%lld\n",
+                percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
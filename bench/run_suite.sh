@@ -0,0 +1,31 @@
+#!/bin/sh
+# 依次运行基础压测和微基准, 结果以JSON行追加到OUTPUT, 用于比较不同版本
+# bench/run_suite.sh <build目录下的bench目录> [OUTPUT] [TAG]
+# 例: bench/run_suite.sh build/bench results.jsonl "$(git describe --always)"
+set -e
+dir=${1:?usage: run_suite.sh BENCH_DIR [OUTPUT] [TAG]}
+out=${2:-bench_results.jsonl}
+tag=${3:-}
+loops=${LOOPS:-4}
+seconds=${SECONDS_PER_RUN:-3}
+
+run() {
+    echo "== $*" >&2
+    bench=$1
+    shift
+    "$dir/$bench" "$@" --json "$out" --tag "$tag" > /dev/null
+}
+
+for size in 64 4096; do
+    run echo_bench --loops "$loops" --connections 64 --size "$size" --seconds "$seconds"
+done
+for conns in 1 16; do
+    run pingpong_bench --loops "$loops" --connections "$conns" --seconds "$seconds"
+done
+run churn_bench --loops "$loops" --clients 4 --seconds "$seconds"
+run stream_bench --loops "$loops" --connections 2 --mb 1024
+
+# 原语的微基准, 每个case一行
+run buffer_bench
+run loop_queue_bench
+run poller_bench
@@ -0,0 +1,185 @@
+// 同机两个进程之间的共享内存连接与AF_UNIX的对比: 子进程运行ShmServer和监听Unix域socket的TcpServer, 都回显;
+// 父进程分别用ShmClient和TcpClient发送size字节的定长消息, 同时在途的不超过window条,
+// 报告messages/s、往返延迟分位数, 共享内存一侧还报告每条消息平均写了几次对方的eventfd
+//
+// ./shm_bench --size 64 --count 200000 --window 1,64 > /dev/null
+#include "BenchUtil.h"
+#include "ShmClient.h"
+#include "ShmServer.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <deque>
+
+using namespace bench;
+
+namespace
+{
+
+struct Run
+{
+    EventLoop* loop;
+    size_t size;
+    long count;
+    long window;
+    std::string message;
+    long sent;
+    long received;
+    std::deque<int64_t> sendTimes;
+    std::vector<int64_t> latencies;
+    int64_t start;
+    int64_t elapsed;
+};
+
+template<typename ConnPtr>
+void fill(Run* run, const ConnPtr& conn)
+{
+    while(run->sent < run->count && run->sent - run->received < run->window)
+    {
+        run->sendTimes.push_back(nowMicros());
+        conn->send(run->message);
+        ++run->sent;
+    }
+}
+
+// 两种连接的输入(Buffer/ShmBuffer)接口相同, 按完整的消息计数, 每收到一条补发一条
+template<typename ConnPtr, typename Input>
+void onReply(Run* run, const ConnPtr& conn, Input* input)
+{
+    size_t n = input->readableBytes() / run->size;
+    input->retrieve(n * run->size);
+    int64_t now = nowMicros();
+    for(size_t i = 0; i < n; ++i)
+    {
+        run->latencies.push_back(now - run->sendTimes.front());
+        run->sendTimes.pop_front();
+    }
+    run->received += static_cast<long>(n);
+    if(run->received == run->count)
+    {
+        run->elapsed = nowMicros() - run->start;
+        run->loop->quit();
+        return;
+    }
+    fill(run, conn);
+}
+
+void report(const char* transport, Run* run, uint64_t notifications)
+{
+    std::vector<int64_t>& lat = run->latencies;
+    std::sort(lat.begin(), lat.end());
+    auto percentile = [&lat](double p) -> long long {
+        return lat.empty() ? 0 : lat[static_cast<size_t>(p * (lat.size() - 1))];
+    };
+    fprintf(stderr, "%-4s size=%zu window=%ld messages/s=%.0f latency us: p50=%lld p99=%lld p999=%lld max=%lld",
+            transport, run->size, run->window, run->received * 1e6 / run->elapsed,
+            percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0));
+    if(notifications > 0)
+    {
+        fprintf(stderr, " notifications/message=%.3f", static_cast<double>(notifications) / run->received);
+    }
+    fprintf(stderr, "\n");
+}
+
+void runShm(EventLoop* loop, const std::string& path, Run* run)
+{
+    ShmClient client(loop, InetAddress::unixDomain(path), "ShmBench");
+    client.setConnectionCallback([run](const ShmConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            run->start = nowMicros();
+            fill(run, conn);
+        }
+    });
+    client.setMessageCallback([run](const ShmConnectionPtr& conn, ShmBuffer* input, Timestamp) {
+        onReply(run, conn, input);
+    });
+    client.connect();
+    loop->loop();
+    report("shm", run, client.connection()->notifications());
+}
+
+void runUnix(EventLoop* loop, const std::string& path, Run* run)
+{
+    TcpClient client(loop, InetAddress::unixDomain(path), "UnixBench");
+    client.setConnectionCallback([run](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            run->start = nowMicros();
+            fill(run, conn);
+        }
+    });
+    client.setMessageCallback([run](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        onReply(run, conn, input);
+    });
+    client.connect();
+    loop->loop();
+    report("unix", run, 0);
+}
+
+void runServer(const std::string& shmPath, const std::string& unixPath)
+{
+    EventLoop loop;
+    ShmServer shmServer(&loop, InetAddress::unixDomain(shmPath), "ShmEcho");
+    shmServer.setMessageCallback([](const ShmConnectionPtr& conn, ShmBuffer* input, Timestamp) {
+        conn->send(input->peek(), input->readableBytes());
+        input->retrieveAll();
+    });
+    shmServer.start();
+
+    TcpServer unixServer(&loop, InetAddress::unixDomain(unixPath), "UnixEcho");
+    unixServer.setConnectionCallback([](const TcpConnectionPtr&) {});
+    unixServer.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        conn->send(input);
+    });
+    unixServer.setThreadNum(0);
+    unixServer.start();
+    loop.loop();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    long count = getIntArg(argc, argv, "--count", 200000);
+    std::string windows = getArg(argc, argv, "--window", "1,64");
+    std::string shmPath = getArg(argc, argv, "--shm-path", "@moduo-shm-bench");
+    std::string unixPath = getArg(argc, argv, "--unix-path", "@moduo-shm-bench-unix");
+
+    pid_t server = ::fork();
+    if(server == 0)
+    {
+        runServer(shmPath, unixPath);
+        return 0;
+    }
+
+    EventLoop loop;
+    size_t pos = 0;
+    while(pos < windows.size())
+    {
+        size_t comma = windows.find(',', pos);
+        if(comma == std::string::npos)
+        {
+            comma = windows.size();
+        }
+        long window = atol(windows.substr(pos, comma - pos).c_str());
+        pos = comma + 1;
+
+        Run shm = { &loop, size, count, window, std::string(size, 'm'), 0, 0, {}, {}, 0, 0 };
+        shm.latencies.reserve(count);
+        runShm(&loop, shmPath, &shm);
+        Run uds = shm;
+        uds.sent = uds.received = 0;
+        uds.latencies.clear();
+        runUnix(&loop, unixPath, &uds);
+    }
+
+    ::kill(server, SIGTERM);
+    ::waitpid(server, nullptr, 0);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// 大块数据流式回显: 每条连接一个写线程不停写block字节的块, 一个读线程读回, 各传mb MB,
+// 服务端loops个loop回显. 报告总的单向MB/s和服务端每MB的CPU时间
+//
+// ./stream_bench --loops 2 --connections 2 --block 1048576 --mb 1024 > /dev/null
+// ./stream_bench --json results.jsonl --tag v1.2
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 2));
+    int numConnections = static_cast<int>(getIntArg(argc, argv, "--connections", 2));
+    size_t block = static_cast<size_t>(getIntArg(argc, argv, "--block", 1 << 20));
+    size_t total = static_cast<size_t>(getIntArg(argc, argv, "--mb", 1024)) << 20;
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9993));
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "StreamBench");
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        conn->send(input);
+    });
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+        std::atomic<size_t> received(0);
+        std::atomic<int> failed(0);
+        std::vector<std::thread> threads;
+        std::vector<int64_t> cpuBefore = loopCpuMicros(loops);
+        int64_t start = nowMicros();
+        for(int i = 0; i < numConnections; ++i)
+        {
+            int fd = connectLoopback(port);
+            if(fd < 0)
+            {
+                ++failed;
+                continue;
+            }
+            threads.emplace_back([fd, block, total]() {
+                std::string data(block, 's');
+                for(size_t sent = 0; sent < total; sent += block)
+                {
+                    if(!writeAll(fd, data.data(), std::min(block, total - sent)))
+                    {
+                        return;
+                    }
+                }
+            });
+            threads.emplace_back([fd, block, total, &received]() {
+                std::vector<char> input(block);
+                size_t n = 0;
+                while(n < total)
+                {
+                    ssize_t r = ::read(fd, input.data(), input.size());
+                    if(r <= 0)
+                    {
+                        break;
+                    }
+                    n += r;
+                }
+                received += n;
+                ::close(fd);
+            });
+        }
+        for(auto& t : threads)
+        {
+            t.join();
+        }
+        int64_t elapsed = nowMicros() - start;
+        std::vector<int64_t> cpuAfter = loopCpuMicros(loops);
+        int64_t cpu = 0;
+        for(size_t i = 0; i < loops.size(); ++i)
+        {
+            cpu += cpuAfter[i] - cpuBefore[i];
+        }
+
+        double mb = received / static_cast<double>(1 << 20);
+        double mbPerSec = mb / (elapsed / 1e6);
+        double cpuUsPerMb = mb > 0 ? cpu / mb : 0;
+        fprintf(stderr, "loops=%d connections=%d block=%zu mb/connection=%zu failed=%d\n",
+                numLoops, numConnections, block, total >> 20, failed.load());
+        fprintf(stderr, "MB/s=%.1f (%.0f MB in %.2f s) server cpu us/MB=%.0f\n",
+                mbPerSec, mb, elapsed / 1e6, cpuUsPerMb);
+        JsonResult("stream")
+            .add("loops", numLoops).add("connections", numConnections).add("block", block)
+            .add("mb_per_connection", total >> 20).add("failed_connects", failed.load())
+            .add("mb_per_sec", mbPerSec).add("server_cpu_us_per_mb", cpuUsPerMb)
+            .emit(argc, argv);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,168 @@
+// UDP收包速度: 进程内起UdpServer, senders个线程各用一个socket(源端口不同, SO_REUSEPORT按四元组分散到各loop)
+// 以sendmmsg尽力发送size字节的报文, 报告服务端收到的packets/s和每核packets/s(收包数 / loop线程CPU时间)
+//
+// ./udp_bench --loops 2 --senders 2 --size 64 --seconds 3 > /dev/null
+// ./udp_bench --client-gso 32     # 发送端每个sendmmsg消息用UDP_SEGMENT携带32个报文, 服务端开GRO时成批收到
+// ./udp_bench --gro 0 --echo 1    # 关闭GRO, 服务端回显每个报文(测sendmmsg/GSO回复路径)
+#include "BenchUtil.h"
+#include "UdpServer.h"
+
+#include <netinet/udp.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace bench;
+
+static long senderLoop(uint16_t port, size_t size, int gsoSegments, int batch, std::atomic_bool* stop)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(fd, (sockaddr*)&addr, sizeof addr);
+
+    int perMessage = gsoSegments > 1 ? gsoSegments : 1;
+    std::string payload(size * perMessage, 'u');
+    std::vector<mmsghdr> msgs(batch);
+    std::vector<iovec> iovs(batch);
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    for(int i = 0; i < batch; ++i)
+    {
+        iovs[i].iov_base = &payload[0];
+        iovs[i].iov_len = payload.size();
+        memset(&msgs[i].msg_hdr, 0, sizeof msgs[i].msg_hdr);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if(gsoSegments > 1)
+        {
+            // 所有消息共用同一个只读的cmsg
+            msgs[i].msg_hdr.msg_control = control;
+            msgs[i].msg_hdr.msg_controllen = sizeof control;
+        }
+    }
+    if(gsoSegments > 1)
+    {
+        cmsghdr* cm = CMSG_FIRSTHDR(&msgs[0].msg_hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment = static_cast<uint16_t>(size);
+        memcpy(CMSG_DATA(cm), &segment, sizeof segment);
+    }
+
+    long sent = 0;
+    while(!*stop)
+    {
+        int n = ::sendmmsg(fd, msgs.data(), batch, 0);
+        if(n < 0)
+        {
+            if(errno == ENOBUFS || errno == EAGAIN || errno == ECONNREFUSED)
+            {
+                continue;
+            }
+            fprintf(stderr, "sendmmsg errno = %d (%s)\n", errno, strerror(errno));
+            break;
+        }
+        sent += static_cast<long>(n) * perMessage;
+    }
+    ::close(fd);
+    return sent;
+}
+
+int main(int argc, char* argv[])
+{
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 2));
+    int numSenders = static_cast<int>(getIntArg(argc, argv, "--senders", 2));
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 3));
+    int clientGso = static_cast<int>(getIntArg(argc, argv, "--client-gso", 0));
+    int batch = static_cast<int>(getIntArg(argc, argv, "--batch", 64));
+    bool gro = getIntArg(argc, argv, "--gro", 1) != 0;
+    bool echo = getIntArg(argc, argv, "--echo", 0) != 0;
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9990));
+
+    EventLoop loop;
+    InetAddress addr(port);
+    UdpServer server(&loop, addr, "UdpBench");
+    UdpChannel::Options options;
+    options.batchSize = batch;
+    options.gro = gro;
+    server.setOptions(options);
+    server.setThreadNum(numLoops);
+    if(echo)
+    {
+        server.setMessageCallback([](UdpChannel* channel, const InetAddress& peer, StringPiece data, Timestamp) {
+            channel->send(peer, data);
+        });
+    }
+    server.start();
+
+    std::thread driver([&]() {
+        std::vector<EventLoop*> loops;
+        for(auto& channel : server.channels())
+        {
+            loops.push_back(channel->getLoop());
+        }
+        std::vector<int64_t> cpuBefore = loopCpuMicros(loops);
+        uint64_t recvBefore = 0;
+        for(auto& channel : server.channels())
+        {
+            recvBefore += channel->packetsReceived();
+        }
+
+        std::atomic_bool stop(false);
+        std::vector<long> sent(numSenders);
+        std::vector<std::thread> senders;
+        int64_t start = nowMicros();
+        for(int i = 0; i < numSenders; ++i)
+        {
+            senders.emplace_back([&, i]() { sent[i] = senderLoop(port, size, clientGso, batch, &stop); });
+        }
+        sleep(seconds);
+        stop = true;
+        for(auto& t : senders)
+        {
+            t.join();
+        }
+        usleep(100 * 1000);     // 让已在socket缓冲区中的报文处理完
+        int64_t elapsed = nowMicros() - start;
+        std::vector<int64_t> cpuAfter = loopCpuMicros(loops);
+
+        long totalSent = 0;
+        for(long n : sent)
+        {
+            totalSent += n;
+        }
+        uint64_t received = 0, replies = 0, syscalls = 0, drops = 0;
+        int64_t cpu = 0;
+        for(size_t i = 0; i < server.channels().size(); ++i)
+        {
+            const UdpChannel& c = *server.channels()[i];
+            received += c.packetsReceived();
+            replies += c.packetsSent();
+            syscalls += c.recvSyscalls();
+            drops += c.drops();
+            cpu += cpuAfter[i] - cpuBefore[i];
+            fprintf(stderr, "  loop %zu: received=%llu cpu_ms=%lld\n", i,
+                    (unsigned long long)c.packetsReceived(), (long long)(cpuAfter[i] - cpuBefore[i]) / 1000);
+        }
+        received -= recvBefore;
+        fprintf(stderr, "loops=%zu senders=%d size=%zu client-gso=%d gro=%d gso=%d echo=%d\n",
+                loops.size(), numSenders, size, clientGso, server.channels()[0]->groEnabled(),
+                server.channels()[0]->gsoEnabled(), echo);
+        fprintf(stderr, "sent=%ld received=%llu (%.1f%%) replies=%llu drops=%llu\n",
+                totalSent, (unsigned long long)received, totalSent ? 100.0 * received / totalSent : 0.0,
+                (unsigned long long)replies, (unsigned long long)drops);
+        fprintf(stderr, "packets/s=%.0f packets/s/core=%.0f packets/recvmmsg=%.1f\n",
+                received * 1e6 / elapsed, cpu > 0 ? received * 1e6 / cpu : 0.0,
+                syscalls ? static_cast<double>(received) / syscalls : 0.0);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
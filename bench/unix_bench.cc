@@ -0,0 +1,131 @@
+// 同一套TcpServer/TcpConnection分别跑在loopback TCP和AF_UNIX上的对比:
+// ping-pong单连接往返延迟分位数, 以及单连接双向流式回显的吞吐
+//
+// ./unix_bench --size 64 --count 100000 --mb 512 > /dev/null
+// ./unix_bench --path /tmp/unix_bench.sock     # 用文件系统路径代替abstract namespace
+#include "BenchUtil.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace bench;
+
+namespace
+{
+
+void pingPong(const char* transport, int fd, size_t size, long count)
+{
+    std::string message(size, 'p');
+    std::string reply(size, 0);
+    std::vector<int64_t> latencies;
+    latencies.reserve(count);
+    int64_t start = nowMicros();
+    for(long i = 0; i < count; ++i)
+    {
+        int64_t begin = nowMicros();
+        if(!writeAll(fd, message.data(), size) || !readAll(fd, &reply[0], size))
+        {
+            fprintf(stderr, "%s: connection lost after %ld round trips\n", transport, i);
+            return;
+        }
+        latencies.push_back(nowMicros() - begin);
+    }
+    int64_t elapsed = nowMicros() - start;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> long long {
+        return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    fprintf(stderr, "%-4s ping-pong size=%zu round-trips/s=%.0f latency us: p50=%lld p99=%lld p999=%lld max=%lld\n",
+            transport, size, count * 1e6 / elapsed,
+            percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0));
+}
+
+// 一个线程不停写, 本线程读回显, 统计单向的有效吞吐
+void stream(const char* transport, int fd, size_t block, size_t total)
+{
+    std::thread writer([fd, block, total]() {
+        std::string data(block, 's');
+        for(size_t sent = 0; sent < total; sent += block)
+        {
+            if(!writeAll(fd, data.data(), std::min(block, total - sent)))
+            {
+                return;
+            }
+        }
+    });
+    std::vector<char> input(block);
+    size_t received = 0;
+    int64_t start = nowMicros();
+    while(received < total)
+    {
+        ssize_t n = ::read(fd, input.data(), input.size());
+        if(n <= 0)
+        {
+            break;
+        }
+        received += n;
+    }
+    int64_t elapsed = nowMicros() - start;
+    writer.join();
+    fprintf(stderr, "%-4s stream block=%zu MB/s=%.1f (%zu bytes in %.2f s)\n",
+            transport, block, received / (elapsed / 1e6) / (1 << 20), received, elapsed / 1e6);
+}
+
+void run(const char* transport, int fd, size_t size, long count, size_t block, size_t total)
+{
+    if(fd < 0)
+    {
+        fprintf(stderr, "%s: connect failed: %s\n", transport, strerror(errno));
+        return;
+    }
+    pingPong(transport, fd, size, count);
+    stream(transport, fd, block, total);
+    ::close(fd);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t size = static_cast<size_t>(getIntArg(argc, argv, "--size", 64));
+    long count = getIntArg(argc, argv, "--count", 100000);
+    size_t block = static_cast<size_t>(getIntArg(argc, argv, "--block", 64 * 1024));
+    size_t total = static_cast<size_t>(getIntArg(argc, argv, "--mb", 512)) << 20;
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9988));
+    std::string path = getArg(argc, argv, "--path", "@moduo-unix-bench");
+
+    EventLoop loop;
+    auto echo = [](const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+        conn->send(input);
+    };
+    auto onConnection = [](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);  // Unix域socket上无效, 忽略
+        }
+    };
+    // 两个server各用一个loop线程, 服务端代码完全相同, 只有监听地址不同
+    TcpServer tcpServer(&loop, InetAddress(port), "TcpEcho");
+    tcpServer.setConnectionCallback(onConnection);
+    tcpServer.setMessageCallback(echo);
+    tcpServer.setThreadNum(1);
+    tcpServer.start();
+
+    TcpServer unixServer(&loop, InetAddress::unixDomain(path), "UnixEcho");
+    unixServer.setConnectionCallback(onConnection);
+    unixServer.setMessageCallback(echo);
+    unixServer.setThreadNum(1);
+    unixServer.start();
+
+    std::thread driver([&]() {
+        usleep(100 * 1000);     // 等两个server开始监听
+        run("tcp", connectLoopback(port), size, count, block, total);
+        run("unix", connectUnix(path), size, count, block, total);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,215 @@
+// 上游连接池的收益: 网关式的请求-响应, 每个请求要么新建一条连接(connect), 要么从UpstreamPool借一条(pool),
+// concurrency个请求并发, 报告requests/s和单个请求(含取得连接)的延迟分位数
+//
+// ./upstream_bench --mode both --concurrency 32 --seconds 2 > /dev/null
+#include "BenchUtil.h"
+#include "EventLoopThread.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "UpstreamPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace bench;
+
+namespace
+{
+
+std::atomic_bool g_stop(false);
+std::string g_request;
+
+struct Flow
+{
+    EventLoop* loop;
+    InetAddress server;
+    int64_t begin;
+    size_t received;
+    std::vector<int64_t> latencies;
+    long failed;
+};
+
+void onResponseBytes(Flow* flow, Buffer* buf, const std::function<void()>& done)
+{
+    flow->received += buf->readableBytes();
+    buf->retrieveAll();
+    if(flow->received >= g_request.size())
+    {
+        flow->latencies.push_back(nowMicros() - flow->begin);
+        done();
+    }
+}
+
+// 每个请求新建一条连接, 收到响应后关闭
+void startConnect(Flow* flow)
+{
+    if(g_stop)
+    {
+        return;
+    }
+    flow->begin = nowMicros();
+    flow->received = 0;
+    TcpClient* client = new TcpClient(flow->loop, flow->server, "connect");
+    client->setConnectionCallback([flow](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->send(g_request);
+        }
+    });
+    client->setMessageCallback([flow, client](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        onResponseBytes(flow, buf, [flow, client]() {
+            // 不能在client自己的回调中析构它
+            flow->loop->queueInLoop([flow, client]() {
+                delete client;
+                startConnect(flow);
+            });
+        });
+    });
+    client->connect();
+}
+
+// 每个请求从本loop的连接池借一条连接, 收到响应后归还
+void startPooled(Flow* flow)
+{
+    if(g_stop)
+    {
+        return;
+    }
+    flow->begin = nowMicros();
+    flow->received = 0;
+    UpstreamPool& pool = flow->loop->upstreamPool();
+    pool.checkout(flow->server,
+        [flow](const TcpConnectionPtr& conn) {
+            if(!conn)
+            {
+                ++flow->failed;
+                startPooled(flow);
+                return;
+            }
+            conn->send(g_request);
+        },
+        [flow](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            onResponseBytes(flow, buf, [flow, conn]() {
+                flow->loop->upstreamPool().release(conn);
+                startPooled(flow);
+            });
+        },
+        [flow](const TcpConnectionPtr&) {
+            ++flow->failed;     // 借出期间连接断开, 重新借一条
+            startPooled(flow);
+        });
+}
+
+void runMode(const char* mode, EventLoop* loop, const InetAddress& server, int concurrency, int seconds)
+{
+    bool pooled = strcmp(mode, "pool") == 0;
+    std::vector<std::unique_ptr<Flow>> flows;
+    for(int i = 0; i < concurrency; ++i)
+    {
+        flows.emplace_back(new Flow{ loop, server, 0, 0, {}, 0 });
+    }
+    if(pooled)
+    {
+        std::promise<void> warm;
+        loop->runInLoop([&]() {
+            UpstreamPool::Options options;
+            options.minIdle = concurrency;
+            options.maxIdle = concurrency;
+            loop->upstreamPool().setOptions(server, options);
+            warm.set_value();
+        });
+        warm.get_future().wait();
+        // 等预建的连接就绪, 稳态下的网关不为建连付出延迟
+        while(true)
+        {
+            std::promise<size_t> idle;
+            loop->runInLoop([&]() { idle.set_value(loop->upstreamPool().idleCount(server)); });
+            if(idle.get_future().get() >= static_cast<size_t>(concurrency))
+            {
+                break;
+            }
+            usleep(1000);
+        }
+    }
+
+    g_stop = false;
+    int64_t start = nowMicros();
+    for(auto& f : flows)
+    {
+        Flow* flow = f.get();
+        loop->runInLoop([flow, pooled]() { pooled ? startPooled(flow) : startConnect(flow); });
+    }
+    sleep(seconds);
+    g_stop = true;
+    int64_t elapsed = nowMicros() - start;
+    usleep(200 * 1000);     // 让进行中的请求结束
+
+    std::vector<int64_t> latencies;
+    long failed = 0;
+    std::promise<void> collected;
+    loop->runInLoop([&]() {
+        for(auto& f : flows)
+        {
+            latencies.insert(latencies.end(), f->latencies.begin(), f->latencies.end());
+            failed += f->failed;
+        }
+        collected.set_value();
+    });
+    collected.get_future().wait();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> long long {
+        return latencies.empty() ? 0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    fprintf(stderr, "mode=%s concurrency=%d requests=%zu requests/s=%.0f failed=%ld\n",
+            mode, concurrency, latencies.size(), latencies.size() * 1e6 / elapsed, failed);
+    fprintf(stderr, "  latency us: p50=%lld p90=%lld p99=%lld p999=%lld max=%lld\n",
+            percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const char* mode = getArg(argc, argv, "--mode", "both");
+    int numLoops = static_cast<int>(getIntArg(argc, argv, "--loops", 2));
+    int concurrency = static_cast<int>(getIntArg(argc, argv, "--concurrency", 32));
+    int seconds = static_cast<int>(getIntArg(argc, argv, "--seconds", 2));
+    size_t requestSize = static_cast<size_t>(getIntArg(argc, argv, "--request", 128));
+    uint16_t port = static_cast<uint16_t>(getIntArg(argc, argv, "--port", 9989));
+
+    g_request.assign(requestSize, 'r');
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "UpstreamBench");
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf);    // echo
+    });
+    server.setThreadNum(numLoops);
+    server.start();
+
+    std::thread driver([&]() {
+        EventLoopThread clientThread(EventLoopThread::ThreadInitCallback(), "gateway");
+        EventLoop* clientLoop = clientThread.startLoop();
+        if(strcmp(mode, "pool") != 0)
+        {
+            runMode("connect", clientLoop, addr, concurrency, seconds);
+        }
+        if(strcmp(mode, "connect") != 0)
+        {
+            runMode("pool", clientLoop, addr, concurrency, seconds);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,486 @@
+#include <Moduo/TcpServer.h>
+#include <Moduo/Logger.h>
+#include <Moduo/LoopChannel.h>
+#include <Moduo/RespCodec.h>
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 内存KV服务器, 兼容redis-cli/redis-benchmark的常用命令:
+ * PING ECHO GET SET DEL EXISTS INCR MGET DBSIZE (COMMAND/CONFIG返回空以便redis-benchmark启动)
+ *
+ * 键空间按key的hash分到各个subloop, 每个分片只由所属loop访问, 不加锁.
+ * 连接所在loop拥有的key直接处理; 其余命令在一批请求处理完后按目标分片打包,
+ * 经loop两两之间的LoopChannel每个分片发一条消息, 结果再打包一次送回连接所在loop.
+ * LoopChannel满时退回queueInLoop. 响应按请求顺序批量发送.
+ *
+ * ./kv_server 6380 4
+ * redis-benchmark -p 6380 -t set,get -n 1000000 -P 16 -c 50
+ */
+class KvServer
+{
+public:
+    KvServer(EventLoop* loop, const InetAddress& addr, int numThreads)
+        : server_(loop, addr, "KvServer")
+        , codec_(std::bind(&KvServer::onCommand, this,
+                           std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))
+    {
+        server_.setConnectionCallback(std::bind(&KvServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&RespCodec::onMessage, &codec_,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        codec_.setBatchEndCallback(std::bind(&KvServer::onBatchEnd, this, std::placeholders::_1));
+        server_.setThreadNum(numThreads);
+    }
+
+    ~KvServer()
+    {
+        // LoopChannel须在消费者loop中注销
+        for(auto& row : channels_)
+        {
+            for(std::unique_ptr<LoopChannel<ShardMessage>>& channel : row)
+            {
+                if(!channel)
+                {
+                    continue;
+                }
+                std::promise<void> destroyed;
+                channel->consumer()->runInLoop([&channel, &destroyed]() {
+                    channel.reset();
+                    destroyed.set_value();
+                });
+                destroyed.get_future().wait();
+            }
+        }
+    }
+
+    void start()
+    {
+        server_.start();
+        // 在baseloop开始accept之前确定分片和通道, 之后只读
+        loops_ = server_.threadPool()->getAllLoops();
+        shards_.resize(loops_.size());
+        channels_.resize(loops_.size());
+        for(size_t from = 0; from < loops_.size(); ++from)
+        {
+            channels_[from].resize(loops_.size());
+            for(size_t to = 0; to < loops_.size(); ++to)
+            {
+                if(from != to)
+                {
+                    channels_[from][to].reset(new LoopChannel<ShardMessage>(loops_[from], loops_[to],
+                            kChannelCapacity, std::bind(&KvServer::onShardMessage, this, to, std::placeholders::_1)));
+                }
+            }
+        }
+        LOG_INFO("KvServer listening on %s with %zu shards", server_.ipPort().c_str(), shards_.size());
+    }
+
+private:
+    enum OpType { kGet, kSet, kDel, kExists, kIncr, kDbSize };
+    // 多key命令拆成单key操作后如何合并结果
+    enum Combine { kSingle, kArray, kSum };
+
+    struct Op
+    {
+        OpType type;
+        size_t shard;
+        std::string key;
+        std::string value;
+    };
+
+    struct Reply
+    {
+        Combine combine;
+        std::vector<std::string> parts;     // 每个操作的RESP编码结果
+        size_t remaining;
+        bool ready;
+        std::string data;
+    };
+    using ReplyPtr = std::shared_ptr<Reply>;
+
+    // 发往其他分片的操作
+    struct Forward
+    {
+        Op op;
+        ReplyPtr reply;
+        size_t part;
+    };
+    struct Result
+    {
+        ReplyPtr reply;
+        size_t part;
+        std::string data;
+    };
+
+    // 分片之间的消息: 发往分片的一批操作(forwards), 或送回连接所在loop的结果(results)
+    struct ShardMessage
+    {
+        TcpConnectionPtr conn;
+        size_t home;        // 连接所在loop的下标
+        std::vector<Forward> forwards;
+        std::vector<Result> results;
+    };
+
+    static const size_t kChannelCapacity = 4096;
+
+    // 每个连接的状态, 只在连接所属loop中访问
+    struct Session
+    {
+        Buffer output;
+        std::deque<ReplyPtr> pending;                 // 还在等其他分片的响应, 按请求顺序
+        std::vector<std::vector<Forward>> outbox;     // 本批次要发往各分片的操作
+    };
+
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);  // 跨分片的响应晚到, 不能被Nagle攒住
+            std::shared_ptr<Session> session = std::make_shared<Session>();
+            session->outbox.resize(shards_.size());
+            conn->setContext(session);
+        }
+    }
+
+    static bool equals(StringPiece arg, const char* name)
+    {
+        size_t len = ::strlen(name);
+        return arg.size() == len && ::strncasecmp(arg.data(), name, len) == 0;
+    }
+
+    // FNV-1a, 不为查分片构造std::string
+    size_t shardOf(StringPiece key) const
+    {
+        uint32_t h = 2166136261u;
+        for(char c : key)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return h % shards_.size();
+    }
+
+    void onCommand(const TcpConnectionPtr& conn, const std::vector<StringPiece>& args, Timestamp)
+    {
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        const StringPiece& cmd = args[0];
+        std::vector<Op> ops;
+        Combine combine = kSingle;
+
+        if(equals(cmd, "PING"))
+        {
+            Buffer reply;
+            if(args.size() > 1)
+            {
+                RespCodec::appendBulkString(&reply, args[1]);
+            }
+            else
+            {
+                RespCodec::appendSimpleString(&reply, "PONG");
+            }
+            addReady(session, &reply);
+            return;
+        }
+        if(equals(cmd, "ECHO") && args.size() == 2)
+        {
+            Buffer reply;
+            RespCodec::appendBulkString(&reply, args[1]);
+            addReady(session, &reply);
+            return;
+        }
+        if(equals(cmd, "COMMAND") || equals(cmd, "CONFIG"))
+        {
+            Buffer reply;
+            RespCodec::appendArrayHeader(&reply, 0);
+            addReady(session, &reply);
+            return;
+        }
+
+        if(equals(cmd, "GET") && args.size() == 2)
+        {
+            ops.push_back(makeOp(kGet, args[1]));
+        }
+        else if(equals(cmd, "SET") && args.size() == 3)
+        {
+            ops.push_back(makeOp(kSet, args[1]));
+            ops.back().value.assign(args[2].data(), args[2].size());
+        }
+        else if(equals(cmd, "INCR") && args.size() == 2)
+        {
+            ops.push_back(makeOp(kIncr, args[1]));
+        }
+        else if((equals(cmd, "DEL") || equals(cmd, "EXISTS")) && args.size() >= 2)
+        {
+            OpType type = equals(cmd, "DEL") ? kDel : kExists;
+            for(size_t i = 1; i < args.size(); ++i)
+            {
+                ops.push_back(makeOp(type, args[i]));
+            }
+            combine = kSum;
+        }
+        else if(equals(cmd, "MGET") && args.size() >= 2)
+        {
+            for(size_t i = 1; i < args.size(); ++i)
+            {
+                ops.push_back(makeOp(kGet, args[i]));
+            }
+            combine = kArray;
+        }
+        else if(equals(cmd, "DBSIZE") && args.size() == 1)
+        {
+            for(size_t i = 0; i < shards_.size(); ++i)
+            {
+                Op op;
+                op.type = kDbSize;
+                op.shard = i;
+                ops.push_back(op);
+            }
+            combine = kSum;
+        }
+        else
+        {
+            Buffer reply;
+            RespCodec::appendError(&reply, "ERR unknown command or wrong number of arguments");
+            addReady(session, &reply);
+            return;
+        }
+
+        // 快速路径: 单个本地操作且前面没有排队的响应, 直接写入输出缓冲
+        if(ops.size() == 1 && combine == kSingle && session->pending.empty()
+            && loops_[ops[0].shard]->isInLoopThread())
+        {
+            execute(ops[0], &session->output);
+            return;
+        }
+
+        ReplyPtr reply = std::make_shared<Reply>();
+        reply->combine = combine;
+        reply->parts.resize(ops.size());
+        reply->remaining = ops.size();
+        reply->ready = false;
+        session->pending.push_back(reply);
+        for(size_t i = 0; i < ops.size(); ++i)
+        {
+            size_t shard = ops[i].shard;
+            if(loops_[shard]->isInLoopThread())
+            {
+                Buffer result;
+                execute(ops[i], &result);
+                complete(reply, i, result.retrieveAllAsString());
+            }
+            else
+            {
+                session->outbox[shard].push_back(Forward{ std::move(ops[i]), reply, i });
+            }
+        }
+    }
+
+    Op makeOp(OpType type, StringPiece key) const
+    {
+        Op op;
+        op.type = type;
+        op.shard = shardOf(key);
+        op.key.assign(key.data(), key.size());
+        return op;
+    }
+
+    static void addReady(Session* session, Buffer* reply)
+    {
+        if(session->pending.empty())
+        {
+            session->output.append(reply->peek(), reply->readableBytes());
+            return;
+        }
+        ReplyPtr ready = std::make_shared<Reply>();
+        ready->combine = kSingle;
+        ready->remaining = 0;
+        ready->ready = true;
+        ready->data = reply->retrieveAllAsString();
+        session->pending.push_back(ready);
+    }
+
+    static void complete(const ReplyPtr& reply, size_t part, std::string data)
+    {
+        reply->parts[part] = std::move(data);
+        if(--reply->remaining > 0)
+        {
+            return;
+        }
+        if(reply->combine == kSingle)
+        {
+            reply->data = std::move(reply->parts[0]);
+        }
+        else if(reply->combine == kArray)
+        {
+            Buffer buf;
+            RespCodec::appendArrayHeader(&buf, reply->parts.size());
+            reply->data = buf.retrieveAllAsString();
+            for(const std::string& p : reply->parts)
+            {
+                reply->data += p;
+            }
+        }
+        else
+        {
+            int64_t sum = 0;
+            for(const std::string& p : reply->parts)
+            {
+                sum += ::atoll(p.c_str() + 1);  // ":n\r\n"
+            }
+            Buffer buf;
+            RespCodec::appendInteger(&buf, sum);
+            reply->data = buf.retrieveAllAsString();
+        }
+        reply->parts.clear();
+        reply->ready = true;
+    }
+
+    // 在分片所属loop中执行
+    void execute(const Op& op, Buffer* out)
+    {
+        std::unordered_map<std::string, std::string>& data = shards_[op.shard];
+        switch(op.type)
+        {
+        case kGet:
+        {
+            auto it = data.find(op.key);
+            if(it == data.end())
+            {
+                RespCodec::appendNullBulkString(out);
+            }
+            else
+            {
+                RespCodec::appendBulkString(out, it->second);
+            }
+            break;
+        }
+        case kSet:
+            data[op.key] = op.value;
+            RespCodec::appendSimpleString(out, "OK");
+            break;
+        case kDel:
+            RespCodec::appendInteger(out, static_cast<int64_t>(data.erase(op.key)));
+            break;
+        case kExists:
+            RespCodec::appendInteger(out, data.count(op.key) ? 1 : 0);
+            break;
+        case kIncr:
+        {
+            std::string& value = data[op.key];
+            char* end = nullptr;
+            long long n = value.empty() ? 0 : ::strtoll(value.c_str(), &end, 10);
+            if(!value.empty() && *end != '\0')
+            {
+                RespCodec::appendError(out, "ERR value is not an integer or out of range");
+                break;
+            }
+            value = std::to_string(++n);
+            RespCodec::appendInteger(out, n);
+            break;
+        }
+        case kDbSize:
+            RespCodec::appendInteger(out, static_cast<int64_t>(data.size()));
+            break;
+        }
+    }
+
+    // 一批命令处理完: 每个目标分片投递一个任务, 然后发送已就绪的响应
+    void onBatchEnd(const TcpConnectionPtr& conn)
+    {
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        for(size_t shard = 0; shard < session->outbox.size(); ++shard)
+        {
+            if(session->outbox[shard].empty())
+            {
+                continue;
+            }
+            ShardMessage message;
+            message.conn = conn;
+            message.home = indexOf(conn->getLoop());
+            message.forwards.swap(session->outbox[shard]);
+            sendToShard(message.home, shard, message);
+        }
+        flush(conn);
+    }
+
+    size_t indexOf(EventLoop* loop) const
+    {
+        return std::find(loops_.begin(), loops_.end(), loop) - loops_.begin();
+    }
+
+    // 在from loop中调用
+    void sendToShard(size_t from, size_t to, ShardMessage& message)
+    {
+        if(channels_[from][to]->trySend(std::move(message)))
+        {
+            return;
+        }
+        std::shared_ptr<ShardMessage> queued = std::make_shared<ShardMessage>(std::move(message));
+        loops_[to]->queueInLoop([this, to, queued]() { onShardMessage(to, *queued); });
+    }
+
+    // 在分片shard所属loop中调用
+    void onShardMessage(size_t shard, ShardMessage& message)
+    {
+        if(!message.forwards.empty())
+        {
+            ShardMessage reply;
+            reply.conn = std::move(message.conn);
+            reply.home = message.home;
+            reply.results.reserve(message.forwards.size());
+            Buffer out;
+            for(const Forward& f : message.forwards)
+            {
+                execute(f.op, &out);
+                reply.results.push_back(Result{ f.reply, f.part, out.retrieveAllAsString() });
+            }
+            sendToShard(shard, message.home, reply);
+            return;
+        }
+        for(Result& r : message.results)
+        {
+            complete(r.reply, r.part, std::move(r.data));
+        }
+        flush(message.conn);
+    }
+
+    void flush(const TcpConnectionPtr& conn)
+    {
+        Session* session = static_cast<Session*>(conn->getContext().get());
+        while(!session->pending.empty() && session->pending.front()->ready)
+        {
+            const std::string& data = session->pending.front()->data;
+            session->output.append(data.data(), data.size());
+            session->pending.pop_front();
+        }
+        if(session->output.readableBytes() > 0)
+        {
+            conn->send(&session->output);
+        }
+    }
+
+    TcpServer server_;
+    RespCodec codec_;
+    std::vector<EventLoop*> loops_;
+    std::vector<std::unordered_map<std::string, std::string>> shards_;  // shards_[i]只由loops_[i]访问
+    std::vector<std::vector<std::unique_ptr<LoopChannel<ShardMessage>>>> channels_;    // channels_[from][to]
+};
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 6380);
+    int numThreads = argc > 2 ? atoi(argv[2]) : 4;
+    EventLoop loop;
+    InetAddress addr(port);
+    KvServer server(&loop, addr, numThreads);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -1,10 +1,12 @@
 #include "Acceptor.h"
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0) {
         LOG_FATAL("createNonblocking: socket() failed, errno=%d (%s)", errno, strerror(errno));
     }
@@ -19,14 +21,45 @@ static int createNonblocking()
     return sockfd;
 }
 
+// connect被拒绝说明没有进程在这个路径上listen
+static bool isStaleUnixSocket(const InetAddress& addr)
+{
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);   // backlog满时不阻塞(EAGAIN)
+    if(sockfd < 0)
+    {
+        return false;
+    }
+    bool stale = ::connect(sockfd, addr.getSockAddr(), addr.getSockLen()) < 0 && errno == ECONNREFUSED;
+    ::close(sockfd);
+    return stale;
+}
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusePort)
     : loop_(loop),
-      acceptSocket_(createNonblocking()),
+      acceptSocket_(createNonblocking(listenAddr.family())),
       acceptChannel_(loop, acceptSocket_.fd()),
       listenning_(false)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(reusePort);  // true
+    if(listenAddr.isUnix())
+    {
+        std::string path = listenAddr.toIp();
+        if(!path.empty() && path[0] != '@')
+        {
+            // 上次进程异常退出留下的socket文件会让bind失败(EADDRINUSE)
+            // 只删除没有进程在监听的socket文件, 仍在服务的由bind报错
+            struct stat st;
+            if(::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) && isStaleUnixSocket(listenAddr))
+            {
+                ::unlink(path.c_str());
+            }
+            unixPath_ = path;
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(reusePort);  // true
+    }
     acceptSocket_.bindAddress(listenAddr);
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
@@ -34,6 +67,10 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if(!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 void Acceptor::listen()
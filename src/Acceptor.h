@@ -33,4 +33,5 @@ private:
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    std::string unixPath_;  // 绑定的Unix域socket文件, 析构时删除
 };
\ No newline at end of file
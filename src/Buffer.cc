@@ -4,6 +4,10 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 ssize_t Buffer::readFd(int fd, int *savedErrno)
 {
     char extrabuf[65536];   // 64KB
@@ -42,4 +46,220 @@ ssize_t Buffer::writeFd(int fd, int* savedErrno)
     }
     return n;
 }
-    
\ No newline at end of file
+    
+namespace
+{
+
+const char* findByteScalar(const char* begin, const char* end, char c)
+{
+    return static_cast<const char*>(::memchr(begin, c, end - begin));
+}
+
+const char* findCRLFScalar(const char* begin, const char* end)
+{
+    for(const char* p = begin; p + 1 < end; ++p)
+    {
+        if(p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 每次比较16/32字节; 末尾不足一个向量时再做一次与前面重叠的比较,
+// 重叠部分此前没有命中, 所以结果仍是第一个匹配. 不足一个向量的短数据走标量
+__attribute__((target("sse2")))
+const char* findByteSse2(const char* begin, const char* end, char c)
+{
+    if(end - begin < 16)
+    {
+        return findByteScalar(begin, end, c);
+    }
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    while(true)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        if(p == end - 16)
+        {
+            return nullptr;
+        }
+        p = (p + 32 <= end) ? p + 16 : end - 16;
+    }
+}
+
+// 同时比较p处的'\r'和p + 1处的'\n', 两个掩码相与即为CRLF的起始位置
+__attribute__((target("sse2")))
+const char* findCRLFSse2(const char* begin, const char* end)
+{
+    if(end - begin < 17)
+    {
+        return findCRLFScalar(begin, end);
+    }
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    while(true)
+    {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, cr),
+                                                   _mm_cmpeq_epi8(second, lf)));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        if(p == end - 17)
+        {
+            return nullptr;
+        }
+        p = (p + 33 <= end) ? p + 16 : end - 17;
+    }
+}
+
+// 不调用SSE2版本处理尾部, 避免AVX与传统SSE指令混用的状态切换开销
+// 大块数据每轮比较128字节, 合并掩码后只做一次分支
+__attribute__((target("avx2")))
+const char* findByteAvx2(const char* begin, const char* end, char c)
+{
+    if(end - begin < 32)
+    {
+        return findByteScalar(begin, end, c);
+    }
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 128 <= end; p += 128)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), needle);
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), needle);
+        __m256i eq2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64)), needle);
+        __m256i eq3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 96)), needle);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq2, eq3));
+        if(!_mm256_testz_si256(any, any))
+        {
+            break;      // 交给下面逐个向量定位
+        }
+    }
+    if(p == end)
+    {
+        return nullptr;
+    }
+    if(end - p < 32)
+    {
+        p = end - 32;
+    }
+    while(true)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        if(p == end - 32)
+        {
+            return nullptr;
+        }
+        p = (p + 64 <= end) ? p + 32 : end - 32;
+    }
+}
+
+__attribute__((target("avx2")))
+const char* findCRLFAvx2(const char* begin, const char* end)
+{
+    if(end - begin < 33)
+    {
+        return findCRLFScalar(begin, end);
+    }
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    // 先只找'\n', 命中后再核对前一个字节是不是'\r'
+    for(; p + 129 <= end; p += 128)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), lf);
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 33)), lf);
+        __m256i eq2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 65)), lf);
+        __m256i eq3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 97)), lf);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq2, eq3));
+        if(!_mm256_testz_si256(any, any))
+        {
+            break;
+        }
+    }
+    if(p + 1 == end)
+    {
+        return nullptr;
+    }
+    if(end - p < 33)
+    {
+        p = end - 33;
+    }
+    while(true)
+    {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, cr), _mm256_cmpeq_epi8(second, lf))));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        if(p == end - 33)
+        {
+            return nullptr;
+        }
+        p = (p + 65 <= end) ? p + 32 : end - 33;
+    }
+}
+
+#endif
+
+struct SearchKernel
+{
+    const char* name;
+    const char* (*findByte)(const char*, const char*, char);
+    const char* (*findCRLF)(const char*, const char*);
+};
+
+// 首次使用时按CPU支持的指令集选定, 之后不再检测
+const SearchKernel& searchKernelInstance()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const SearchKernel kernel = __builtin_cpu_supports("avx2")
+        ? SearchKernel{ "avx2", findByteAvx2, findCRLFAvx2 }
+        : __builtin_cpu_supports("sse2")
+            ? SearchKernel{ "sse2", findByteSse2, findCRLFSse2 }
+            : SearchKernel{ "scalar", findByteScalar, findCRLFScalar };
+#else
+    static const SearchKernel kernel = { "scalar", findByteScalar, findCRLFScalar };
+#endif
+    return kernel;
+}
+
+}
+
+const char* Buffer::findCRLF(const char* start) const
+{
+    assert(peek() <= start && start <= beginWrite());
+    return searchKernelInstance().findCRLF(start, beginWrite());
+}
+
+const char* Buffer::findByte(char c, const char* start) const
+{
+    assert(peek() <= start && start <= beginWrite());
+    return searchKernelInstance().findByte(start, beginWrite(), c);
+}
+
+const char* Buffer::searchKernel()
+{
+    return searchKernelInstance().name;
+}
@@ -2,6 +2,9 @@
 
 #include "const.h"
 
+#include <assert.h>
+#include <algorithm>
+
 /**
  * @brief 
     --------------------------------------
@@ -24,6 +27,12 @@ public:
           readerIndex_(KCheapPrend), 
           writerIndex_(KCheapPrend) 
     {}  
+    void swap(Buffer& rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
     // 缓冲区中可读数据的字节数
     size_t readableBytes() const
     {
@@ -102,7 +111,7 @@ public:
                       begin() + writerIndex_,  // end
                       begin() + KCheapPrend);  // to
             readerIndex_ = KCheapPrend;
-            writerIndex_ += len - readable;
+            writerIndex_ = readerIndex_ + readable;
         }
     }
     // [data, data + len] 添加到 writable()
@@ -113,6 +122,32 @@ public:
         writerIndex_ += len;
     }
 
+    // 写入[data, data + len]后移动writerIndex_，配合beginWrite()直接写入
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
+    // 在可读数据之前写入len个字节，使用预分配空间，不移动已有数据
+    void prepend(const void* data, size_t len)
+    {
+        assert(len <= prependableBytes());
+        readerIndex_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+
+    // 查找"\r\n"/'\n'/任意字节, 返回指向它的指针, 找不到返回nullptr
+    // start用于从上次停下的位置继续扫描; 扩容后指针会失效, 跨readFd保存时存start - peek()
+    // 找CRLF时上次的末尾字节可能是'\r', 应从readableBytes() - 1处继续
+    const char* findCRLF() const { return findCRLF(peek()); }
+    const char* findCRLF(const char* start) const;
+    const char* findEOL() const { return findByte('\n', peek()); }
+    const char* findEOL(const char* start) const { return findByte('\n', start); }
+    const char* findByte(char c) const { return findByte(c, peek()); }
+    const char* findByte(char c, const char* start) const;
+    // 运行时选中的查找实现: "avx2", "sse2" 或 "scalar"
+    static const char* searchKernel();
+
     // 读fd数据
     ssize_t readFd(int fd, int* savedErrno);
 
@@ -2,18 +2,24 @@
 
 #include <functional>
 #include <memory>
+#include <stdint.h>
+#include <string>
 
 class Buffer;
 class TcpConnection;
 class Timestamp;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+using ConnectionId = uint64_t;  // 0表示无效
+// 引用计数的只读消息，广播时多个连接共享同一份数据，不拷贝
+using SharedMessage = std::shared_ptr<const std::string>;
 using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)>;
 // 水位线：当缓冲区数据量达到一定值时，触发回调
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+using TimerCallback = std::function<void()>;
 
 // typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
 // typedef std::function<void(const TcpConnectionPtr&)> ConnectionCallback;
@@ -75,6 +75,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if(closeCallback_)
         {
+            loop_->activity().setPhase(LoopActivity::kCloseCallback);
             closeCallback_();
         }
     }
@@ -82,6 +83,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if(errorCallback_)
         {
+            loop_->activity().setPhase(LoopActivity::kErrorCallback);
             errorCallback_();
         }
     }
@@ -89,6 +91,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if(readCallback_)
         {
+            loop_->activity().setPhase(LoopActivity::kReadCallback);
             readCallback_(receiveTime);
         }
     }
@@ -96,6 +99,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     {
         if(writeCallback_)
         {
+            loop_->activity().setPhase(LoopActivity::kWriteCallback);
             writeCallback_();
         }
     }
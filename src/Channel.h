@@ -45,7 +45,7 @@ public:
     void enableReading() {events_ |= kReadEvent; update();}
     void disableReading() {events_ &= ~kReadEvent; update();}
     void enableWriting() {events_ |= kWriteEvent; update();}
-    void disableWriting() {events_ &= kWriteEvent; update();}
+    void disableWriting() {events_ &= ~kWriteEvent; update();}
     void disableAll() {events_ = kNoneEvent; update();}
     bool isWriting() const {return events_ & kWriteEvent;}
     bool isReading() const {return events_ & kReadEvent;}
@@ -53,6 +53,7 @@ public:
     void set_index(int idx) {index_ = idx;}
 
     EventLoop* ownerLoop() {return loop_;}
+    void setOwnerLoop(EventLoop* loop) {loop_ = loop;}   // 连接迁移，调用前需先remove
     void remove();
 private:
     void update();
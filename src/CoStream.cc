@@ -0,0 +1,239 @@
+#include "CoStream.h"
+#include "EventLoop.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+
+#include <string.h>
+
+namespace
+{
+
+const size_t kDefaultHighWaterMark = 64 * 1024;
+
+// 回调中持有的是最后一个引用时推迟到下一轮析构:
+// CoStream可能拥有TcpClient, 它的析构会替换正在执行的连接回调
+void releaseInLoop(CoStreamPtr& self)
+{
+    if(self.use_count() == 1)
+    {
+        self->getLoop()->queueInLoop([self]() {});
+    }
+}
+
+}
+
+CoStream::CoStream(const TcpConnectionPtr& conn)
+    : conn_(conn)
+    , input_(nullptr)
+    , closed_(false)
+    , highWaterMark_(kDefaultHighWaterMark)
+    , want_(0)
+    , scanned_(0)
+{
+}
+
+CoStream::~CoStream()
+{
+    if(conn_->connected())
+    {
+        conn_->shutdown();
+    }
+}
+
+// 回调只持有weak_ptr, CoStream释放后连接上收到的数据直接丢弃
+CoStreamPtr CoStream::attach(const TcpConnectionPtr& conn)
+{
+    CoStreamPtr stream(new CoStream(conn));
+    std::weak_ptr<CoStream> weak(stream);
+    conn->setMessageCallback([weak](const TcpConnectionPtr&, Buffer* input, Timestamp) {
+        CoStreamPtr self = weak.lock();
+        if(!self)
+        {
+            input->retrieveAll();
+            return;
+        }
+        self->handleMessage(input);
+        releaseInLoop(self);
+    });
+    conn->setConnectionCallback([weak](const TcpConnectionPtr& c) {
+        CoStreamPtr self = c->connected() ? nullptr : weak.lock();
+        if(self)
+        {
+            self->handleClose();
+            releaseInLoop(self);
+        }
+    });
+    return stream;
+}
+
+CoStream::WriteAwaiter CoStream::write(const std::string& data)
+{
+    conn_->send(data);
+    return WriteAwaiter(this);
+}
+
+CoStream::WriteAwaiter CoStream::write(const void* data, size_t len)
+{
+    conn_->send(data, len);
+    return WriteAwaiter(this);
+}
+
+CoStream::WriteAwaiter CoStream::write(Buffer* data)
+{
+    conn_->send(data);
+    return WriteAwaiter(this);
+}
+
+bool CoStream::prepareRead(size_t n, StringPiece delim)
+{
+    want_ = delim.empty() ? n : 0;
+    delim_ = delim;
+    scanned_ = 0;
+    return readSatisfied();
+}
+
+bool CoStream::readSatisfied()
+{
+    size_t readable = readableBytes();
+    if(delim_.empty())
+    {
+        return readable >= want_ || closed_;
+    }
+    if(readable >= delim_.size())
+    {
+        const char* begin = input_->peek();
+        const void* found = ::memmem(begin + scanned_, readable - scanned_, delim_.data(), delim_.size());
+        if(found != nullptr)
+        {
+            want_ = static_cast<const char*>(found) - begin + delim_.size();
+            return true;
+        }
+        scanned_ = readable - delim_.size() + 1;
+    }
+    return closed_;
+}
+
+std::string CoStream::takeRead()
+{
+    if(want_ == 0 || readableBytes() < want_)
+    {
+        return std::string();
+    }
+    return input_->retrieveAsString(want_);
+}
+
+// 写完成回调由TcpConnection排进loop队列, 只在有协程等待时设置, 平时发送不产生额外任务
+bool CoStream::writeBlocked() const
+{
+    return !closed_ && conn_->outputBytes() > highWaterMark_;
+}
+
+void CoStream::waitWritable(std::coroutine_handle<> h)
+{
+    writer_ = h;
+    std::weak_ptr<CoStream> weak(shared_from_this());
+    conn_->setWriteCompleteCallback([weak](const TcpConnectionPtr&) {
+        CoStreamPtr self = weak.lock();
+        if(self)
+        {
+            self->handleWriteComplete();
+            releaseInLoop(self);
+        }
+    });
+}
+
+void CoStream::handleMessage(Buffer* buf)
+{
+    input_ = buf;
+    if(reader_ && readSatisfied())
+    {
+        std::exchange(reader_, nullptr).resume();
+    }
+}
+
+void CoStream::handleWriteComplete()
+{
+    if(writer_ && !writeBlocked())
+    {
+        conn_->setWriteCompleteCallback(WriteCompleteCallback());
+        std::exchange(writer_, nullptr).resume();
+    }
+}
+
+void CoStream::handleClose()
+{
+    closed_ = true;
+    if(reader_)
+    {
+        std::exchange(reader_, nullptr).resume();
+    }
+    if(writer_)
+    {
+        std::exchange(writer_, nullptr).resume();
+    }
+}
+
+CoConnect::CoConnect(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, double timeout)
+    : loop_(loop)
+    , client_(new TcpClient(loop, serverAddr, name))
+    , timeout_(timeout)
+    , timerPending_(false)
+{
+}
+
+CoConnect::~CoConnect()
+{
+    if(timerPending_)
+    {
+        loop_->cancel(timer_);
+    }
+}
+
+void CoConnect::await_suspend(std::coroutine_handle<> h)
+{
+    waiter_ = h;
+    client_->setConnectionCallback(std::bind(&CoConnect::onConnection, this, std::placeholders::_1));
+    client_->connect();
+    if(timeout_ > 0)
+    {
+        timerPending_ = true;
+        timer_ = loop_->runAfter(timeout_, std::bind(&CoConnect::onTimeout, this));
+    }
+}
+
+// 在连接建立的回调中调用; 恢复协程后本对象随co_await表达式结束而析构, 之后不能再访问成员
+void CoConnect::onConnection(const TcpConnectionPtr& conn)
+{
+    if(!conn->connected())
+    {
+        return;
+    }
+    if(timerPending_)
+    {
+        timerPending_ = false;
+        loop_->cancel(timer_);
+    }
+    stream_ = CoStream::attach(conn);
+    stream_->client_ = std::move(client_);
+    waiter_.resume();
+}
+
+void CoConnect::onTimeout()
+{
+    timerPending_ = false;
+    client_.reset();
+    waiter_.resume();
+}
+
+void coServe(TcpServer* server, const CoHandler& handler)
+{
+    std::shared_ptr<CoHandler> shared = std::make_shared<CoHandler>(handler);
+    server->setConnectionCallback([shared](const TcpConnectionPtr& conn) {
+        if(conn->connected())
+        {
+            // attach会替换连接上正在执行的这个回调, 先把捕获的handler拷出来
+            std::shared_ptr<CoHandler> h = shared;
+            coSpawn((*h)(CoStream::attach(conn)));
+        }
+    });
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "Coroutine.h"
+#include "InetAddress.h"
+#include "StringPiece.h"
+#include "TcpConnection.h"
+#include "TimerId.h"
+
+#include <memory>
+#include <string>
+
+class CoStream;
+class TcpClient;
+class TcpServer;
+
+using CoStreamPtr = std::shared_ptr<CoStream>;
+using CoHandler = std::function<CoTask<void>(CoStreamPtr)>;
+
+/**
+ * @brief 以协程方式读写一条已建立的TcpConnection
+ * 接管连接的连接/消息/写完成回调; 数据到达、连接关闭时在handleRead等回调中直接恢复等待的协程,
+ * 不经过queueInLoop. 同一时刻最多一个协程在读、一个在写. 只在连接所属loop中使用.
+ * CoStream析构时半关闭连接, 之后到达的数据被丢弃
+ */
+class CoStream : noncopyable, public std::enable_shared_from_this<CoStream>
+{
+public:
+    /// 在连接所属loop中调用, 通常在连接建立的回调里
+    static CoStreamPtr attach(const TcpConnectionPtr& conn);
+    ~CoStream();
+
+    class ReadAwaiter
+    {
+    public:
+        ReadAwaiter(CoStream* stream, size_t n, StringPiece delim) : stream_(stream), n_(n), delim_(delim) {}
+        bool await_ready() { return stream_->prepareRead(n_, delim_); }
+        void await_suspend(std::coroutine_handle<> h) { stream_->reader_ = h; }
+        std::string await_resume() { return stream_->takeRead(); }
+
+    private:
+        CoStream* stream_;
+        size_t n_;
+        StringPiece delim_;
+    };
+
+    class FillAwaiter
+    {
+    public:
+        FillAwaiter(CoStream* stream, size_t n) : stream_(stream), n_(n) {}
+        bool await_ready() { return stream_->prepareRead(n_, StringPiece()); }
+        void await_suspend(std::coroutine_handle<> h) { stream_->reader_ = h; }
+        bool await_resume() { return stream_->readableBytes() >= n_; }
+
+    private:
+        CoStream* stream_;
+        size_t n_;
+    };
+
+    class WriteAwaiter
+    {
+    public:
+        explicit WriteAwaiter(CoStream* stream) : stream_(stream) {}
+        bool await_ready() { return !stream_->writeBlocked(); }
+        void await_suspend(std::coroutine_handle<> h) { stream_->waitWritable(h); }
+        bool await_resume() { return !stream_->closed_; }
+
+    private:
+        CoStream* stream_;
+    };
+
+    /// co_await得到n个字节; 凑够之前连接关闭则得到空串
+    ReadAwaiter read(size_t n) { return ReadAwaiter(this, n, StringPiece()); }
+    /// co_await得到直到delim(含)的数据; 找到之前连接关闭则得到空串. delim须在co_await期间有效
+    ReadAwaiter readUntil(StringPiece delim) { return ReadAwaiter(this, 0, delim); }
+    /// co_await等到input()中至少有n个字节, 数据留在原处不拷贝, 由调用方retrieve; 凑够之前连接关闭则得到false
+    FillAwaiter fill(size_t n) { return FillAwaiter(this, n); }
+    /// 连接的输入缓冲区, 第一次fill成功之后才有效
+    Buffer* input() const { return input_; }
+
+    /// 立即发送; 待发送的数据超过高水位时co_await等到全部写进socket. co_await得到连接是否还在
+    WriteAwaiter write(const std::string& data);
+    WriteAwaiter write(const void* data, size_t len);
+    WriteAwaiter write(Buffer* data);
+    void setHighWaterMark(size_t bytes) { highWaterMark_ = bytes; }
+
+    /// 已收到还没读走的数据
+    size_t readableBytes() const { return input_ == nullptr ? 0 : input_->readableBytes(); }
+    bool closed() const { return closed_; }
+    void shutdown() { conn_->shutdown(); }
+    const TcpConnectionPtr& connection() const { return conn_; }
+    EventLoop* getLoop() const { return conn_->getLoop(); }
+
+private:
+    friend class CoConnect;
+
+    explicit CoStream(const TcpConnectionPtr& conn);
+
+    bool prepareRead(size_t n, StringPiece delim);
+    bool readSatisfied();
+    std::string takeRead();
+    bool writeBlocked() const;
+    void waitWritable(std::coroutine_handle<> h);
+
+    void handleMessage(Buffer* buf);
+    void handleWriteComplete();
+    void handleClose();
+
+    const TcpConnectionPtr conn_;
+    std::unique_ptr<TcpClient> client_;     // coConnect建立的连接, 随CoStream释放
+    Buffer* input_;                         // 连接的inputBuffer_, 第一次收到数据时记下
+    bool closed_;
+    size_t highWaterMark_;
+
+    std::coroutine_handle<> reader_;
+    size_t want_;           // 等到的数据长度; 按分隔符读时找到分隔符后才确定
+    StringPiece delim_;
+    size_t scanned_;        // 已确认不含分隔符的前缀长度, 数据增加后从这里继续找
+    std::coroutine_handle<> writer_;
+};
+
+/// co_await coConnect(loop, addr, name, timeout): 连上后得到CoStream, 超时得到空指针. 应在loop线程中等待
+class CoConnect : noncopyable
+{
+public:
+    CoConnect(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, double timeout);
+    ~CoConnect();
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h);
+    CoStreamPtr await_resume() { return std::move(stream_); }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn);
+    void onTimeout();
+
+    EventLoop* loop_;
+    std::unique_ptr<TcpClient> client_;
+    double timeout_;
+    TimerId timer_;
+    bool timerPending_;
+    CoStreamPtr stream_;
+    std::coroutine_handle<> waiter_;
+};
+
+/// timeout <= 0时一直按TcpClient的退避策略重试
+inline CoConnect coConnect(EventLoop* loop, const InetAddress& serverAddr, const std::string& name,
+                           double timeout = 0)
+{
+    return CoConnect(loop, serverAddr, name, timeout);
+}
+
+/// 每条新连接在所属loop中以handler(stream)启动一个协程; 须在server.start()之前调用
+void coServe(TcpServer* server, const CoHandler& handler);
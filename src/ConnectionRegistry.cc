@@ -0,0 +1,126 @@
+#include "ConnectionRegistry.h"
+
+ConnectionRegistry::ConnectionRegistry()
+    : freeHead_(kNoFree),
+      size_(0)
+{
+}
+
+ConnectionId ConnectionRegistry::allocate()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t index;
+    if(freeHead_ != kNoFree)
+    {
+        index = freeHead_;
+        freeHead_ = slots_[index].nextFree;
+    }
+    else
+    {
+        index = static_cast<uint32_t>(slots_.size());
+        Slot slot;
+        slot.generation = 1;    // 从1开始，id不会为0
+        slot.nextFree = kNoFree;
+        slot.used = false;
+        slots_.push_back(slot);
+    }
+    Slot& slot = slots_[index];
+    slot.used = true;
+    ++size_;
+    return (static_cast<ConnectionId>(slot.generation) << 32) | index;
+}
+
+bool ConnectionRegistry::attach(ConnectionId id, const TcpConnectionPtr& conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t index = indexOf(id);
+    if(index >= slots_.size())
+    {
+        return false;   // clear()之后槽位已不存在
+    }
+    Slot& slot = slots_[index];
+    if(!slot.used || slot.generation != generationOf(id))
+    {
+        return false;
+    }
+    slot.conn = conn;
+    return true;
+}
+
+bool ConnectionRegistry::remove(ConnectionId id)
+{
+    TcpConnectionPtr conn;      // 在锁外析构
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t index = indexOf(id);
+    if(index >= slots_.size())
+    {
+        return false;
+    }
+    Slot& slot = slots_[index];
+    if(!slot.used || slot.generation != generationOf(id))
+    {
+        return false;
+    }
+    conn.swap(slot.conn);
+    slot.used = false;
+    ++slot.generation;
+    if(slot.generation == 0)
+    {
+        slot.generation = 1;
+    }
+    slot.nextFree = freeHead_;
+    freeHead_ = index;
+    --size_;
+    return true;
+}
+
+TcpConnectionPtr ConnectionRegistry::find(ConnectionId id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t index = indexOf(id);
+    if(index >= slots_.size())
+    {
+        return TcpConnectionPtr();
+    }
+    const Slot& slot = slots_[index];
+    if(!slot.used || slot.generation != generationOf(id))
+    {
+        return TcpConnectionPtr();
+    }
+    return slot.conn;
+}
+
+size_t ConnectionRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+void ConnectionRegistry::forEach(const std::function<bool(const TcpConnectionPtr&)>& f) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(const Slot& slot : slots_)
+    {
+        if(slot.used && slot.conn && !f(slot.conn))
+        {
+            break;
+        }
+    }
+}
+
+std::vector<TcpConnectionPtr> ConnectionRegistry::clear()
+{
+    std::vector<TcpConnectionPtr> conns;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(Slot& slot : slots_)
+    {
+        if(slot.conn)
+        {
+            conns.push_back(std::move(slot.conn));
+        }
+    }
+    slots_.clear();
+    freeHead_ = kNoFree;
+    size_ = 0;
+    return conns;
+}
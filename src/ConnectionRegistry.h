@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "noncopyable.h"
+
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief
+ * 连接注册表(slot map)，按ConnectionId O(1)查找，任意线程可用
+ * ConnectionId 高32位为槽位的generation，低32位为槽位下标
+ * 槽位释放时generation加一，旧id即使槽位被复用也查不到新连接
+ */
+class ConnectionRegistry : noncopyable
+{
+public:
+    ConnectionRegistry();
+
+    /// 预留一个槽位，返回新连接的id
+    ConnectionId allocate();
+    /// 把连接放入allocate返回的槽位，id已失效(槽位已释放或已clear)时返回false
+    bool attach(ConnectionId id, const TcpConnectionPtr& conn);
+    /// 释放槽位，id已失效时返回false
+    bool remove(ConnectionId id);
+    /// id已失效返回空指针
+    TcpConnectionPtr find(ConnectionId id) const;
+
+    size_t size() const;
+    /// 在锁内依次访问所有连接，f返回false时提前结束，f中不能再访问注册表
+    void forEach(const std::function<bool(const TcpConnectionPtr&)>& f) const;
+    /// 取出所有连接并清空
+    std::vector<TcpConnectionPtr> clear();
+
+    static uint32_t indexOf(ConnectionId id) { return static_cast<uint32_t>(id); }
+    static uint32_t generationOf(ConnectionId id) { return static_cast<uint32_t>(id >> 32); }
+
+private:
+    struct Slot
+    {
+        uint32_t generation;
+        uint32_t nextFree;
+        bool used;
+        TcpConnectionPtr conn;
+    };
+    static const uint32_t kNoFree = UINT32_MAX;
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    uint32_t freeHead_;     // 空闲槽位链表
+    size_t size_;
+};
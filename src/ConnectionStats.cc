@@ -0,0 +1,222 @@
+#include "ConnectionStats.h"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+
+StatsHistogram::Snapshot::Snapshot()
+    : counts(kBuckets, 0)
+    , count(0)
+    , sum(0)
+    , max(0)
+{
+}
+
+void StatsHistogram::Snapshot::merge(const Snapshot& other)
+{
+    for(int i = 0; i < kBuckets; ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+uint64_t StatsHistogram::Snapshot::percentile(double q) const
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * count);
+    if(target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0; i < kBuckets; ++i)
+    {
+        seen += counts[i];
+        if(seen >= target)
+        {
+            return std::min(upperBoundOf(i), max);
+        }
+    }
+    return max;
+}
+
+StatsHistogram::StatsHistogram()
+    : sum_(0)
+    , max_(0)
+{
+    for(int i = 0; i < kBuckets; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int StatsHistogram::bucketOf(uint64_t value)
+{
+    if(value < (2u << kSubBits))
+    {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);     // >= kSubBits + 1
+    int sub = static_cast<int>((value >> (exponent - kSubBits)) & ((1u << kSubBits) - 1));
+    return ((exponent - kSubBits + 1) << kSubBits) + sub;
+}
+
+uint64_t StatsHistogram::upperBoundOf(int bucket)
+{
+    if(bucket < (2 << kSubBits))
+    {
+        return static_cast<uint64_t>(bucket);
+    }
+    int exponent = (bucket >> kSubBits) + kSubBits - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket & ((1 << kSubBits) - 1));
+    uint64_t width = uint64_t(1) << (exponent - kSubBits);
+    return ((uint64_t(1) << exponent) | (sub << (exponent - kSubBits))) + width - 1;
+}
+
+void StatsHistogram::record(uint64_t value)
+{
+    counts_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t old = max_.load(std::memory_order_relaxed);
+    while(value > old && !max_.compare_exchange_weak(old, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+StatsHistogram::Snapshot StatsHistogram::snapshot() const
+{
+    Snapshot s;
+    for(int i = 0; i < kBuckets; ++i)
+    {
+        s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        s.count += s.counts[i];
+    }
+    s.sum = sum_.load(std::memory_order_relaxed);
+    s.max = max_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void ConnectionHistograms::Snapshot::merge(const Snapshot& other)
+{
+    responseMicros.merge(other.responseMicros);
+    highWaterMicros.merge(other.highWaterMicros);
+    bytesIn.merge(other.bytesIn);
+    bytesOut.merge(other.bytesOut);
+}
+
+ConnectionHistograms::Snapshot ConnectionHistograms::snapshot() const
+{
+    Snapshot s;
+    s.responseMicros = responseMicros.snapshot();
+    s.highWaterMicros = highWaterMicros.snapshot();
+    s.bytesIn = bytesIn.snapshot();
+    s.bytesOut = bytesOut.snapshot();
+    return s;
+}
+
+ConnectionStatsSnapshot::ConnectionStatsSnapshot()
+    : id(0)
+    , bytesIn(0)
+    , bytesOut(0)
+    , messagesIn(0)
+    , messagesOut(0)
+    , readCalls(0)
+    , writeCalls(0)
+    , highWaterMicros(0)
+    , inputBytes(0)
+    , outputBytes(0)
+    , responses(0)
+    , responseMicros(0)
+    , responseMicrosMax(0)
+{
+}
+
+std::string ConnectionStatsSnapshot::toString() const
+{
+    char text[512];
+    snprintf(text, sizeof text,
+             "id=%" PRIu64 " peer=%s bytes_in=%" PRIu64 " bytes_out=%" PRIu64
+             " messages_in=%" PRIu64 " messages_out=%" PRIu64 " reads=%" PRIu64 " writes=%" PRIu64
+             " high_water_us=%" PRIu64 " input_bytes=%" PRIu64 " output_bytes=%" PRIu64
+             " responses=%" PRIu64 " response_us_mean=%.1f response_us_max=%" PRIu64,
+             id, peer.toIpPort().c_str(), bytesIn, bytesOut,
+             messagesIn, messagesOut, readCalls, writeCalls,
+             highWaterMicros, inputBytes, outputBytes,
+             responses, meanResponseMicros(), responseMicrosMax);
+    return text;
+}
+
+ConnectionStats::ConnectionStats()
+    : bytesIn_(0)
+    , bytesOut_(0)
+    , messagesIn_(0)
+    , messagesOut_(0)
+    , readCalls_(0)
+    , writeCalls_(0)
+    , highWaterMicros_(0)
+    , highWaterSince_(0)
+    , inputBytes_(0)
+    , outputBytes_(0)
+    , responses_(0)
+    , responseMicros_(0)
+    , responseMicrosMax_(0)
+{
+}
+
+void ConnectionStats::enterHighWater(int64_t nowMicros)
+{
+    if(highWaterSince_.load(std::memory_order_relaxed) == 0)
+    {
+        highWaterSince_.store(nowMicros, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionStats::leaveHighWater(int64_t nowMicros)
+{
+    int64_t since = highWaterSince_.load(std::memory_order_relaxed);
+    if(since != 0)
+    {
+        add(highWaterMicros_, nowMicros > since ? nowMicros - since : 0);
+        highWaterSince_.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionStats::addResponse(int64_t micros)
+{
+    uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+    add(responses_, 1);
+    add(responseMicros_, value);
+    if(value > responseMicrosMax_.load(std::memory_order_relaxed))
+    {
+        responseMicrosMax_.store(value, std::memory_order_relaxed);
+    }
+}
+
+ConnectionStatsSnapshot ConnectionStats::snapshot(int64_t nowMicros) const
+{
+    ConnectionStatsSnapshot s;
+    s.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    s.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    s.messagesIn = messagesIn_.load(std::memory_order_relaxed);
+    s.messagesOut = messagesOut_.load(std::memory_order_relaxed);
+    s.readCalls = readCalls_.load(std::memory_order_relaxed);
+    s.writeCalls = writeCalls_.load(std::memory_order_relaxed);
+    s.highWaterMicros = highWaterMicros_.load(std::memory_order_relaxed);
+    int64_t since = highWaterSince_.load(std::memory_order_relaxed);
+    if(since != 0 && nowMicros > since)
+    {
+        s.highWaterMicros += nowMicros - since;
+    }
+    s.inputBytes = inputBytes_.load(std::memory_order_relaxed);
+    s.outputBytes = outputBytes_.load(std::memory_order_relaxed);
+    s.responses = responses_.load(std::memory_order_relaxed);
+    s.responseMicros = responseMicros_.load(std::memory_order_relaxed);
+    s.responseMicrosMax = responseMicrosMax_.load(std::memory_order_relaxed);
+    return s;
+}
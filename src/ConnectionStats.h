@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief
+ * 对数分桶的直方图，记录非负整数，相对误差不超过1/8
+ * 小于16的值各占一个桶，之后每个2的幂区间分8个桶
+ * 桶计数是原子的，多个线程可以同时record，任意线程可以snapshot
+ */
+class StatsHistogram : noncopyable
+{
+public:
+    static const int kSubBits = 3;
+    static const int kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    /// 某一时刻的拷贝，可以合并多个直方图
+    struct Snapshot
+    {
+        std::vector<uint64_t> counts;
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+
+        Snapshot();
+        void merge(const Snapshot& other);
+        /// 第q分位(0~1)所在桶的上界，不超过max
+        uint64_t percentile(double q) const;
+        double mean() const { return count == 0 ? 0 : static_cast<double>(sum) / count; }
+    };
+
+    StatsHistogram();
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t upperBoundOf(int bucket);
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets];
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * @brief
+ * TcpServer的连接统计直方图，每个loop一份，读取时合并，避免不同loop争用同一批计数
+ * responseMicros每次响应写完时记录；其余在连接销毁时按整条连接记录一次
+ */
+struct ConnectionHistograms : noncopyable
+{
+    StatsHistogram responseMicros;      // 从收到请求到响应全部写进socket
+    StatsHistogram highWaterMicros;     // 每条连接待发送数据超过高水位的总时间
+    StatsHistogram bytesIn;             // 每条连接收到的字节数
+    StatsHistogram bytesOut;            // 每条连接发出的字节数
+
+    struct Snapshot
+    {
+        StatsHistogram::Snapshot responseMicros;
+        StatsHistogram::Snapshot highWaterMicros;
+        StatsHistogram::Snapshot bytesIn;
+        StatsHistogram::Snapshot bytesOut;
+
+        void merge(const Snapshot& other);
+    };
+    Snapshot snapshot() const;
+};
+
+/// 一条连接的统计在某一时刻的拷贝
+struct ConnectionStatsSnapshot
+{
+    ConnectionId id;
+    InetAddress peer;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;        // 调用messageCallback的次数
+    uint64_t messagesOut;       // 调用send的次数
+    uint64_t readCalls;         // read系统调用次数
+    uint64_t writeCalls;        // write/writev系统调用次数
+    uint64_t highWaterMicros;   // 待发送数据超过高水位的总时间，包括正在进行的这一段
+    uint64_t inputBytes;        // inputBuffer_中未处理的字节数
+    uint64_t outputBytes;       // 还没写进socket的字节数
+    uint64_t responses;         // 完成的响应数
+    uint64_t responseMicros;    // 响应时间之和
+    uint64_t responseMicrosMax;
+
+    ConnectionStatsSnapshot();
+
+    double meanResponseMicros() const { return responses == 0 ? 0 : static_cast<double>(responseMicros) / responses; }
+    std::string toString() const;
+};
+
+/**
+ * @brief
+ * 一条TcpConnection自身的收发统计，TcpConnection持有
+ * 只由连接当前所属的loop线程写，单写者用relaxed的load+store更新；任意线程可以snapshot
+ */
+class ConnectionStats : noncopyable
+{
+public:
+    ConnectionStats();
+
+    void addRead(ssize_t n)
+    {
+        add(readCalls_, 1);
+        if(n > 0)
+        {
+            add(bytesIn_, n);
+        }
+    }
+    void addWrite(ssize_t n)
+    {
+        add(writeCalls_, 1);
+        if(n > 0)
+        {
+            add(bytesOut_, n);
+        }
+    }
+    void addMessageIn() { add(messagesIn_, 1); }
+    void addMessageOut() { add(messagesOut_, 1); }
+    void setInputBytes(size_t n) { inputBytes_.store(n, std::memory_order_relaxed); }
+    void setOutputBytes(size_t n) { outputBytes_.store(n, std::memory_order_relaxed); }
+
+    /// 待发送数据越过高水位 / 回落到高水位以下，时间为微秒
+    void enterHighWater(int64_t nowMicros);
+    void leaveHighWater(int64_t nowMicros);
+    /// 不读时钟，调用方先检查再取时间调用leaveHighWater
+    bool inHighWater() const { return highWaterSince_.load(std::memory_order_relaxed) != 0; }
+    void addResponse(int64_t micros);
+
+    uint64_t bytesIn() const { return bytesIn_.load(std::memory_order_relaxed); }
+    uint64_t bytesOut() const { return bytesOut_.load(std::memory_order_relaxed); }
+    uint64_t highWaterMicros() const { return highWaterMicros_.load(std::memory_order_relaxed); }
+
+    /// Thread safe. id和peer由调用方填写
+    ConnectionStatsSnapshot snapshot(int64_t nowMicros) const;
+
+private:
+    static void add(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> bytesIn_;
+    std::atomic<uint64_t> bytesOut_;
+    std::atomic<uint64_t> messagesIn_;
+    std::atomic<uint64_t> messagesOut_;
+    std::atomic<uint64_t> readCalls_;
+    std::atomic<uint64_t> writeCalls_;
+    std::atomic<uint64_t> highWaterMicros_;
+    std::atomic<int64_t> highWaterSince_;   // 0表示当前不在高水位之上
+    std::atomic<uint64_t> inputBytes_;
+    std::atomic<uint64_t> outputBytes_;
+    std::atomic<uint64_t> responses_;
+    std::atomic<uint64_t> responseMicros_;
+    std::atomic<uint64_t> responseMicrosMax_;
+};
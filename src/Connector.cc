@@ -0,0 +1,229 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// 本机连本机的端口时, 内核可能把临时端口分配成目标端口而"连上自己"
+static bool isSelfConnect(int sockfd)
+{
+    InetAddress local = InetAddress::localAddressOf(sockfd);
+    InetAddress peer = InetAddress::peerAddressOf(sockfd);
+    if(local.isUnix() || peer.isUnix())
+    {
+        return false;   // Unix域没有临时端口
+    }
+    const sockaddr_in* l = local.getSockAddrInet();
+    const sockaddr_in* p = peer.getSockAddrInet();
+    return l->sin_port == p->sin_port && l->sin_addr.s_addr == p->sin_addr.s_addr;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , initRetryDelayMs_(kInitRetryDelayMs)
+    , maxRetryDelayMs_(kMaxRetryDelayMs)
+    , retryDelayMs_(kInitRetryDelayMs)
+    , retryPending_(false)
+{
+}
+
+Connector::~Connector()
+{
+    assert(!channel_);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->runInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    retryPending_ = false;
+    if(connect_ && state_ == kDisconnected)
+    {
+        connect();
+    }
+}
+
+void Connector::stopInLoop()
+{
+    if(retryPending_)
+    {
+        loop_->cancel(retryTimer_);
+        retryPending_ = false;
+    }
+    if(state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        ::close(removeAndResetChannel());
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = ::socket(serverAddr_.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        // fd耗尽等情况稍后再试
+        LOG_ERROR("Connector::connect socket error %d (%s)", errno, strerror(errno));
+        retry(-1);
+        return;
+    }
+    int ret = ::connect(sockfd, serverAddr_.getSockAddr(), serverAddr_.getSockLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch(savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENOENT:        // Unix域服务端还没有创建socket文件
+    case ENETUNREACH:
+    case ETIMEDOUT:
+        retry(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("Connector::connect %s error %d (%s)",
+                serverAddr_.toIpPort().c_str(), savedErrno, strerror(savedErrno));
+        ::close(sockfd);
+        break;
+    }
+}
+
+// 连接结果(成功或失败)都以可写事件通知
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    assert(!channel_);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 可能正处于channel_的回调中, 不能在这里析构它
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if(state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if(err)
+    {
+        LOG_INFO("Connector::handleWrite %s SO_ERROR = %d (%s)",
+                serverAddr_.toIpPort().c_str(), err, strerror(err));
+        retry(sockfd);
+    }
+    else if(isSelfConnect(sockfd))
+    {
+        LOG_INFO("Connector::handleWrite %s self connect", serverAddr_.toIpPort().c_str());
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if(connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_INFO("Connector::handleError %s SO_ERROR = %d (%s)",
+                serverAddr_.toIpPort().c_str(), err, strerror(err));
+        retry(sockfd);
+    }
+}
+
+// 关闭失败的socket, 退避后重连. 实际等待时间在[delay/2, delay]之间随机,
+// 避免大量客户端在服务端重启后同时重连
+void Connector::retry(int sockfd)
+{
+    if(sockfd >= 0)
+    {
+        ::close(sockfd);
+    }
+    setState(kDisconnected);
+    if(connect_)
+    {
+        int delayMs = retryDelayMs_ / 2 + ::rand() % (retryDelayMs_ / 2 + 1);
+        LOG_INFO("Connector::retry connecting to %s in %d milliseconds",
+                serverAddr_.toIpPort().c_str(), delayMs);
+        retryTimer_ = loop_->runAfter(delayMs / 1000.0,
+                std::bind(&Connector::startInLoop, shared_from_this()));
+        retryPending_ = true;
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+    }
+}
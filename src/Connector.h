@@ -0,0 +1,71 @@
+#pragma once
+
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "TimerId.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class Channel;
+class EventLoop;
+
+/**
+ * @brief 非阻塞主动连接, 供TcpClient使用
+ * connect返回EINPROGRESS后等待EPOLLOUT, 用SO_ERROR判断结果;
+ * 失败时按指数退避(加随机抖动)重试, 直到连上或stop
+ */
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+
+    Connector(EventLoop* loop, const InetAddress& serverAddr);
+    ~Connector();
+
+    /// 连接成功后在loop线程中回调, sockfd的所有权交给回调方
+    void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    /// 重试间隔从initMs开始每次翻倍, 不超过maxMs. Call before start().
+    void setRetryDelay(int initMs, int maxMs) {
+        initRetryDelayMs_ = retryDelayMs_ = initMs;
+        maxRetryDelayMs_ = maxMs;
+    }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();       // can be called in any thread
+    void restart();     // must be called in loop thread
+    void stop();        // can be called in any thread
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop* loop_;
+    const InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    States state_;
+    std::unique_ptr<Channel> channel_;      // 只在连接进行中存在
+    NewConnectionCallback newConnectionCallback_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+    bool retryPending_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
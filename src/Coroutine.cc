@@ -0,0 +1,97 @@
+#include "Coroutine.h"
+
+#include <stdlib.h>
+
+#include <mutex>
+#include <new>
+
+namespace
+{
+
+// 已退出线程留下的空闲块, 按档位串成链表
+std::mutex orphanMutex;
+void* orphanLists[CoFramePool::kMaxSize / CoFramePool::kAlign];
+
+}
+
+CoFramePool& CoFramePool::current()
+{
+    static thread_local CoFramePool pool;
+    return pool;
+}
+
+CoFramePool::CoFramePool()
+    : allocations_(0)
+    , chunkBytes_(0)
+{
+    std::lock_guard<std::mutex> lock(orphanMutex);
+    for(size_t i = 0; i < kNumClasses; ++i)
+    {
+        freeLists_[i] = static_cast<FreeBlock*>(orphanLists[i]);
+        orphanLists[i] = nullptr;
+    }
+}
+
+// chunk不还给系统: 别的线程里可能还有从这里分配、尚未结束的帧
+CoFramePool::~CoFramePool()
+{
+    std::lock_guard<std::mutex> lock(orphanMutex);
+    for(size_t i = 0; i < kNumClasses; ++i)
+    {
+        FreeBlock* list = freeLists_[i];
+        while(list != nullptr)
+        {
+            FreeBlock* next = list->next;
+            list->next = static_cast<FreeBlock*>(orphanLists[i]);
+            orphanLists[i] = list;
+            list = next;
+        }
+    }
+}
+
+void* CoFramePool::allocate(size_t size)
+{
+    if(size > kMaxSize)
+    {
+        return ::operator new(size);
+    }
+    size_t cls = (size - 1) / kAlign;
+    if(freeLists_[cls] == nullptr)
+    {
+        newChunk(cls);
+    }
+    FreeBlock* block = freeLists_[cls];
+    freeLists_[cls] = block->next;
+    ++allocations_;
+    return block;
+}
+
+void CoFramePool::deallocate(void* p, size_t size)
+{
+    if(size > kMaxSize)
+    {
+        ::operator delete(p);
+        return;
+    }
+    size_t cls = (size - 1) / kAlign;
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = freeLists_[cls];
+    freeLists_[cls] = block;
+}
+
+void CoFramePool::newChunk(size_t cls)
+{
+    size_t blockSize = (cls + 1) * kAlign;
+    char* chunk = static_cast<char*>(::aligned_alloc(kAlign, blockSize * kBlocksPerChunk));
+    if(chunk == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    chunkBytes_ += blockSize * kBlocksPerChunk;
+    for(size_t i = 0; i < kBlocksPerChunk; ++i)
+    {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+        block->next = freeLists_[cls];
+        freeLists_[cls] = block;
+    }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+// C++20协程支持, 只在MODUO_WITH_COROUTINE打开时编译进ModuoCoro, 核心库仍是C++11
+#include "EventLoop.h"
+#include "noncopyable.h"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief 协程帧的定长块池, 每个线程一个(one loop per thread, 即每个loop一个)
+ * 按64字节分档, 超过kMaxSize的帧直接走operator new. 协程在所属loop中创建和恢复,
+ * 分配和回收都不加锁; 连接迁移后在别的loop中结束的帧放回那个线程的池.
+ * 线程退出时空闲块交给全局链表, 由之后第一次使用池的线程接管
+ */
+class CoFramePool : noncopyable
+{
+public:
+    static const size_t kAlign = 64;
+    static const size_t kMaxSize = 4096;
+
+    /// 当前线程的池
+    static CoFramePool& current();
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    /// 从池中分配的次数与向系统申请的chunk字节数, 供压测观察复用情况
+    size_t allocations() const { return allocations_; }
+    size_t chunkBytes() const { return chunkBytes_; }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    static const size_t kNumClasses = kMaxSize / kAlign;
+    static const size_t kBlocksPerChunk = 32;
+
+    CoFramePool();
+    ~CoFramePool();
+    void newChunk(size_t cls);
+
+    FreeBlock* freeLists_[kNumClasses];
+    size_t allocations_;
+    size_t chunkBytes_;
+};
+
+template <typename T> class CoTask;
+
+/// 所有CoTask的promise共用的部分: 帧从CoFramePool分配, 结束时对称转移到等待者
+class CoPromiseBase
+{
+public:
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            CoPromiseBase& promise = h.promise();
+            std::coroutine_handle<> next = promise.continuation_;
+            if(promise.detached_)
+            {
+                h.destroy();
+            }
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception()
+    {
+        if(detached_)
+        {
+            std::terminate();   // 没有等待者可以接收异常
+        }
+        exception_ = std::current_exception();
+    }
+
+    static void* operator new(size_t size) { return CoFramePool::current().allocate(size); }
+    static void operator delete(void* p, size_t size) { CoFramePool::current().deallocate(p, size); }
+
+    void setContinuation(std::coroutine_handle<> h) { continuation_ = h; }
+    void detach() { detached_ = true; }
+
+protected:
+    void rethrowIfFailed()
+    {
+        if(exception_)
+        {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+private:
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr exception_;
+    bool detached_ = false;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase
+{
+public:
+    CoTask<T> get_return_object();
+    template <typename U>
+    void return_value(U&& value) { value_.emplace(std::forward<U>(value)); }
+    T result()
+    {
+        rethrowIfFailed();
+        return std::move(*value_);
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase
+{
+public:
+    CoTask<void> get_return_object();
+    void return_void() {}
+    void result() { rethrowIfFailed(); }
+};
+
+/**
+ * @brief 惰性启动的协程: 被co_await时才开始执行, 结束后直接恢复等待者(对称转移, 不经过loop队列)
+ * 顶层协程用coSpawn启动. 协程只应在一个loop线程中恢复, 它等待的连接、定时器都属于这个loop
+ *
+ * CoTask<void> session(CoStreamPtr stream)
+ * {
+ *     for(;;)
+ *     {
+ *         std::string line = co_await stream->readUntil("\r\n");
+ *         if(line.empty()) break;
+ *         co_await stream->write(line);
+ *     }
+ * }
+ */
+template <typename T = void>
+class CoTask : noncopyable
+{
+public:
+    using promise_type = CoPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit CoTask(Handle h) : h_(h) {}
+    CoTask(CoTask&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+    ~CoTask()
+    {
+        if(h_)
+        {
+            h_.destroy();
+        }
+    }
+
+    struct Awaiter
+    {
+        Handle h;
+        bool await_ready() { return !h || h.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+        {
+            h.promise().setContinuation(caller);
+            return h;
+        }
+        T await_resume() { return h.promise().result(); }
+    };
+    Awaiter operator co_await() && { return Awaiter{ h_ }; }
+
+    /// 交出协程帧的所有权, 供coSpawn使用
+    Handle release() { return std::exchange(h_, nullptr); }
+
+private:
+    Handle h_;
+};
+
+template <typename T>
+CoTask<T> CoPromise<T>::get_return_object()
+{
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object()
+{
+    return CoTask<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
+
+/// 在当前线程中立即开始执行task, 直到它第一次挂起; 结束后帧自行销毁. 应在task所用loop的线程中调用
+inline void coSpawn(CoTask<void> task)
+{
+    std::coroutine_handle<CoPromise<void>> h = task.release();
+    h.promise().detach();
+    h.resume();
+}
+
+/// co_await coSleep(loop, 0.5): 由loop的定时器在seconds秒后恢复, 应在loop线程中等待
+/// 等待期间协程帧被销毁(例如持有它的CoTask析构)时, awaiter随帧析构并取消定时器
+class CoSleep
+{
+public:
+    CoSleep(EventLoop* loop, double seconds) : loop_(loop), seconds_(seconds), pending_(false) {}
+    ~CoSleep()
+    {
+        if(pending_)
+        {
+            loop_->cancel(timer_);
+        }
+    }
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        pending_ = true;
+        // awaiter在协程帧中, 挂起期间地址不变
+        timer_ = loop_->runAfter(seconds_, [this, h]() {
+            pending_ = false;   // 恢复后awaiter可能随即析构
+            h.resume();
+        });
+    }
+    void await_resume() const {}
+
+private:
+    EventLoop* loop_;
+    double seconds_;
+    TimerId timer_;
+    bool pending_;      // 定时器已登记还没触发
+};
+
+inline CoSleep coSleep(EventLoop* loop, double seconds)
+{
+    return CoSleep(loop, seconds);
+}
@@ -74,6 +74,7 @@ void EPollPoller::updateChannel(Channel *channel)
         {
             int fd = channel->fd();
             channels_[fd] = channel;
+            ownerLoop()->stats().setChannels(channels_.size());
         }
         channel->set_index(kAdded);
         update(EPOLL_CTL_ADD, channel);
@@ -84,6 +85,7 @@ void EPollPoller::updateChannel(Channel *channel)
         if(channel->isNoneEvent())      // fd无感兴趣事件
         {
             update(EPOLL_CTL_DEL, channel); 
+            channel->set_index(kDeleted);   // 之后remove不必再DEL
         }
         else                            // fd有感兴趣事件
         {
@@ -101,7 +103,11 @@ void EPollPoller::removeChannel(Channel *channel)
     if(index == kAdded)
     {
         update(EPOLL_CTL_DEL, channel);
+    }
+    if(index != kNew)
+    {
         channels_.erase(fd);
+        ownerLoop()->stats().setChannels(channels_.size());
     }
     channel->set_index(kNew);   // 重置为初始状态
 }
@@ -127,6 +133,7 @@ void EPollPoller::update(int operation, Channel *channel)
     event.data.fd = fd;
     event.data.ptr = channel;
 
+    ownerLoop()->stats().addEpollCtl();
     if(::epoll_ctl(epollfd_, operation, fd, &event) < 0)    // success = 0, errno = -1
     {
         if (operation == EPOLL_CTL_DEL)
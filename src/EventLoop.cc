@@ -1,14 +1,20 @@
 #include "EventLoop.h"
 #include "Logger.h"
+#include "LoopChannel.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "UpstreamPool.h"
 #include <errno.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <algorithm>
+
 thread_local EventLoop* t_loopInThisThread = 0; // 线程局部存储，防止一个线程创建多个eventloop
 
 const int kPollTimeoutMs = 10000;   // Poller轮询超时时间10s
+const int kMaxStealableTasks = 16;  // 每轮最多执行的可窃取任务数，避免饿死IO
 
 int createEventfd()
 {
@@ -24,11 +30,19 @@ int createEventfd()
 EventLoop::EventLoop()
     : looping_(false)
     , quit_(false)
-    , callingPendingFunctors_(false)
+    , polling_(false)
     , threadId_(currentThread::tid())
-    , poller_(Poller::newDefaultPoller(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
+    , callingPendingFunctors_(false)
+    , drainingLoopChannels_(false)
+    , stealGroup_(nullptr)
+    , nextPeer_(0)
+    , connectionPool_(std::make_shared<MemoryPool>())
+    , connectionCount_(0)
+    , pendingBytes_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, threadId_);
     if(t_loopInThisThread)
@@ -44,12 +58,22 @@ EventLoop::EventLoop()
 }
 EventLoop::~EventLoop()
 {
+    upstreamPool_.reset();
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
     t_loopInThisThread = nullptr;
 }
 
+UpstreamPool& EventLoop::upstreamPool()
+{
+    if(!upstreamPool_)
+    {
+        upstreamPool_.reset(new UpstreamPool(this));
+    }
+    return *upstreamPool_;
+}
+
 void EventLoop::loop()
 {
     looping_ = true;
@@ -60,17 +84,33 @@ void EventLoop::loop()
         activeChannels_.clear();
         // poller监听哪些channel发生事件了，上报给eventloop，通知channel处理
         // epollwait 阻塞 kPollTimeoutMs
-        pollReturnTime_ = poller_->poll(kPollTimeoutMs, &activeChannels_);  // 往activeChannels_中添加就绪事件
+        polling_ = true;
+        // 先置polling_再检查LoopChannel, 与生产者"写入后检查polling_"配对, 不会漏掉唤醒
+        int timeoutMs = loopChannelsReadable() ? 0 : kPollTimeoutMs;
+        int64_t pollStart = LoopStats::nowNanos();
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);  // 往activeChannels_中添加就绪事件
+        polling_ = false;
+        int64_t pollEnd = LoopStats::nowNanos();
+        stats_.addPoll(activeChannels_.size(), pollEnd - pollStart);
+        activity_.beginIteration(pollEnd);
 
         for(Channel* channel : activeChannels_)
         {
+            activity_.setChannel(channel->fd());
             channel->handleEvent(pollReturnTime_);
         }
+        activity_.setChannel(-1);
+        int64_t callbacksEnd = LoopStats::nowNanos();
+        stats_.addCallbackNanos(callbacksEnd - pollEnd);
         /**
          *  执行当前eventloop事件循环要处理的回调任务
          *  IO线程mainloop accept fd <= channel subloop
          */ 
         doPendingFunctors();
+        drainLoopChannels();
+        doStealableTasks();
+        stats_.addFunctorNanos(LoopStats::nowNanos() - callbacksEnd);
+        activity_.endIteration();
     }
     LOG_INFO("EventLoop %p stop looping\n", this);
     looping_ = false;
@@ -102,6 +142,7 @@ void EventLoop::queueInLoop(Functor cb)
     {
         std::unique_lock<std::mutex> lock(mutex_);
         pendingFunctors_.push_back(std::move(cb));
+        stats_.setPendingFunctors(pendingFunctors_.size());
     }
     // 唤醒loop线程，执行cb
     if(!isInLoopThread() || callingPendingFunctors_)    // 当前loop线程不在loop，或者loop线程正在执行回调任务
@@ -109,6 +150,44 @@ void EventLoop::queueInLoop(Functor cb)
         wakeup();
     }
 }
+void EventLoop::queueStealable(Functor cb)
+{
+    bool ownerIdle = polling_;
+    stealableTasks_.push(std::move(cb));
+    StealGroup* group = stealGroup_;
+    if(group != nullptr)
+    {
+        ++group->stealable;
+    }
+    if(!isInLoopThread())
+    {
+        wakeup();           // 与queueInLoop相同，保证任务不会一直留在队列里
+    }
+    if(!ownerIdle)
+    {
+        wakeupIdlePeer();   // 本loop正忙，叫醒一个空闲的loop来窃取
+    }
+}
+void EventLoop::wakeupIdlePeer()
+{
+    StealGroup* group = stealGroup_;
+    if(group == nullptr)
+    {
+        return;
+    }
+    // 从不同位置开始找，避免总是叫醒同一个loop
+    const std::vector<EventLoop*>& loops = group->loops;
+    size_t start = nextPeer_++;
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        EventLoop* peer = loops[(start + i) % loops.size()];
+        if(peer != this && peer->polling_)
+        {
+            peer->wakeup();
+            return;
+        }
+    }
+}
 void EventLoop::wakeup()
 {
     uint64_t one = 1;
@@ -118,6 +197,75 @@ void EventLoop::wakeup()
         LOG_ERROR("EventLoop::wakeup() writes %lu bytes instead of 8\n", n);
     }
 }
+bool EventLoop::wakeupIfPolling()
+{
+    // 清掉polling_, 同一次poll期间的其他生产者不再重复写eventfd
+    if(polling_.load(std::memory_order_relaxed) && polling_.exchange(false))
+    {
+        wakeup();
+        return true;
+    }
+    return false;
+}
+void EventLoop::addLoopChannel(LoopChannelBase* channel)
+{
+    loopChannels_.push_back(channel);
+}
+void EventLoop::removeLoopChannel(LoopChannelBase* channel)
+{
+    if(drainingLoopChannels_)
+    {
+        // 正在遍历, 先置空, drainLoopChannels结束时再移除
+        std::replace(loopChannels_.begin(), loopChannels_.end(), channel, static_cast<LoopChannelBase*>(nullptr));
+        return;
+    }
+    loopChannels_.erase(std::remove(loopChannels_.begin(), loopChannels_.end(), channel), loopChannels_.end());
+}
+bool EventLoop::loopChannelsReadable() const
+{
+    for(LoopChannelBase* channel : loopChannels_)
+    {
+        if(channel != nullptr && channel->readable())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+// 处理期间可能有LoopChannel被注册或注销: 按下标遍历, 注销的先置空, 遍历结束后再移除
+void EventLoop::drainLoopChannels()
+{
+    activity_.setPhase(LoopActivity::kLoopChannel);
+    drainingLoopChannels_ = true;
+    for(size_t i = 0; i < loopChannels_.size(); ++i)
+    {
+        if(loopChannels_[i] != nullptr)
+        {
+            loopChannels_[i]->drain();
+        }
+    }
+    drainingLoopChannels_ = false;
+    loopChannels_.erase(std::remove(loopChannels_.begin(), loopChannels_.end(), static_cast<LoopChannelBase*>(nullptr)),
+                        loopChannels_.end());
+}
+TimerId EventLoop::runAt(Timestamp time, std::function<void()> cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+TimerId EventLoop::runAfter(double delay, std::function<void()> cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+TimerId EventLoop::runEvery(double interval, std::function<void()> cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
 void EventLoop::updateChannel(Channel* channel)
 {
     poller_->updateChannel(channel);
@@ -138,6 +286,7 @@ void EventLoop::handleRead()
     {
         LOG_ERROR("EventLoop::handleRead() reads %d bytes instead of 8", (int)n);
     }
+    stats_.addWakeup();
 }
 void EventLoop::doPendingFunctors()
 {
@@ -146,10 +295,55 @@ void EventLoop::doPendingFunctors()
     {
         std::unique_lock<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
+        stats_.setPendingFunctors(0);
     }
     for(const Functor& functor : functors)
     {
+        activity_.setCallback(LoopActivity::kPendingFunctor, &functor.target_type());
         functor();
     }
+    stats_.addFunctorsRun(functors.size());
     callingPendingFunctors_ = false;
-}
\ No newline at end of file
+}
+// 先执行本loop的可窃取任务，本loop没有时从组内其它loop尾部窃取
+void EventLoop::doStealableTasks()
+{
+    StealGroup* group = stealGroup_;
+    Functor task;
+    int n = 0;
+    while(n < kMaxStealableTasks && stealableTasks_.pop(task))
+    {
+        if(group != nullptr)
+        {
+            --group->stealable;
+        }
+        activity_.setCallback(LoopActivity::kStealableTask, &task.target_type());
+        task();
+        ++n;
+    }
+    bool stolen = false;
+    // 组内没有积压时不去锁其它loop的队列
+    if(n == 0 && group != nullptr && group->stealable.load(std::memory_order_relaxed) > 0)
+    {
+        for(EventLoop* peer : group->loops)
+        {
+            while(peer != this && n < kMaxStealableTasks && peer->stealableTasks_.steal(task))
+            {
+                --group->stealable;
+                activity_.setCallback(LoopActivity::kStealableTask, &task.target_type());
+                task();
+                ++n;
+                stolen = true;
+            }
+        }
+    }
+    // 还有积压时不要阻塞在poll上，窃取满一批说明别处积压较多，再叫一个空闲loop帮忙
+    if(n == kMaxStealableTasks || stealableTasks_.size() > 0)
+    {
+        wakeup();
+        if(stolen)
+        {
+            wakeupIdlePeer();
+        }
+    }
+}
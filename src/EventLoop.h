@@ -2,15 +2,24 @@
 #include "Channel.h"
 #include "const.h"
 #include "CurrentThread.h"
+#include "LoopActivity.h"
+#include "LoopStats.h"
+#include "MemoryPool.h"
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "TimerId.h"
+#include "WorkStealingQueue.h"
 #include <atomic>
 #include <functional>
 #include <mutex>
 #include <thread>
 
 class Channel;
+class LoopChannelBase;
 class Poller;
+struct StealGroup;
+class TimerQueue;
+class UpstreamPool;
 // 事件循环 —— channel & poller(epoll)
 // 1 eventloop -- 1 poller -- n channels
 class EventLoop : public noncopyable
@@ -25,7 +34,29 @@ public:
     void queueInLoop(Functor cb);   // 在当前线程中执行回调函数，如果不在当前线程中，则将回调函数放入队列中，等待下一次循环执行
     Timestamp pollReturnTime() const {return pollReturnTime_;}
 
+    // 定时器，线程安全，回调在loop线程中执行
+    TimerId runAt(Timestamp time, std::function<void()> cb);        // 在time时刻执行
+    TimerId runAfter(double delay, std::function<void()> cb);       // delay秒后执行
+    TimerId runEvery(double interval, std::function<void()> cb);    // 每隔interval秒执行
+    void cancel(TimerId timerId);
+
     void wakeup();  // 唤醒事件循环
+    /// 其他线程写入了本loop每轮都会检查的数据(LoopChannel)之后调用, 调用前须有seq_cst fence.
+    /// 只在本loop阻塞于poll时写eventfd, 同一次poll只唤醒一次; 返回是否写了eventfd
+    bool wakeupIfPolling();
+
+    /// 注册每轮循环在pending functors之后批量处理的LoopChannel, 有未处理的消息时poll不阻塞.
+    /// 只能在loop线程中调用
+    void addLoopChannel(LoopChannelBase* channel);
+    void removeLoopChannel(LoopChannelBase* channel);
+
+    /// 与具体loop无关的任务(纯计算、刷新缓存、刷日志等)，不能访问连接等属于某个loop的状态
+    /// 放入本loop的可窃取队列，本loop忙时同组空闲的loop在poll返回之间窃取执行，不保证执行顺序
+    /// 没有加入窃取组时只由本loop执行. Thread safe.
+    void queueStealable(Functor cb);
+    /// 加入窃取组，nullptr表示退出. group由EventLoopThreadPool持有;
+    /// 退出后本loop在下一轮循环起不再访问group及其中的其它loop
+    void setStealGroup(StealGroup* group) { stealGroup_ = group; }
 
     // 从channel中获取操作
     void updateChannel(Channel* channel);       // 更新channel
@@ -33,22 +64,51 @@ public:
     bool hasChannel(Channel* channel) const;    // channel是否存在
 
     bool isInLoopThread() const {return threadId_ == currentThread::tid();} // 判断当前线程是否是事件循环线程
+    pid_t threadId() const { return threadId_; }
+
+    /// 本loop上TcpConnection对象的内存池. Thread safe.
+    const std::shared_ptr<MemoryPool>& connectionPool() const { return connectionPool_; }
+
+    // 负载计数，任意线程可读，供EventLoopThreadPool按负载分发新连接
+    int connectionCount() const { return connectionCount_; }
+    int64_t pendingBytes() const { return pendingBytes_; }     // 所有连接outputBuffer_中待发送的字节数
+    void addConnectionCount(int delta) { connectionCount_ += delta; }
+    void addPendingBytes(int64_t delta) { pendingBytes_ += delta; }
+
+    /// 运行统计，任意线程可读(stats().snapshot())，只由本loop更新
+    const LoopStats& stats() const { return stats_; }
+    LoopStats& stats() { return stats_; }
+    /// 当前正在执行的回调，供LoopWatchdog读取
+    const LoopActivity& activity() const { return activity_; }
+    LoopActivity& activity() { return activity_; }
+
+    /// 本loop的上游连接池，第一次调用时创建. 只能在loop线程中调用
+    UpstreamPool& upstreamPool();
 private:
     using ChannelList = std::vector<Channel*>; 
     
     void handleRead();
     void doPendingFunctors();
+    void doStealableTasks();
+    void drainLoopChannels();
+    bool loopChannelsReadable() const;
+    void wakeupIdlePeer();      // 唤醒组内一个阻塞在poll中的loop来窃取任务
 
     std::atomic_bool looping_;  // CAS
     std::atomic_bool quit_;     // quit loop
+    std::atomic_bool polling_;  // 正阻塞在poll中
 
     const pid_t threadId_; //  定义一个常量pid_t类型的threadId，用于存储线程ID
 
+    LoopStats stats_;       // 须在poller_之前构造，TimerQueue构造时就会注册channel
+    LoopActivity activity_;
+
     int wakeupFd_; //  定义一个整型变量wakeupFd_，用于存储唤醒文件描述符
     std::unique_ptr<Channel> wakeupChannel_; //  定义一个std::unique_ptr<Channel>类型的wakeupChannel_，用于存储唤醒通道
 
     Timestamp pollReturnTime_; //  定义一个Timestamp类型的pollReturnTime_，用于存储轮询返回时间
     std::unique_ptr<Poller> poller_; //  定义一个std::unique_ptr<Poller>类型的poller_，用于存储轮询器
+    std::unique_ptr<TimerQueue> timerQueue_;    // 依赖poller_，必须在poller_之后构造
 
     ChannelList activeChannels_; //  定义一个ChannelList类型的activeChannels_，用于存储活跃通道列表
     Channel* currentActiveChannel_; //  定义一个Channel*类型的currentActiveChannel_，用于存储当前活跃通道
@@ -56,4 +116,28 @@ private:
     std::atomic_bool callingPendingFunctors_;   // loop是否有回调
     std::vector<Functor> pendingFunctors_;  // loop需要执行的所有callback
     std::mutex mutex_;                      // protect pendingFunctors_
-};
\ No newline at end of file
+
+    std::vector<LoopChannelBase*> loopChannels_;   // 只在loop线程中访问
+    bool drainingLoopChannels_;                     // drainLoopChannels中注销的先置空
+
+    WorkStealingQueue<Functor> stealableTasks_;             // 可被同组loop窃取的任务
+    std::atomic<StealGroup*> stealGroup_;
+    std::atomic<size_t> nextPeer_;
+
+    const std::shared_ptr<MemoryPool> connectionPool_;
+    std::atomic_int connectionCount_;       // 绑定在当前loop上的连接数
+    std::atomic<int64_t> pendingBytes_;     // 当前loop上待发送的字节数
+
+    std::unique_ptr<UpstreamPool> upstreamPool_;    // 析构时最先释放，其中的连接还要用到poller_和timerQueue_
+};
+
+/// 互相窃取可窃取任务的一组loop
+struct StealGroup
+{
+    std::vector<EventLoop*> loops;
+    /// 组内所有可窃取队列中的任务数. 只作提示: 为0时空闲的loop不必逐个锁住其它loop的队列;
+    /// 任务在setStealGroup前后入队出队会有偏差，任务总会由所属loop执行，不会丢
+    std::atomic<int64_t> stealable;
+
+    StealGroup() : stealable(0) {}
+};
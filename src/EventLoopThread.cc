@@ -1,5 +1,8 @@
 #include "EventLoopThread.h"
 
+#include <pthread.h>
+#include <sched.h>
+
 EventLoopThread::EventLoopThread(
         const ThreadInitCallback &cb,
         const std::string &name)
@@ -35,8 +38,30 @@ EventLoop* EventLoopThread::startLoop()
     return loop;
 }
 
+// 先绑核再创建loop: 按first-touch策略，loop线程之后分配的内存都落在本地NUMA节点
+void EventLoopThread::bindCpuSet()
+{
+    if(cpus_.empty())
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus_)
+    {
+        CPU_SET(cpu, &set);
+    }
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+    if(ret != 0)
+    {
+        LOG_ERROR("EventLoopThread::bindCpuSet [%s] pthread_setaffinity_np error:%d",
+                thread_.name().c_str(), ret);
+    }
+}
+
 void EventLoopThread::threadFunc()
 {
+    bindCpuSet();
     EventLoop loop; // one loop per thread
     if(callback_)
     {
@@ -19,9 +19,14 @@ public:
                 const std::string &name = std::string());
     ~EventLoopThread();
 
+    /// 线程启动后先绑定到这些CPU上再创建EventLoop. Call before startLoop().
+    void setCpuSet(const std::vector<int>& cpus) { cpus_ = cpus; }
+    const std::vector<int>& cpuSet() const { return cpus_; }
+
     EventLoop* startLoop();
 private:
     void threadFunc();
+    void bindCpuSet();
 
     EventLoop* loop_;
     bool exiting_;
@@ -29,4 +34,5 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    std::vector<int> cpus_;
 };
\ No newline at end of file
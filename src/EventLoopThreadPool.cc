@@ -1,11 +1,30 @@
 #include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <algorithm>
+#include <future>
+
+// FNV-1a, 用于一致性哈希
+static uint32_t fnv1a(const void* data, size_t len, uint32_t hash = 2166136261u)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < len; ++i)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg)
     : baseLoop_(baseLoop),
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      workStealing_(false),
+      policy_(kRoundRobin),
+      rand_(static_cast<unsigned>(reinterpret_cast<uintptr_t>(this)))
 {
 
 } 
@@ -14,6 +33,20 @@ EventLoopThreadPool::~EventLoopThreadPool()
 {
     // thread created locally, do nothing in pool
     // Don't delete loop, it's stack variable
+    // 任何loop退出之前，先让每个loop在自己的线程中退出窃取组:
+    // loop确认后不会再窃取或唤醒组内其它loop，先退出的loop析构时不会被访问
+    if(!stealGroup_.loops.empty())
+    {
+        for(EventLoop* loop : stealGroup_.loops)
+        {
+            std::promise<void> left;
+            loop->runInLoop([loop, &left]() {
+                loop->setStealGroup(nullptr);
+                left.set_value();
+            });
+            left.get_future().wait();
+        }
+    }
 }
 
 void EventLoopThreadPool::start(const ThreadInitCallback& cb)
@@ -25,8 +58,27 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
         char buf[name_.size() + 32];    // 线程名
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
         EventLoopThread* t = new EventLoopThread(cb, buf);
+        if(!cpuSets_.empty())
+        {
+            t->setCpuSet(cpuSets_[i % cpuSets_.size()]);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());   // 底层创建并启动线程，绑定一个新的EventLoop，返回一个EventLoop指针
+        for(int cpu : t->cpuSet())
+        {
+            cpuLoops_.insert(std::make_pair(cpu, loops_.back()));   // 多个loop共用一个cpu时取第一个
+        }
+    }
+
+    buildHashRing();
+
+    if(workStealing_ && loops_.size() > 1)
+    {
+        stealGroup_.loops = loops_;
+        for(EventLoop* loop : loops_)
+        {
+            loop->setStealGroup(&stealGroup_);
+        }
     }
 
     // 服务端只有baseloop一个线程
@@ -38,18 +90,122 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
-    EventLoop* loop = baseLoop_;   
+    if(loops_.empty())
+    {
+        return baseLoop_;
+    }
+    switch(policy_)
+    {
+    case kLeastConnections:
+    case kLeastPendingBytes:
+        return getLeastLoadedLoop();
+    case kPowerOfTwoChoices:
+        return getTwoChoicesLoop();
+    default:
+        return getRoundRobinLoop();
+    }
+}
+
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress& peerAddr)
+{
+    // Unix域客户端通常没有绑定地址, 无从哈希, 退回轮询
+    if(policy_ == kConsistentHash && !loops_.empty() && !peerAddr.isUnix())
+    {
+        return getHashedLoop(peerAddr);
+    }
+    return getNextLoop();
+}
+
+EventLoop* EventLoopThreadPool::getRoundRobinLoop()
+{
     // 轮询算法
-    if(!loops_.empty())
+    EventLoop* loop = loops_[next_];
+    ++next_;
+    if (static_cast<size_t>(next_) >= loops_.size())
+    {
+        next_ = 0;
+    }
+    return loop;
+}
+
+// 计数由各loop线程更新，这里读到的是近似值，足够用于分发
+EventLoop* EventLoopThreadPool::getLeastLoadedLoop()
+{
+    // 从next_开始扫描，负载相同时轮流选择，避免总是落在第一个loop
+    size_t n = loops_.size();
+    size_t best = next_;
+    for(size_t i = 1; i < n; ++i)
     {
-        loop = loops_[next_];
-        ++next_;
-        if (static_cast<size_t>(next_) >= loops_.size())
+        size_t idx = (next_ + i) % n;
+        bool less = policy_ == kLeastPendingBytes
+            ? loops_[idx]->pendingBytes() < loops_[best]->pendingBytes()
+            : loops_[idx]->connectionCount() < loops_[best]->connectionCount();
+        if(less)
         {
-            next_ = 0;
+            best = idx;
         }
     }
-    return loop;
+    next_ = static_cast<int>((best + 1) % n);
+    return loops_[best];
+}
+
+EventLoop* EventLoopThreadPool::getTwoChoicesLoop()
+{
+    size_t n = loops_.size();
+    if(n == 1)
+    {
+        return loops_[0];
+    }
+    size_t a = rand_() % n;
+    size_t b = rand_() % (n - 1);
+    if(b >= a)
+    {
+        ++b;    // 保证a != b
+    }
+    EventLoop* la = loops_[a];
+    EventLoop* lb = loops_[b];
+    if(la->connectionCount() != lb->connectionCount())
+    {
+        return la->connectionCount() < lb->connectionCount() ? la : lb;
+    }
+    return la->pendingBytes() <= lb->pendingBytes() ? la : lb;
+}
+
+// 只对ip哈希，同一客户端的多条连接落在同一loop
+EventLoop* EventLoopThreadPool::getHashedLoop(const InetAddress& peerAddr)
+{
+    const in_addr& ip = peerAddr.getSockAddrInet()->sin_addr;
+    uint32_t hash = fnv1a(&ip, sizeof ip);
+    auto it = std::lower_bound(hashRing_.begin(), hashRing_.end(),
+                               std::make_pair(hash, 0));
+    if(it == hashRing_.end())
+    {
+        it = hashRing_.begin();
+    }
+    return loops_[it->second];
+}
+
+// 每个loop在环上放kVirtualNodes个虚拟节点，loop数变化时只有少量客户端迁移
+void EventLoopThreadPool::buildHashRing()
+{
+    hashRing_.clear();
+    hashRing_.reserve(loops_.size() * kVirtualNodes);
+    for(size_t i = 0; i < loops_.size(); ++i)
+    {
+        for(int v = 0; v < kVirtualNodes; ++v)
+        {
+            char buf[name_.size() + 32];
+            int len = snprintf(buf, sizeof(buf), "%s%zu#%d", name_.c_str(), i, v);
+            hashRing_.push_back(std::make_pair(fnv1a(buf, len), static_cast<int>(i)));
+        }
+    }
+    std::sort(hashRing_.begin(), hashRing_.end());
+}
+
+EventLoop* EventLoopThreadPool::getLoopForCpu(int cpu) const
+{
+    auto it = cpuLoops_.find(cpu);
+    return it != cpuLoops_.end() ? it->second : nullptr;
 }
 
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
@@ -62,4 +218,13 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
     {
         return loops_;
     }
+}
+std::vector<LoopStatsSnapshot> EventLoopThreadPool::loopStats()
+{
+    std::vector<LoopStatsSnapshot> snapshots;
+    for(EventLoop* loop : getAllLoops())
+    {
+        snapshots.push_back(loop->stats().snapshot());
+    }
+    return snapshots;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "noncopyable.h"
 
 #include <functional>
+#include <random>
 
 /**
  * @brief EventLoopThreadPool
@@ -15,18 +16,45 @@
  */
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 class EventLoopThreadPool : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    // 新连接分发策略
+    enum DispatchPolicy
+    {
+        kRoundRobin,            // 轮询
+        kLeastConnections,      // 连接数最少的loop
+        kLeastPendingBytes,     // 待发送字节最少的loop
+        kPowerOfTwoChoices,     // 随机取两个loop，选连接数较少的
+        kConsistentHash,        // 按对端ip一致性哈希，同一客户端落在同一loop
+    };
+
     EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg);
     ~EventLoopThreadPool();
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    /// 第i个线程绑定到cpuSets[i % cpuSets.size()]. Call before start().
+    void setThreadCpuSets(const std::vector<std::vector<int>>& cpuSets) { cpuSets_ = cpuSets; }
+    bool hasCpuAffinity() const { return !cpuSets_.empty(); }
+    /// loop之间互相窃取EventLoop::queueStealable提交的任务. Call before start().
+    void setWorkStealing(bool on) { workStealing_ = on; }
+    /// Not thread safe, set before start()
+    void setDispatchPolicy(DispatchPolicy policy) { policy_ = policy; }
+    DispatchPolicy dispatchPolicy() const { return policy_; }
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
-    /// round-robin
+    /// 按分发策略选择loop，kConsistentHash没有对端地址时退化为round-robin
     EventLoop* getNextLoop();
+    EventLoop* getNextLoop(const InetAddress& peerAddr);
+    /// 绑定了cpu的loop，没有则返回nullptr
+    EventLoop* getLoopForCpu(int cpu) const;
 
     std::vector<EventLoop*> getAllLoops();
+    /// 每个loop的运行统计，顺序同getAllLoops(); start()之后任意线程可调用
+    std::vector<LoopStatsSnapshot> loopStats();
+    /// 所有loop的汇总
+    LoopStatsSnapshot aggregateStats() { return LoopStatsSnapshot::sum(loopStats()); }
 
     bool started() const
     { return started_; }
@@ -34,12 +62,28 @@ public:
     const std::string& name() const
     { return name_; }
 private:
+    EventLoop* getRoundRobinLoop();
+    EventLoop* getLeastLoadedLoop();
+    EventLoop* getTwoChoicesLoop();
+    EventLoop* getHashedLoop(const InetAddress& peerAddr);
+    void buildHashRing();
+
+    static const int kVirtualNodes = 160;   // 每个loop在哈希环上的虚拟节点数
 
     EventLoop *baseLoop_;
     std::string name_;
     int numThreads_;
     bool started_;
     int next_;
+    bool workStealing_;
+    StealGroup stealGroup_;     // 析构时先让所有loop退出窃取组，再结束loop线程
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
+
+    DispatchPolicy policy_;
+    std::minstd_rand rand_;                             // kPowerOfTwoChoices, 只在baseLoop线程使用
+    std::vector<std::pair<uint32_t, int>> hashRing_;    // 哈希值 -> loops_下标, 按哈希值排序
+
+    std::vector<std::vector<int>> cpuSets_;
+    std::unordered_map<int, EventLoop*> cpuLoops_;      // cpu -> 绑定在该cpu上的loop
 };
\ No newline at end of file
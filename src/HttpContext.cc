@@ -0,0 +1,201 @@
+#include "HttpContext.h"
+
+#include <algorithm>
+
+HttpContext::HttpContext()
+    : state_(kExpectRequestLine)
+    , pos_(0)
+    , scanned_(0)
+    , contentLength_(0)
+    , hasContentLength_(false)
+    , version_(HttpRequest::kUnknown)
+{
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    pos_ = 0;
+    scanned_ = 0;
+    contentLength_ = 0;
+    hasContentLength_ = false;
+    version_ = HttpRequest::kUnknown;
+    headers_.clear();
+    request_.reset();
+}
+
+bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
+{
+    const char* base = buf->peek();
+    while(state_ != kGotAll)
+    {
+        if(state_ == kExpectBody)
+        {
+            if(buf->readableBytes() < pos_ + contentLength_)
+            {
+                return true;
+            }
+            pos_ += contentLength_;
+            state_ = kGotAll;
+            break;
+        }
+
+        const char* crlf = buf->findCRLF(base + std::max(pos_, scanned_));
+        if(crlf == nullptr)
+        {
+            // 下次从末尾字节继续找, 末尾可能是'\r'
+            scanned_ = buf->readableBytes() > 0 ? buf->readableBytes() - 1 : 0;
+            return buf->readableBytes() <= kMaxHeaderBytes;
+        }
+        const char* lineBegin = base + pos_;
+        pos_ = crlf + 2 - base;
+        scanned_ = pos_;
+        if(pos_ > kMaxHeaderBytes)
+        {
+            return false;
+        }
+
+        if(state_ == kExpectRequestLine)
+        {
+            if(!processRequestLine(base, lineBegin, crlf))
+            {
+                return false;
+            }
+            state_ = kExpectHeaders;
+        }
+        else if(lineBegin != crlf)
+        {
+            if(!processHeader(base, lineBegin, crlf))
+            {
+                return false;
+            }
+        }
+        else    // 空行, 首部结束
+        {
+            state_ = contentLength_ > 0 ? kExpectBody : kGotAll;
+        }
+    }
+
+    request_.setReceiveTime(receiveTime);
+    buildRequest(base);
+    return true;
+}
+
+// METHOD SP request-target SP HTTP/1.x
+bool HttpContext::processRequestLine(const char* base, const char* begin, const char* end)
+{
+    const char* space = std::find(begin, end, ' ');
+    if(space == end)
+    {
+        return false;
+    }
+    HttpRequest probe;
+    if(!probe.setMethod(StringPiece(begin, space - begin)))
+    {
+        return false;
+    }
+    method_ = Span{ static_cast<size_t>(begin - base), static_cast<size_t>(space - begin) };
+
+    const char* start = space + 1;
+    space = std::find(start, end, ' ');
+    if(space == end || start == space)
+    {
+        return false;
+    }
+    const char* question = std::find(start, space, '?');
+    path_ = Span{ static_cast<size_t>(start - base), static_cast<size_t>(question - start) };
+    if(question != space)
+    {
+        query_ = Span{ static_cast<size_t>(question + 1 - base), static_cast<size_t>(space - question - 1) };
+    }
+    else
+    {
+        query_ = Span{ 0, 0 };
+    }
+
+    StringPiece version(space + 1, end - space - 1);
+    if(version == "HTTP/1.1")
+    {
+        version_ = HttpRequest::kHttp11;
+    }
+    else if(version == "HTTP/1.0")
+    {
+        version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// field-name ":" OWS field-value OWS
+bool HttpContext::processHeader(const char* base, const char* begin, const char* end)
+{
+    const char* colon = std::find(begin, end, ':');
+    if(colon == end || colon == begin)
+    {
+        return false;
+    }
+    const char* value = colon + 1;
+    while(value < end && (*value == ' ' || *value == '\t'))
+    {
+        ++value;
+    }
+    const char* valueEnd = end;
+    while(valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+
+    StringPiece field(begin, colon - begin);
+    if(field.size() == 14 && ::strncasecmp(begin, "Content-Length", 14) == 0)
+    {
+        if(value == valueEnd)
+        {
+            return false;
+        }
+        size_t len = 0;
+        for(const char* p = value; p < valueEnd; ++p)
+        {
+            if(*p < '0' || *p > '9')
+            {
+                return false;
+            }
+            len = len * 10 + (*p - '0');
+            if(len > kMaxBodyBytes)
+            {
+                return false;
+            }
+        }
+        if(hasContentLength_ && len != contentLength_)
+        {
+            return false;   // 多个不一致的Content-Length, 经代理转发时会被解析成不同的请求边界 (RFC 9112 6.3)
+        }
+        contentLength_ = len;
+        hasContentLength_ = true;
+    }
+    else if(field.size() == 17 && ::strncasecmp(begin, "Transfer-Encoding", 17) == 0)
+    {
+        return false;   // 不支持分块编码的请求体
+    }
+
+    headers_.push_back(std::make_pair(
+        Span{ static_cast<size_t>(begin - base), field.size() },
+        Span{ static_cast<size_t>(value - base), static_cast<size_t>(valueEnd - value) }));
+    return true;
+}
+
+void HttpContext::buildRequest(const char* base)
+{
+    request_.setMethod(StringPiece(base + method_.offset, method_.len));
+    request_.setVersion(version_);
+    request_.setPath(StringPiece(base + path_.offset, path_.len));
+    request_.setQuery(StringPiece(base + query_.offset, query_.len));
+    for(const auto& h : headers_)
+    {
+        request_.addHeader(StringPiece(base + h.first.offset, h.first.len),
+                           StringPiece(base + h.second.offset, h.second.len));
+    }
+    request_.setBody(StringPiece(base + pos_ - contentLength_, contentLength_));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Buffer.h"
+#include "HttpRequest.h"
+#include "Timestamp.h"
+
+#include <vector>
+
+/**
+ * @brief 增量HTTP请求解析器, 每个连接一个
+ * 解析过程中不取走Buffer的数据, 只记录相对peek()的偏移, 所以两次读之间Buffer扩容也不影响;
+ * 请求收全后才生成指向Buffer的HttpRequest, 处理完由调用方retrieve(requestLength())再reset()
+ */
+class HttpContext
+{
+public:
+    enum HttpRequestParseState
+    {
+        kExpectRequestLine,
+        kExpectHeaders,
+        kExpectBody,
+        kGotAll,
+    };
+
+    static const size_t kMaxHeaderBytes = 64 * 1024;        // 请求行加首部的上限
+    static const size_t kMaxBodyBytes = 16 * 1024 * 1024;
+
+    HttpContext();
+
+    /// 解析buf中尚未解析的部分, 请求格式错误返回false
+    bool parseRequest(Buffer* buf, Timestamp receiveTime);
+
+    bool gotAll() const { return state_ == kGotAll; }
+    /// 当前请求在buf中占用的字节数, gotAll()后有效
+    size_t requestLength() const { return pos_; }
+
+    void reset();
+
+    const HttpRequest& request() const { return request_; }
+
+private:
+    // 相对peek()的区间
+    struct Span
+    {
+        size_t offset;
+        size_t len;
+    };
+    bool processRequestLine(const char* base, const char* begin, const char* end);
+    bool processHeader(const char* base, const char* begin, const char* end);
+    void buildRequest(const char* base);
+
+    HttpRequestParseState state_;
+    size_t pos_;            // 下一行的起始偏移
+    size_t scanned_;        // 上次找CRLF停下的偏移
+    size_t contentLength_;
+    bool hasContentLength_;
+    Span method_;
+    Span path_;
+    Span query_;
+    HttpRequest::Version version_;
+    std::vector<std::pair<Span, Span>> headers_;
+    HttpRequest request_;
+};
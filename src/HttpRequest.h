@@ -0,0 +1,125 @@
+#pragma once
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <strings.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 一个完整的HTTP请求, 各字段都指向连接的inputBuffer
+ * 只在HttpServer回调期间有效, 回调返回后请求数据即被取走, 需要保留的字段自行拷贝
+ */
+class HttpRequest
+{
+public:
+    enum Method
+    {
+        kInvalid,
+        kGet,
+        kPost,
+        kHead,
+        kPut,
+        kDelete,
+    };
+    enum Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+    using Header = std::pair<StringPiece, StringPiece>;
+
+    HttpRequest() : method_(kInvalid), version_(kUnknown) {}
+
+    bool setMethod(StringPiece m)
+    {
+        if(m == "GET")
+        {
+            method_ = kGet;
+        }
+        else if(m == "POST")
+        {
+            method_ = kPost;
+        }
+        else if(m == "HEAD")
+        {
+            method_ = kHead;
+        }
+        else if(m == "PUT")
+        {
+            method_ = kPut;
+        }
+        else if(m == "DELETE")
+        {
+            method_ = kDelete;
+        }
+        else
+        {
+            method_ = kInvalid;
+        }
+        return method_ != kInvalid;
+    }
+    Method method() const { return method_; }
+    const char* methodString() const
+    {
+        switch(method_)
+        {
+        case kGet: return "GET";
+        case kPost: return "POST";
+        case kHead: return "HEAD";
+        case kPut: return "PUT";
+        case kDelete: return "DELETE";
+        default: return "UNKNOWN";
+        }
+    }
+
+    void setVersion(Version v) { version_ = v; }
+    Version version() const { return version_; }
+
+    void setPath(StringPiece path) { path_ = path; }
+    StringPiece path() const { return path_; }
+    void setQuery(StringPiece query) { query_ = query; }
+    StringPiece query() const { return query_; }
+    void setBody(StringPiece body) { body_ = body; }
+    StringPiece body() const { return body_; }
+
+    void setReceiveTime(Timestamp t) { receiveTime_ = t; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    void addHeader(StringPiece field, StringPiece value) { headers_.push_back(Header(field, value)); }
+    /// 字段名不区分大小写, 没有该字段返回空
+    StringPiece getHeader(StringPiece field) const
+    {
+        for(const Header& h : headers_)
+        {
+            if(h.first.size() == field.size()
+                && ::strncasecmp(h.first.data(), field.data(), field.size()) == 0)
+            {
+                return h.second;
+            }
+        }
+        return StringPiece();
+    }
+    const std::vector<Header>& headers() const { return headers_; }
+
+    void reset()
+    {
+        method_ = kInvalid;
+        version_ = kUnknown;
+        path_ = StringPiece();
+        query_ = StringPiece();
+        body_ = StringPiece();
+        headers_.clear();   // 保留容量, 同一连接上的下一个请求不再分配
+    }
+
+private:
+    Method method_;
+    Version version_;
+    StringPiece path_;
+    StringPiece query_;
+    StringPiece body_;
+    Timestamp receiveTime_;
+    std::vector<Header> headers_;
+};
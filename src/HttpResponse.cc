@@ -0,0 +1,70 @@
+#include "HttpResponse.h"
+#include "HttpServer.h"
+
+#include <stdio.h>
+
+std::shared_ptr<HttpChunkedWriter> HttpResponse::beginChunked()
+{
+    if(!writer_)
+    {
+        chunked_ = true;
+        if(!http11_)
+        {
+            closeConnection_ = true;    // HTTP/1.0没有分块编码, 以关闭连接表示结束
+        }
+        writer_ = server_->createChunkedWriter(*conn_, http11_, headOnly_);
+    }
+    return writer_;
+}
+
+void HttpResponse::appendToBuffer(Buffer* output, StringPiece dateHeader, bool headOnly) const
+{
+    char buf[64];
+    int n = ::snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    output->append(statusMessage_.data(), statusMessage_.size());
+    output->append("\r\n", 2);
+    output->append(dateHeader.data(), dateHeader.size());
+
+    if(closeConnection_)
+    {
+        output->append("Connection: close\r\n", 19);
+    }
+    if(chunked_)
+    {
+        if(http11_)
+        {
+            output->append("Transfer-Encoding: chunked\r\n", 28);
+        }
+    }
+    else
+    {
+        n = ::snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, n);
+    }
+
+    for(const auto& header : headers_)
+    {
+        output->append(header.first.data(), header.first.size());
+        output->append(": ", 2);
+        output->append(header.second.data(), header.second.size());
+        output->append("\r\n", 2);
+    }
+    output->append("\r\n", 2);
+
+    if(headOnly || body_.empty())
+    {
+        return;
+    }
+    if(chunked_ && http11_)
+    {
+        n = ::snprintf(buf, sizeof buf, "%zx\r\n", body_.size());
+        output->append(buf, n);
+        output->append(body_.data(), body_.size());
+        output->append("\r\n", 2);
+    }
+    else
+    {
+        output->append(body_.data(), body_.size());
+    }
+}
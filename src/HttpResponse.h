@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "StringPiece.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class HttpServer;
+class HttpChunkedWriter;
+
+/**
+ * @brief HTTP响应, 在HttpServer回调中填写
+ * 默认带Content-Length一次发完; 调用beginChunked()后改为chunked编码流式发送
+ */
+class HttpResponse
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k500InternalServerError = 500,
+    };
+
+    explicit HttpResponse(bool close)
+        : statusCode_(kUnknown)
+        , closeConnection_(close)
+        , chunked_(false)
+        , server_(nullptr)
+        , conn_(nullptr)
+        , http11_(true)
+        , headOnly_(false)
+    {}
+
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    void setStatusMessage(const std::string& message) { statusMessage_ = message; }
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+    void setContentType(const std::string& contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string& key, const std::string& value) { headers_.push_back(std::make_pair(key, value)); }
+    void setBody(const std::string& body) { body_ = body; }
+
+    /// 改为流式发送: 回调返回后先发出状态行和首部(setBody的内容作为第一块),
+    /// 之后通过返回的writer逐块发送, finish()或writer析构时结束.
+    /// 同一连接上后续流水线请求的响应排在本响应结束之后. HTTP/1.0请求不做分块编码, 结束后关闭连接
+    std::shared_ptr<HttpChunkedWriter> beginChunked();
+    bool chunked() const { return chunked_; }
+
+    /// dateHeader为完整的"Date: ...\r\n"行, headOnly时不输出响应体
+    void appendToBuffer(Buffer* output, StringPiece dateHeader, bool headOnly) const;
+
+private:
+    friend class HttpServer;
+
+    HttpStatusCode statusCode_;
+    std::string statusMessage_;
+    bool closeConnection_;
+    bool chunked_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    std::string body_;
+
+    // 由HttpServer在调用回调前设置, 用于创建writer
+    HttpServer* server_;
+    const TcpConnectionPtr* conn_;
+    bool http11_;
+    bool headOnly_;     // HEAD请求, writer丢弃响应体
+    std::shared_ptr<HttpChunkedWriter> writer_;
+};
@@ -0,0 +1,274 @@
+#include "HttpServer.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <strings.h>
+#include <time.h>
+
+struct HttpChunkedWriter::Slot
+{
+    Buffer data;
+    bool done = false;
+};
+
+namespace
+{
+
+// 每个loop线程一份, 由该线程的定时器每秒刷新, 不需要加锁
+struct DateCache
+{
+    char header[64];
+    size_t len;
+};
+thread_local DateCache t_dateCache = { {0}, 0 };
+
+void refreshDate()
+{
+    time_t now = ::time(nullptr);
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    t_dateCache.len = ::strftime(t_dateCache.header, sizeof t_dateCache.header,
+                                 "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+}
+
+bool equalsIgnoreCase(StringPiece s, const char* literal)
+{
+    size_t len = ::strlen(literal);
+    return s.size() == len && ::strncasecmp(s.data(), literal, len) == 0;
+}
+
+void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+}
+
+const char kBadRequest[] = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+
+}
+
+HttpChunkedWriter::HttpChunkedWriter(const TcpConnectionPtr& conn, const std::shared_ptr<Slot>& slot,
+                                     bool encode, bool discard)
+    : conn_(conn)
+    , slot_(slot)
+    , encode_(encode)
+    , discard_(discard)
+    , finished_(false)
+{
+}
+
+HttpChunkedWriter::~HttpChunkedWriter()
+{
+    finish();
+}
+
+void HttpChunkedWriter::write(StringPiece data)
+{
+    if(data.empty() || discard_ || finished_)
+    {
+        return;     // 空块会被对端当作结束标志
+    }
+    if(!encode_)
+    {
+        post(data.asString(), false);
+        return;
+    }
+    char header[32];
+    int n = ::snprintf(header, sizeof header, "%zx\r\n", data.size());
+    std::string chunk;
+    chunk.reserve(n + data.size() + 2);
+    chunk.append(header, n);
+    chunk.append(data.data(), data.size());
+    chunk.append("\r\n", 2);
+    post(chunk, false);
+}
+
+void HttpChunkedWriter::finish()
+{
+    if(finished_.exchange(true))
+    {
+        return;
+    }
+    post(encode_ && !discard_ ? std::string("0\r\n\r\n") : std::string(), true);
+}
+
+// 总是排队执行: 在回调中调用时首部还没放进发送队列
+void HttpChunkedWriter::post(const std::string& data, bool last)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if(conn)
+    {
+        conn->getLoop()->queueInLoop(std::bind(&HttpChunkedWriter::deliver, conn_, slot_, data, last));
+    }
+}
+
+void HttpChunkedWriter::deliver(const std::weak_ptr<TcpConnection>& weakConn, const std::shared_ptr<Slot>& slot,
+                                const std::string& data, bool last)
+{
+    TcpConnectionPtr conn = weakConn.lock();
+    if(!conn || !conn->connected())
+    {
+        return;
+    }
+    if(!conn->getLoop()->isInLoopThread())     // 连接已迁移到其他loop
+    {
+        conn->getLoop()->queueInLoop(std::bind(&HttpChunkedWriter::deliver, weakConn, slot, data, last));
+        return;
+    }
+    slot->data.append(data.data(), data.size());
+    slot->done = last;
+    HttpServer::flush(conn, static_cast<HttpServer::ConnectionState*>(conn->getContext().get()));
+}
+
+HttpServer::HttpServer(EventLoop* loop,
+                       const InetAddress& listenAddr,
+                       const std::string& name,
+                       TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server_.setThreadInitCallback(
+        std::bind(&HttpServer::initLoop, this, std::placeholders::_1));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening on %s", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void HttpServer::initLoop(EventLoop* loop)
+{
+    refreshDate();
+    loop->runEvery(1.0, refreshDate);
+    if(threadInitCallback_)
+    {
+        threadInitCallback_(loop);
+    }
+}
+
+StringPiece HttpServer::dateHeader()
+{
+    if(t_dateCache.len == 0)
+    {
+        refreshDate();
+    }
+    return StringPiece(t_dateCache.header, t_dateCache.len);
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setContext(std::make_shared<ConnectionState>());
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    ConnectionState* state = static_cast<ConnectionState*>(conn->getContext().get());
+    HttpContext& context = state->context;
+    // 一次读到的多个流水线请求依次处理, 响应攒在一起最后发送
+    while(!state->closing)
+    {
+        if(!context.parseRequest(buf, receiveTime))
+        {
+            Buffer* out = &state->output;
+            if(!state->queue.empty())
+            {
+                state->queue.push_back(std::make_shared<HttpChunkedWriter::Slot>());
+                state->queue.back()->done = true;
+                out = &state->queue.back()->data;
+            }
+            out->append(kBadRequest, sizeof kBadRequest - 1);
+            state->closing = true;
+            break;
+        }
+        if(!context.gotAll())
+        {
+            break;
+        }
+        onRequest(conn, state, context.request());
+        buf->retrieve(context.requestLength());
+        context.reset();
+    }
+    if(state->closing)
+    {
+        buf->retrieveAll();     // 关闭前不再处理后续请求
+    }
+    flush(conn, state);
+}
+
+void HttpServer::onRequest(const TcpConnectionPtr& conn, ConnectionState* state, const HttpRequest& req)
+{
+    StringPiece connection = req.getHeader("Connection");
+    bool http11 = req.version() == HttpRequest::kHttp11;
+    bool close = equalsIgnoreCase(connection, "close")
+        || (!http11 && !equalsIgnoreCase(connection, "Keep-Alive"));
+    HttpResponse response(close);
+    response.server_ = this;
+    response.conn_ = &conn;
+    response.http11_ = http11;
+    response.headOnly_ = req.method() == HttpRequest::kHead;
+    httpCallback_(req, &response);
+    if(!http11 && !response.closeConnection())
+    {
+        response.addHeader("Connection", "Keep-Alive");
+    }
+
+    // 前面还有未结束的流式响应, 或者本身是流式响应时, 进入发送队列排队
+    Buffer* out = &state->output;
+    if(response.writer_ || !state->queue.empty())
+    {
+        std::shared_ptr<HttpChunkedWriter::Slot> slot = response.writer_
+            ? response.writer_->slot_
+            : std::make_shared<HttpChunkedWriter::Slot>();
+        slot->done = !response.writer_;
+        state->queue.push_back(slot);
+        out = &slot->data;
+    }
+    response.appendToBuffer(out, dateHeader(), response.headOnly_);
+    if(response.closeConnection())
+    {
+        state->closing = true;
+    }
+}
+
+std::shared_ptr<HttpChunkedWriter> HttpServer::createChunkedWriter(const TcpConnectionPtr& conn,
+                                                                   bool http11, bool headOnly)
+{
+    return std::make_shared<HttpChunkedWriter>(
+        conn, std::make_shared<HttpChunkedWriter::Slot>(), http11, headOnly);
+}
+
+void HttpServer::flush(const TcpConnectionPtr& conn, ConnectionState* state)
+{
+    if(state->output.readableBytes() > 0)
+    {
+        conn->send(&state->output);
+    }
+    while(!state->queue.empty())
+    {
+        HttpChunkedWriter::Slot& slot = *state->queue.front();
+        if(slot.data.readableBytes() > 0)
+        {
+            conn->send(&slot.data);
+        }
+        if(!slot.done)
+        {
+            break;
+        }
+        state->queue.pop_front();
+    }
+    if(state->closing && state->queue.empty())
+    {
+        conn->shutdown();
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Buffer.h"
+#include "HttpContext.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "noncopyable.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+/**
+ * @brief chunked响应的发送端, 由HttpResponse::beginChunked()创建
+ * write/finish线程安全, 数据按调用顺序发出; 析构时若未finish则自动结束
+ */
+class HttpChunkedWriter : noncopyable
+{
+public:
+    struct Slot;    // 连接上排队等待发送的一个响应
+
+    HttpChunkedWriter(const TcpConnectionPtr& conn, const std::shared_ptr<Slot>& slot,
+                      bool encode, bool discard);
+    ~HttpChunkedWriter();
+
+    void write(StringPiece data);
+    void finish();
+
+private:
+    friend class HttpServer;
+    void post(const std::string& data, bool last);
+    static void deliver(const std::weak_ptr<TcpConnection>& weakConn, const std::shared_ptr<Slot>& slot,
+                        const std::string& data, bool last);
+
+    std::weak_ptr<TcpConnection> conn_;
+    std::shared_ptr<Slot> slot_;
+    const bool encode_;     // HTTP/1.1用分块编码, HTTP/1.0原样发送
+    const bool discard_;    // HEAD请求不发送响应体
+    std::atomic_bool finished_;
+};
+
+/**
+ * @brief 基于TcpServer的HTTP/1.1服务器
+ * 同一次读到的多个流水线请求依次处理, 响应按请求顺序合并发送; 支持keep-alive和chunked响应.
+ * Date首部由每个loop每秒渲染一次
+ */
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest&, HttpResponse*)>;
+
+    HttpServer(EventLoop* loop,
+               const InetAddress& listenAddr,
+               const std::string& name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+
+    EventLoop* getLoop() const { return loop_; }
+    /// 底层TcpServer, 用于设置分发策略等. Call before start().
+    TcpServer& tcpServer() { return server_; }
+
+    /// Not thread safe, callback be registered before calling start().
+    void setHttpCallback(const HttpCallback& cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    /// 在HttpServer自己的loop初始化之后调用
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+
+    void start();
+
+    /// 当前loop线程缓存的"Date: ...\r\n"
+    static StringPiece dateHeader();
+
+private:
+    friend class HttpResponse;
+    friend class HttpChunkedWriter;
+
+    // 每个连接的状态, 挂在TcpConnection的context上, 只在连接所属loop中访问
+    struct ConnectionState
+    {
+        HttpContext context;
+        Buffer output;      // 本次onMessage中可以直接发送的响应
+        std::deque<std::shared_ptr<HttpChunkedWriter::Slot>> queue;   // 排在流式响应后面的响应
+        bool closing = false;
+    };
+
+    void onConnection(const TcpConnectionPtr& conn);
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void onRequest(const TcpConnectionPtr& conn, ConnectionState* state, const HttpRequest& req);
+    void initLoop(EventLoop* loop);
+
+    std::shared_ptr<HttpChunkedWriter> createChunkedWriter(const TcpConnectionPtr& conn,
+                                                           bool http11, bool headOnly);
+    /// 按顺序发送已就绪的响应, 遇到未结束的流式响应停下
+    static void flush(const TcpConnectionPtr& conn, ConnectionState* state);
+
+    EventLoop* loop_;
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    TcpServer::ThreadInitCallback threadInitCallback_;
+};
@@ -1,32 +1,123 @@
 #include "InetAddress.h"
+#include "Logger.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
 
 // Constructor for the InetAddress class
 InetAddress::InetAddress(uint16_t port, std::string ip)
+    : len_(sizeof(sockaddr_in))
 {
     // Initialize the address structure to zero
     bzero(&addr_, sizeof(addr_));    
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = htons(port);
-    addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    addr_.in.sin_family = AF_INET;
+    addr_.in.sin_port = htons(port);
+    addr_.in.sin_addr.s_addr = inet_addr(ip.c_str());
+}
+
+InetAddress::InetAddress(const sockaddr* addr, socklen_t len)
+{
+    bzero(&addr_, sizeof(addr_));
+    len_ = std::min<socklen_t>(len, sizeof(addr_));
+    memcpy(&addr_, addr, len_);
+}
+
+InetAddress InetAddress::unixDomain(const std::string& path)
+{
+    InetAddress addr;
+    bzero(&addr.addr_, sizeof(addr.addr_));
+    sockaddr_un& un = addr.addr_.un;
+    bool abstract = !path.empty() && path[0] == '@';
+    // 文件系统路径要留出结尾的'\0'; abstract namespace的'@'占sun_path[0]
+    size_t maxLen = abstract ? sizeof(un.sun_path) : sizeof(un.sun_path) - 1;
+    if(path.size() > maxLen)
+    {
+        // 截断后会指向另一个socket，返回无效地址，bind/connect会失败
+        LOG_ERROR("InetAddress::unixDomain path too long (%zu > %zu): %s", path.size(), maxLen, path.c_str());
+        un.sun_family = AF_UNSPEC;
+        addr.len_ = 0;
+        return addr;
+    }
+    un.sun_family = AF_UNIX;
+    size_t n = path.size();
+    memcpy(un.sun_path, path.data(), n);
+    if(abstract)
+    {
+        // abstract namespace: sun_path[0]为'\0', 名字不以'\0'结尾, 长度必须精确
+        un.sun_path[0] = '\0';
+        addr.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n);
+    }
+    else
+    {
+        addr.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n + 1);
+    }
+    return addr;
 }
+
+InetAddress InetAddress::localAddressOf(int sockfd)
+{
+    sockaddr_storage ss;
+    socklen_t len = sizeof ss;
+    bzero(&ss, sizeof ss);
+    if(::getsockname(sockfd, reinterpret_cast<sockaddr*>(&ss), &len) < 0)
+    {
+        return InetAddress();
+    }
+    return InetAddress(reinterpret_cast<sockaddr*>(&ss), len);
+}
+
+InetAddress InetAddress::peerAddressOf(int sockfd)
+{
+    sockaddr_storage ss;
+    socklen_t len = sizeof ss;
+    bzero(&ss, sizeof ss);
+    if(::getpeername(sockfd, reinterpret_cast<sockaddr*>(&ss), &len) < 0)
+    {
+        return InetAddress();
+    }
+    return InetAddress(reinterpret_cast<sockaddr*>(&ss), len);
+}
+
 std::string InetAddress::toIp() const
 {
+    if(isUnix())
+    {
+        // 未绑定的一端(如客户端)长度只含sun_family, 路径为空
+        size_t offset = offsetof(sockaddr_un, sun_path);
+        if(len_ <= offset)
+        {
+            return std::string();
+        }
+        // 内核返回的路径占满sun_path时不带结尾的'\0', 只能按len_取长度
+        size_t pathLen = std::min(static_cast<size_t>(len_) - offset, sizeof(addr_.un.sun_path));
+        if(addr_.un.sun_path[0] == '\0')
+        {
+            return "@" + std::string(addr_.un.sun_path + 1, pathLen - 1);
+        }
+        return std::string(addr_.un.sun_path, ::strnlen(addr_.un.sun_path, pathLen));
+    }
     char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+    ::inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof(buf));
     return buf;
 }
 std::string InetAddress::toIpPort() const
 {
+    if(isUnix())
+    {
+        return "unix:" + toIp();
+    }
     char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+    ::inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof(buf));
     size_t end = strlen(buf);
     // bigend
-    uint16_t port = ntohs(addr_.sin_port);
+    uint16_t port = ntohs(addr_.in.sin_port);
     // ip : port
     sprintf(buf + end, ":%u", port);
     return buf;
 }
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
-}
\ No newline at end of file
+    return isUnix() ? 0 : ntohs(addr_.in.sin_port);
+}
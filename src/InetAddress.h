@@ -2,25 +2,51 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "const.h"
 
+/**
+ * @brief socket地址, IPv4(AF_INET)或Unix域(AF_UNIX)
+ * Unix域地址用unixDomain()构造, 名字以'@'开头时为abstract namespace, 不在文件系统中创建文件
+ */
 class InetAddress
 {
 public:
     // Constructor that initializes the InetAddress with a port and an optional IP address.
     explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
     // Constructor that initializes the InetAddress with an existing sockaddr_in structure.
-    explicit InetAddress(const sockaddr_in& addr) : addr_(addr){}
-    // Returns the IP address as a string.
+    explicit InetAddress(const sockaddr_in& addr) : len_(sizeof addr) { addr_.in = addr; }
+    // 从accept/getsockname等返回的任意族地址构造, len为内核填写的长度
+    InetAddress(const sockaddr* addr, socklen_t len);
+
+    /// Unix域流式socket地址, "@name"为abstract namespace, 其余为文件系统路径
+    /// 路径超过sun_path容量时不截断, LOG_ERROR并返回family()为AF_UNSPEC的无效地址
+    static InetAddress unixDomain(const std::string& path);
+    /// 已连接或已绑定的socket的本端/对端地址
+    static InetAddress localAddressOf(int sockfd);
+    static InetAddress peerAddressOf(int sockfd);
+
+    sa_family_t family() const { return addr_.in.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    // Returns the IP address as a string. Unix域返回路径, abstract namespace以'@'开头
     std::string toIp() const;
-    // Returns the IP address and port as a string in the format "IP:PORT".
+    // Returns the IP address and port as a string in the format "IP:PORT", Unix域为"unix:PATH".
     std::string toIpPort() const;
-    // Returns the port number as an unsigned 16-bit integer.
+    // Returns the port number as an unsigned 16-bit integer. Unix域为0
     uint16_t toPort() const;
-    // Returns a pointer to the internal sockaddr_in structure.
-    const sockaddr_in* getSockAddr() const {return &addr_;}
-    void setSockAddr(const sockaddr_in& addr) {addr_ = addr;}
+    // Returns a pointer to the internal address, 与getSockLen()一起传给bind/connect
+    const sockaddr* getSockAddr() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t getSockLen() const { return len_; }
+    // IPv4地址, 只在family()为AF_INET时有意义
+    const sockaddr_in* getSockAddrInet() const { return &addr_.in; }
+    void setSockAddr(const sockaddr_in& addr) { addr_.in = addr; len_ = sizeof addr; }
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    union
+    {
+        sockaddr_in in;
+        sockaddr_un un;
+    } addr_;
+    socklen_t len_;
+};
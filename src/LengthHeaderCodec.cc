@@ -0,0 +1,141 @@
+#include "LengthHeaderCodec.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+
+LengthHeaderCodec::LengthHeaderCodec(HeaderType type, const FrameCallback& cb, size_t maxMessageLen)
+    : type_(type)
+    , frameCallback_(cb)
+    , maxMessageLen_(type == kHeader16 && maxMessageLen > 0xFFFF ? 0xFFFF : maxMessageLen)
+{
+}
+
+int LengthHeaderCodec::parseHeader(const char* data, size_t len, size_t* messageLen) const
+{
+    switch(type_)
+    {
+    case kHeader16:
+    {
+        if(len < sizeof(uint16_t))
+        {
+            return 0;
+        }
+        uint16_t be16;
+        ::memcpy(&be16, data, sizeof be16);
+        *messageLen = ntohs(be16);
+        return sizeof(uint16_t);
+    }
+    case kHeader32:
+    {
+        if(len < sizeof(uint32_t))
+        {
+            return 0;
+        }
+        uint32_t be32;
+        ::memcpy(&be32, data, sizeof be32);
+        *messageLen = ntohl(be32);
+        return sizeof(uint32_t);
+    }
+    case kVarint:
+    {
+        uint64_t value = 0;
+        for(size_t i = 0; i < kMaxVarintLen; ++i)
+        {
+            if(i == len)
+            {
+                return 0;
+            }
+            uint8_t byte = static_cast<uint8_t>(data[i]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+            if((byte & 0x80) == 0)
+            {
+                *messageLen = static_cast<size_t>(value);
+                return static_cast<int>(i + 1);
+            }
+        }
+        return -1;      // 超过kMaxVarintLen
+    }
+    }
+    return -1;
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    while(buf->readableBytes() > 0)
+    {
+        size_t messageLen = 0;
+        int headerLen = parseHeader(buf->peek(), buf->readableBytes(), &messageLen);
+        if(headerLen == 0)
+        {
+            break;      // 长度头还没收全
+        }
+        if(headerLen < 0 || messageLen > maxMessageLen_)
+        {
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid length header, messageLen = %zu",
+                    conn->name().c_str(), messageLen);
+            conn->shutdown();
+            break;
+        }
+        if(buf->readableBytes() < headerLen + messageLen)
+        {
+            break;      // 消息体还没收全
+        }
+        frameCallback_(conn, StringPiece(buf->peek() + headerLen, messageLen), receiveTime);
+        buf->retrieve(headerLen + messageLen);
+    }
+    if(batchEndCallback_)
+    {
+        batchEndCallback_(conn);
+    }
+}
+
+void LengthHeaderCodec::encode(Buffer* buf) const
+{
+    size_t len = buf->readableBytes();
+    switch(type_)
+    {
+    case kHeader16:
+    {
+        assert(len <= 0xFFFF);
+        uint16_t be16 = htons(static_cast<uint16_t>(len));
+        buf->prepend(&be16, sizeof be16);
+        break;
+    }
+    case kHeader32:
+    {
+        uint32_t be32 = htonl(static_cast<uint32_t>(len));
+        buf->prepend(&be32, sizeof be32);
+        break;
+    }
+    case kVarint:
+    {
+        char header[kMaxVarintLen];
+        size_t n = 0;
+        uint64_t value = len;
+        do
+        {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            header[n++] = static_cast<char>(value ? (byte | 0x80) : byte);
+        } while(value && n < kMaxVarintLen);
+        assert(value == 0);
+        buf->prepend(header, n);
+        break;
+    }
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, Buffer* buf) const
+{
+    encode(buf);
+    conn->send(buf);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, StringPiece message) const
+{
+    Buffer buf(message.size());
+    buf.append(message.data(), message.size());
+    send(conn, &buf);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "noncopyable.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <functional>
+
+/**
+ * @brief 长度前缀分帧: | header(消息长度) | payload |
+ * 长度头可以是2字节、4字节(网络字节序)或varint(小端7位一组，最长8字节)
+ * 发送时长度头写进Buffer的预分配空间，不搬动payload
+ * 接收时回调拿到指向inputBuffer的StringPiece，回调返回后数据即被取走
+ *
+ * LengthHeaderCodec codec(LengthHeaderCodec::kVarint, onFrame);
+ * server.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec, _1, _2, _3));
+ */
+class LengthHeaderCodec : noncopyable
+{
+public:
+    enum HeaderType
+    {
+        kHeader16,
+        kHeader32,
+        kVarint,
+    };
+    /// message只在回调期间有效，需要保留时自行拷贝
+    using FrameCallback = std::function<void(const TcpConnectionPtr&, StringPiece message, Timestamp)>;
+    /// 一次onMessage中的帧都处理完后调用, 用于批量发送响应
+    using BatchEndCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    static const size_t kMaxVarintLen = 8;      // 不超过KCheapPrend, 可表示2^56-1
+
+    LengthHeaderCodec(HeaderType type, const FrameCallback& cb, size_t maxMessageLen = 64 * 1024 * 1024);
+
+    void setBatchEndCallback(const BatchEndCallback& cb) { batchEndCallback_ = cb; }
+
+    /// 作为TcpConnection的MessageCallback, 解出buf中所有完整的帧
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    /// 在buf的可读数据前加上长度头，payload不拷贝
+    void encode(Buffer* buf) const;
+    /// 编码buf后整体发送并清空buf
+    void send(const TcpConnectionPtr& conn, Buffer* buf) const;
+    void send(const TcpConnectionPtr& conn, StringPiece message) const;
+
+    HeaderType headerType() const { return type_; }
+    size_t maxMessageLen() const { return maxMessageLen_; }
+
+private:
+    /// 解析长度头，返回头长度，数据不足返回0，格式错误返回-1
+    int parseHeader(const char* data, size_t len, size_t* messageLen) const;
+
+    const HeaderType type_;
+    FrameCallback frameCallback_;
+    BatchEndCallback batchEndCallback_;
+    const size_t maxMessageLen_;
+};
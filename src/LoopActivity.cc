@@ -0,0 +1,27 @@
+#include "LoopActivity.h"
+
+const char* LoopActivity::phaseName(Phase phase)
+{
+    switch(phase)
+    {
+    case kPolling: return "polling";
+    case kReadCallback: return "read callback";
+    case kWriteCallback: return "write callback";
+    case kCloseCallback: return "close callback";
+    case kErrorCallback: return "error callback";
+    case kTimer: return "timer";
+    case kPendingFunctor: return "pending functor";
+    case kLoopChannel: return "loop channel";
+    case kStealableTask: return "stealable task";
+    }
+    return "unknown";
+}
+
+LoopActivity::LoopActivity()
+    : busySince_(0)
+    , iteration_(0)
+    , phase_(kPolling)
+    , fd_(-1)
+    , callback_(nullptr)
+{
+}
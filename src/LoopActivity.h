@@ -0,0 +1,67 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <typeinfo>
+
+/**
+ * @brief
+ * EventLoop此刻在做什么: 本轮从poll返回的时间、正在处理的fd、回调种类和回调对象的类型
+ * 只由loop线程用relaxed store发布，LoopWatchdog的监视线程读取; 每个事件只多几次store，不读时钟
+ */
+class LoopActivity : noncopyable
+{
+public:
+    enum Phase
+    {
+        kPolling,           // 阻塞在poll中
+        kReadCallback,
+        kWriteCallback,
+        kCloseCallback,
+        kErrorCallback,
+        kTimer,             // 定时器回调
+        kPendingFunctor,    // queueInLoop投递的任务
+        kLoopChannel,       // LoopChannel的消息
+        kStealableTask,     // 可窃取任务
+    };
+    static const char* phaseName(Phase phase);
+
+    LoopActivity();
+
+    // 以下只在loop线程中调用
+    void beginIteration(int64_t nowNanos)
+    {
+        iteration_.store(iteration_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        busySince_.store(nowNanos, std::memory_order_relaxed);
+    }
+    void endIteration()
+    {
+        busySince_.store(0, std::memory_order_relaxed);
+        phase_.store(kPolling, std::memory_order_relaxed);
+        fd_.store(-1, std::memory_order_relaxed);
+    }
+    void setChannel(int fd) { fd_.store(fd, std::memory_order_relaxed); }
+    void setPhase(Phase phase) { setCallback(phase, nullptr); }
+    /// type为正在执行的std::function的target_type()
+    void setCallback(Phase phase, const std::type_info* type)
+    {
+        phase_.store(phase, std::memory_order_relaxed);
+        callback_.store(type, std::memory_order_relaxed);
+    }
+
+    // 任意线程可读
+    int64_t busySince() const { return busySince_.load(std::memory_order_relaxed); }   // 0表示在poll中
+    uint64_t iteration() const { return iteration_.load(std::memory_order_relaxed); }
+    Phase phase() const { return static_cast<Phase>(phase_.load(std::memory_order_relaxed)); }
+    int fd() const { return fd_.load(std::memory_order_relaxed); }
+    const std::type_info* callback() const { return callback_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> busySince_;
+    std::atomic<uint64_t> iteration_;
+    std::atomic_int phase_;
+    std::atomic_int fd_;
+    std::atomic<const std::type_info*> callback_;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "EventLoop.h"
+#include "noncopyable.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// EventLoop每轮循环调用的批量消费者
+class LoopChannelBase : noncopyable
+{
+public:
+    virtual ~LoopChannelBase() = default;
+    /// 在消费者loop线程中调用, 处理进入时已写入的全部消息
+    virtual void drain() = 0;
+    /// 还有未处理的消息, 消费者loop在poll之前检查
+    virtual bool readable() const = 0;
+};
+
+/**
+ * @brief 从producer loop到consumer loop的有界单生产者单消费者消息通道.
+ * 与queueInLoop相比不加锁、不为每条消息分配std::function, 消费者每轮循环批量取出处理;
+ * 只有消费者阻塞在poll中时生产者才写eventfd, 消费者忙时连续发送不产生系统调用.
+ * trySend只能在producer loop线程中调用; 必须在consumer loop线程中、loop退出之前析构.
+ * handler中可以析构本通道(之后不能再访问handler自己的捕获), 剩下的消息随之丢弃
+ */
+template <typename T>
+class LoopChannel : public LoopChannelBase
+{
+public:
+    /// 在consumer loop线程中对每条消息调用, 可以把消息move走
+    using Handler = std::function<void(T& message)>;
+
+    /// capacity向上取到2的幂. 可以在任意线程构造, 在consumer loop中注册;
+    /// 注册前就析构时不会注册
+    LoopChannel(EventLoop* producer, EventLoop* consumer, size_t capacity, const Handler& handler)
+        : producer_(producer)
+        , consumer_(consumer)
+        , mask_(roundCapacity(capacity) - 1)
+        , slots_(mask_ + 1)
+        , handler_(handler)
+        , head_(0)
+        , cachedTail_(0)
+        , tail_(0)
+        , wakeups_(0)
+        , token_(std::make_shared<char>(0))
+        , destroyedInDrain_(nullptr)
+    {
+        if(consumer_->isInLoopThread())
+        {
+            consumer_->addLoopChannel(this);
+            return;
+        }
+        // 注册和析构都在consumer loop线程中, token_还在说明this还没有析构
+        std::weak_ptr<char> token(token_);
+        LoopChannel* self = this;
+        consumer_->queueInLoop([token, self]() {
+            if(token.lock())
+            {
+                self->consumer_->addLoopChannel(self);
+            }
+        });
+    }
+
+    ~LoopChannel()
+    {
+        assert(consumer_->isInLoopThread());
+        if(destroyedInDrain_ != nullptr)
+        {
+            *destroyedInDrain_ = true;  // handler中析构, 通知drain不要再访问成员
+        }
+        consumer_->removeLoopChannel(this);
+    }
+
+    /// 通道已满时返回false, 由调用方决定丢弃、稍后重试或改用queueInLoop
+    bool trySend(T&& message)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if(!reserve(head))
+        {
+            return false;
+        }
+        slots_[head & mask_] = std::move(message);
+        publish(head + 1);
+        return true;
+    }
+    bool trySend(const T& message)
+    {
+        T copy(message);
+        return trySend(std::move(copy));
+    }
+
+    EventLoop* producer() const { return producer_; }
+    EventLoop* consumer() const { return consumer_; }
+    size_t capacity() const { return mask_ + 1; }
+    /// 生产者写consumer eventfd的次数. 任意线程可读
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+    void drain() override
+    {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        bool destroyed = false;
+        destroyedInDrain_ = &destroyed;
+        // 只处理进入时已有的消息, 处理期间新写入的留到下一轮, 不饿死其他事件
+        for(; tail != head; ++tail)
+        {
+            T& message = slots_[tail & mask_];
+            handler_(message);
+            if(destroyed)
+            {
+                return;
+            }
+            message = T();      // 及早释放消息持有的资源
+        }
+        destroyedInDrain_ = nullptr;
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    bool readable() const override
+    {
+        return head_.load() != tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static size_t roundCapacity(size_t capacity)
+    {
+        size_t n = 1;
+        while(n < capacity)
+        {
+            n <<= 1;
+        }
+        return n;
+    }
+
+    bool reserve(uint64_t head)
+    {
+        assert(producer_->isInLoopThread());
+        if(head - cachedTail_ > mask_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if(head - cachedTail_ > mask_)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void publish(uint64_t head)
+    {
+        head_.store(head, std::memory_order_release);
+        // 与consumer loop"置polling_后检查readable()"配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(consumer_->wakeupIfPolling())
+        {
+            wakeups_.store(wakeups_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    EventLoop* const producer_;
+    EventLoop* const consumer_;
+    const size_t mask_;
+    std::vector<T> slots_;
+    Handler handler_;
+
+    // 生产者和消费者各自改写的字段分在不同的cache line
+    char pad0_[64];
+    std::atomic<uint64_t> head_;
+    uint64_t cachedTail_;       // 生产者上次看到的tail_, 不够时才重新读取
+    char pad1_[64];
+    std::atomic<uint64_t> tail_;
+    char pad2_[64];
+    std::atomic<uint64_t> wakeups_;
+
+    std::shared_ptr<char> token_;   // 析构前注册任务才执行注册
+    bool* destroyedInDrain_;        // drain期间指向drain的局部变量, 只在consumer loop线程访问
+};
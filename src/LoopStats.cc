@@ -0,0 +1,124 @@
+#include "LoopStats.h"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+
+LoopStatsSnapshot::LoopStatsSnapshot()
+    : polls(0)
+    , pollEvents(0)
+    , wakeups(0)
+    , pollNanos(0)
+    , callbackNanos(0)
+    , functorNanos(0)
+    , functorsRun(0)
+    , pendingFunctors(0)
+    , pendingFunctorsPeak(0)
+    , epollCtls(0)
+    , bytesRead(0)
+    , bytesWritten(0)
+    , channels(0)
+{
+}
+
+double LoopStatsSnapshot::busyRatio() const
+{
+    uint64_t busy = callbackNanos + functorNanos;
+    uint64_t total = busy + pollNanos;
+    return total == 0 ? 0 : static_cast<double>(busy) / total;
+}
+
+LoopStatsSnapshot& LoopStatsSnapshot::operator+=(const LoopStatsSnapshot& rhs)
+{
+    polls += rhs.polls;
+    pollEvents += rhs.pollEvents;
+    wakeups += rhs.wakeups;
+    pollNanos += rhs.pollNanos;
+    callbackNanos += rhs.callbackNanos;
+    functorNanos += rhs.functorNanos;
+    functorsRun += rhs.functorsRun;
+    pendingFunctors += rhs.pendingFunctors;
+    pendingFunctorsPeak = std::max(pendingFunctorsPeak, rhs.pendingFunctorsPeak);
+    epollCtls += rhs.epollCtls;
+    bytesRead += rhs.bytesRead;
+    bytesWritten += rhs.bytesWritten;
+    channels += rhs.channels;
+    return *this;
+}
+
+LoopStatsSnapshot LoopStatsSnapshot::delta(const LoopStatsSnapshot& earlier) const
+{
+    LoopStatsSnapshot d(*this);
+    d.polls -= earlier.polls;
+    d.pollEvents -= earlier.pollEvents;
+    d.wakeups -= earlier.wakeups;
+    d.pollNanos -= earlier.pollNanos;
+    d.callbackNanos -= earlier.callbackNanos;
+    d.functorNanos -= earlier.functorNanos;
+    d.functorsRun -= earlier.functorsRun;
+    d.epollCtls -= earlier.epollCtls;
+    d.bytesRead -= earlier.bytesRead;
+    d.bytesWritten -= earlier.bytesWritten;
+    return d;
+}
+
+LoopStatsSnapshot LoopStatsSnapshot::sum(const std::vector<LoopStatsSnapshot>& snapshots)
+{
+    LoopStatsSnapshot total;
+    for(const LoopStatsSnapshot& s : snapshots)
+    {
+        total += s;
+    }
+    return total;
+}
+
+std::string LoopStatsSnapshot::toString() const
+{
+    char text[512];
+    snprintf(text, sizeof text,
+             "polls=%" PRIu64 " events_per_poll=%.2f wakeups=%" PRIu64
+             " poll_ms=%.1f callback_ms=%.1f functor_ms=%.1f busy=%.3f"
+             " functors_run=%" PRIu64 " pending_functors=%" PRIu64 " pending_functors_peak=%" PRIu64
+             " epoll_ctls=%" PRIu64 " bytes_read=%" PRIu64 " bytes_written=%" PRIu64 " channels=%" PRIu64,
+             polls, eventsPerPoll(), wakeups,
+             pollNanos / 1e6, callbackNanos / 1e6, functorNanos / 1e6, busyRatio(),
+             functorsRun, pendingFunctors, pendingFunctorsPeak,
+             epollCtls, bytesRead, bytesWritten, channels);
+    return text;
+}
+
+LoopStats::LoopStats()
+    : polls_(0)
+    , pollEvents_(0)
+    , wakeups_(0)
+    , pollNanos_(0)
+    , callbackNanos_(0)
+    , functorNanos_(0)
+    , functorsRun_(0)
+    , pendingFunctors_(0)
+    , pendingFunctorsPeak_(0)
+    , epollCtls_(0)
+    , bytesRead_(0)
+    , bytesWritten_(0)
+    , channels_(0)
+{
+}
+
+LoopStatsSnapshot LoopStats::snapshot() const
+{
+    LoopStatsSnapshot s;
+    s.polls = polls_.load(std::memory_order_relaxed);
+    s.pollEvents = pollEvents_.load(std::memory_order_relaxed);
+    s.wakeups = wakeups_.load(std::memory_order_relaxed);
+    s.pollNanos = pollNanos_.load(std::memory_order_relaxed);
+    s.callbackNanos = callbackNanos_.load(std::memory_order_relaxed);
+    s.functorNanos = functorNanos_.load(std::memory_order_relaxed);
+    s.functorsRun = functorsRun_.load(std::memory_order_relaxed);
+    s.pendingFunctors = pendingFunctors_.load(std::memory_order_relaxed);
+    s.pendingFunctorsPeak = pendingFunctorsPeak_.load(std::memory_order_relaxed);
+    s.epollCtls = epollCtls_.load(std::memory_order_relaxed);
+    s.bytesRead = bytesRead_.load(std::memory_order_relaxed);
+    s.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+    s.channels = channels_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+/**
+ * @brief
+ * LoopStats某一时刻的拷贝，普通值类型，可以相加(多个loop汇总)、相减(两次采样之间的增量)
+ * 计数类字段单调递增；channels、pendingFunctors是当时的瞬时值
+ */
+struct LoopStatsSnapshot
+{
+    uint64_t polls;                 // poll返回次数
+    uint64_t pollEvents;            // poll返回的就绪事件总数
+    uint64_t wakeups;               // 被eventfd唤醒的次数
+    uint64_t pollNanos;             // 阻塞在poll中的时间
+    uint64_t callbackNanos;         // 分发Channel事件的时间(读写回调、定时器)
+    uint64_t functorNanos;          // pending functors、LoopChannel、可窃取任务的时间
+    uint64_t functorsRun;           // 执行的pending functor数
+    uint64_t pendingFunctors;       // 当前排队的pending functor数
+    uint64_t pendingFunctorsPeak;   // 排队的pending functor数的历史最大值
+    uint64_t epollCtls;             // epoll_ctl调用次数
+    uint64_t bytesRead;             // TcpConnection从socket读到的字节数
+    uint64_t bytesWritten;          // TcpConnection写入socket的字节数
+    uint64_t channels;              // 当前注册在poller中的Channel数
+
+    LoopStatsSnapshot();
+
+    double eventsPerPoll() const { return polls == 0 ? 0 : static_cast<double>(pollEvents) / polls; }
+    /// 不在poll中的时间占比，接近1说明loop已饱和
+    double busyRatio() const;
+
+    /// 汇总多个loop: 计数和瞬时值相加，peak取最大
+    LoopStatsSnapshot& operator+=(const LoopStatsSnapshot& rhs);
+    /// 相对earlier的增量，用于按采样周期计算速率; 瞬时值保持当前值
+    LoopStatsSnapshot delta(const LoopStatsSnapshot& earlier) const;
+
+    static LoopStatsSnapshot sum(const std::vector<LoopStatsSnapshot>& snapshots);
+
+    /// key=value形式，便于写日志或导出到监控
+    std::string toString() const;
+};
+
+/**
+ * @brief
+ * 一个EventLoop的运行统计，EventLoop持有，任意线程可读
+ * 几乎所有计数都只由loop线程写，单写者用relaxed的load+store更新，不需要原子读改写；
+ * pendingFunctors在queueInLoop的锁内更新，同样只有一个写者
+ * 各字段单独读取，snapshot()不是严格一致的拷贝，用于监控足够
+ */
+class LoopStats : noncopyable
+{
+public:
+    LoopStats();
+
+    static int64_t nowNanos()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // 以下只在loop线程中调用
+    void addPoll(size_t events, int64_t nanos)
+    {
+        add(polls_, 1);
+        add(pollEvents_, events);
+        add(pollNanos_, nanos);
+    }
+    void addWakeup() { add(wakeups_, 1); }
+    void addCallbackNanos(int64_t nanos) { add(callbackNanos_, nanos); }
+    void addFunctorNanos(int64_t nanos) { add(functorNanos_, nanos); }
+    void addFunctorsRun(size_t n) { add(functorsRun_, n); }
+    void addEpollCtl() { add(epollCtls_, 1); }
+    void addBytesRead(size_t n) { add(bytesRead_, n); }
+    void addBytesWritten(size_t n) { add(bytesWritten_, n); }
+    void setChannels(size_t n) { channels_.store(n, std::memory_order_relaxed); }
+
+    /// 持有pendingFunctors_的锁时调用
+    void setPendingFunctors(size_t n)
+    {
+        pendingFunctors_.store(n, std::memory_order_relaxed);
+        if(n > pendingFunctorsPeak_.load(std::memory_order_relaxed))
+        {
+            pendingFunctorsPeak_.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    /// Thread safe.
+    LoopStatsSnapshot snapshot() const;
+
+private:
+    static void add(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> polls_;
+    std::atomic<uint64_t> pollEvents_;
+    std::atomic<uint64_t> wakeups_;
+    std::atomic<uint64_t> pollNanos_;
+    std::atomic<uint64_t> callbackNanos_;
+    std::atomic<uint64_t> functorNanos_;
+    std::atomic<uint64_t> functorsRun_;
+    std::atomic<uint64_t> pendingFunctors_;
+    std::atomic<uint64_t> pendingFunctorsPeak_;
+    std::atomic<uint64_t> epollCtls_;
+    std::atomic<uint64_t> bytesRead_;
+    std::atomic<uint64_t> bytesWritten_;
+    std::atomic<uint64_t> channels_;
+};
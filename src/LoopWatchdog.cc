@@ -0,0 +1,254 @@
+#include "EventLoop.h"
+#include "Logger.h"
+#include "LoopStats.h"
+#include "LoopWatchdog.h"
+
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+const int kMaxFrames = 64;
+const int kSkipFrames = 2;              // 信号处理函数和内核的信号返回桩
+const int kCaptureTimeoutMs = 100;      // loop线程屏蔽了信号等情况下不再等待
+
+// 同一时刻只采集一个线程的调用栈: 监视线程置kRequested后发信号，
+// 目标线程在信号处理函数中kRequested -> kCapturing -> kDone
+enum CaptureState
+{
+    kIdle,
+    kRequested,
+    kCapturing,
+    kDone,
+};
+std::atomic_int g_captureState(kIdle);
+std::atomic_int g_captureTid(0);
+void* g_frames[kMaxFrames];
+int g_numFrames = 0;
+std::mutex g_captureMutex;              // 多个LoopWatchdog串行采集
+
+// 只做异步信号安全的事: backtrace已在start()中预热过，不会再加载libgcc
+void captureStackHandler(int)
+{
+    if(g_captureTid.load() != static_cast<int>(::syscall(SYS_gettid)))
+    {
+        return;     // 超时放弃的请求晚到，或者外部发来的同一信号
+    }
+    int expected = kRequested;
+    if(g_captureState.compare_exchange_strong(expected, kCapturing))
+    {
+        g_numFrames = ::backtrace(g_frames, kMaxFrames);
+        g_captureState.store(kDone);
+    }
+}
+
+std::string demangle(const std::type_info* type)
+{
+    if(type == nullptr || *type == typeid(void))
+    {
+        return std::string();
+    }
+    int status = 0;
+    char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr, &status);
+    std::string result(status == 0 ? name : type->name());
+    free(name);
+    return result;
+}
+
+}
+
+std::string LoopWatchdog::StallReport::toString() const
+{
+    char text[256];
+    snprintf(text, sizeof text, "EventLoop %p tid %d stalled for %.1f ms in %s fd = %d",
+             static_cast<void*>(loop), tid, stalledNanos / 1e6, LoopActivity::phaseName(phase), fd);
+    std::string result(text);
+    if(!callback.empty())
+    {
+        result += " callback = ";
+        result += callback;
+    }
+    return result;
+}
+
+LoopWatchdog::LoopWatchdog(double thresholdSeconds, const std::string& name)
+    : thresholdNanos_(static_cast<int64_t>(thresholdSeconds * 1e9))
+    , stallCallback_(&LoopWatchdog::defaultStallCallback)
+    , stackSignal_(SIGUSR2)
+    , handlerInstalled_(false)
+    , stalls_(0)
+    , running_(false)
+    , thread_(std::bind(&LoopWatchdog::run, this), name)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop* loop)
+{
+    loops_.push_back(loop);
+    reported_.push_back(0);
+}
+
+void LoopWatchdog::watch(const std::vector<EventLoop*>& loops)
+{
+    for(EventLoop* loop : loops)
+    {
+        watch(loop);
+    }
+}
+
+void LoopWatchdog::start()
+{
+    if(stackSignal_ != 0)
+    {
+        void* frames[1];
+        ::backtrace(frames, 1);     // 第一次调用会加载libgcc，不能放在信号处理函数里
+        struct sigaction sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sa_handler = captureStackHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if(::sigaction(stackSignal_, &sa, &oldAction_) < 0)
+        {
+            LOG_ERROR("LoopWatchdog::start sigaction(%d) errno = %d, stacks disabled", stackSignal_, errno);
+            stackSignal_ = 0;
+        }
+        else
+        {
+            handlerInstalled_ = true;
+        }
+    }
+    running_ = true;
+    thread_.start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_.join();
+    if(handlerInstalled_)
+    {
+        // 监视线程已退出，不会再发信号; 还原start()之前的处理函数
+        ::sigaction(stackSignal_, &oldAction_, nullptr);
+        handlerInstalled_ = false;
+    }
+}
+
+void LoopWatchdog::run()
+{
+    std::chrono::nanoseconds interval(std::max<int64_t>(thresholdNanos_ / 4, 1000000));
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_)
+    {
+        cond_.wait_for(lock, interval);
+        if(!running_)
+        {
+            break;
+        }
+        lock.unlock();
+        check();
+        lock.lock();
+    }
+}
+
+void LoopWatchdog::check()
+{
+    int64_t now = LoopStats::nowNanos();
+    for(size_t i = 0; i < loops_.size(); ++i)
+    {
+        const LoopActivity& activity = loops_[i]->activity();
+        uint64_t iteration = activity.iteration();
+        int64_t since = activity.busySince();
+        if(since == 0 || now - since < thresholdNanos_ || iteration == reported_[i])
+        {
+            continue;
+        }
+        StallReport report;
+        report.loop = loops_[i];
+        report.tid = loops_[i]->threadId();
+        report.iteration = iteration;
+        report.stalledNanos = now - since;
+        report.phase = activity.phase();
+        report.fd = activity.fd();
+        report.callback = demangle(activity.callback());
+        if(activity.iteration() != iteration)
+        {
+            continue;   // 读取期间本轮已经结束
+        }
+        reported_[i] = iteration;
+        if(stackSignal_ != 0)
+        {
+            report.stack = captureStack(report.tid);
+        }
+        ++stalls_;
+        stallCallback_(report);
+    }
+}
+
+std::vector<std::string> LoopWatchdog::captureStack(pid_t tid)
+{
+    std::vector<std::string> stack;
+    std::lock_guard<std::mutex> lock(g_captureMutex);
+    g_captureTid.store(tid);
+    g_captureState.store(kRequested);
+    if(::syscall(SYS_tgkill, ::getpid(), tid, stackSignal_) != 0)
+    {
+        g_captureState.store(kIdle);
+        return stack;
+    }
+    for(int waited = 0; g_captureState.load() != kDone; ++waited)
+    {
+        if(waited >= kCaptureTimeoutMs)
+        {
+            int expected = kRequested;
+            if(g_captureState.compare_exchange_strong(expected, kIdle))
+            {
+                g_captureTid.store(0);
+                return stack;   // 信号一直没有被处理
+            }
+            // 正在采集，很快就会完成
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    char** symbols = ::backtrace_symbols(g_frames, g_numFrames);
+    if(symbols != nullptr)
+    {
+        for(int i = kSkipFrames; i < g_numFrames; ++i)
+        {
+            stack.push_back(symbols[i]);
+        }
+        free(symbols);
+    }
+    g_captureTid.store(0);
+    g_captureState.store(kIdle);
+    return stack;
+}
+
+void LoopWatchdog::defaultStallCallback(const StallReport& report)
+{
+    LOG_ERROR("LoopWatchdog: %s", report.toString().c_str());
+    for(size_t i = 0; i < report.stack.size(); ++i)
+    {
+        LOG_ERROR("LoopWatchdog:   #%zu %s", i, report.stack[i].c_str());
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "LoopActivity.h"
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief
+ * 事件循环卡顿检测. 监视线程每隔threshold/4检查一次被监视的loop，
+ * 一轮循环(从poll返回到下一次poll)超过threshold时报告当时正在处理的fd、回调种类和回调类型，
+ * 并向卡住的loop线程发信号，在信号处理函数中用backtrace记录调用栈. 每轮卡顿只报告一次
+ * 被监视的loop须活得比LoopWatchdog长，或在loop析构前stop()
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    struct StallReport
+    {
+        EventLoop* loop;
+        pid_t tid;                      // loop线程
+        uint64_t iteration;
+        int64_t stalledNanos;           // 检测到时本轮已经持续的时间
+        LoopActivity::Phase phase;
+        int fd;                         // 正在处理的Channel，-1表示不在处理Channel
+        std::string callback;           // 回调对象的类型名，未知时为空
+        std::vector<std::string> stack; // 没有采集调用栈时为空
+
+        std::string toString() const;
+    };
+    using StallCallback = std::function<void(const StallReport&)>;
+
+    explicit LoopWatchdog(double thresholdSeconds, const std::string& name = "LoopWatchdog");
+    ~LoopWatchdog();
+
+    /// Call before start()
+    void watch(EventLoop* loop);
+    void watch(const std::vector<EventLoop*>& loops);
+    /// 默认用LOG_ERROR输出报告，回调在监视线程中执行. Call before start()
+    void setStallCallback(const StallCallback& cb) { stallCallback_ = cb; }
+    /// 采集调用栈用的信号，0表示不采集，默认SIGUSR2. start()时替换该信号的处理函数，stop()时还原. Call before start()
+    void setStackSignal(int signo) { stackSignal_ = signo; }
+
+    void start();
+    void stop();
+
+    /// 已报告的卡顿次数. Thread safe.
+    uint64_t stalls() const { return stalls_; }
+
+private:
+    void run();
+    void check();
+    std::vector<std::string> captureStack(pid_t tid);
+    static void defaultStallCallback(const StallReport& report);
+
+    const int64_t thresholdNanos_;
+    std::vector<EventLoop*> loops_;
+    std::vector<uint64_t> reported_;    // 每个loop最近报告过的iteration
+    StallCallback stallCallback_;
+    int stackSignal_;
+    bool handlerInstalled_;
+    struct sigaction oldAction_;        // start()之前的信号处理，stop()时还原
+    std::atomic<uint64_t> stalls_;
+
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    Thread thread_;
+};
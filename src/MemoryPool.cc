@@ -0,0 +1,93 @@
+#include "MemoryPool.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// 块大小按max_align_t对齐，块内对象和空闲链表指针都能正确对齐
+static size_t roundUp(size_t size)
+{
+    const size_t align = alignof(max_align_t);
+    return (size + align - 1) / align * align;
+}
+
+MemoryPool::MemoryPool(size_t blocksPerChunk)
+    : blocksPerChunk_(blocksPerChunk),
+      blockSize_(0),
+      freeList_(nullptr),
+      numFree_(0)
+{
+}
+
+MemoryPool::~MemoryPool()
+{
+    for(void* chunk : chunks_)
+    {
+        ::free(chunk);
+    }
+}
+
+void* MemoryPool::allocate(size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(blockSize_ == 0)
+    {
+        blockSize_ = roundUp(size);
+    }
+    if(roundUp(size) != blockSize_)
+    {
+        lock.unlock();
+        return ::operator new(size);    // 不是池中的大小
+    }
+    if(freeList_ == nullptr)
+    {
+        newChunk();
+    }
+    FreeBlock* block = freeList_;
+    freeList_ = block->next;
+    --numFree_;
+    return block;
+}
+
+void MemoryPool::deallocate(void* p, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(roundUp(size) != blockSize_)
+    {
+        lock.unlock();
+        ::operator delete(p);
+        return;
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = freeList_;
+    freeList_ = block;
+    ++numFree_;
+}
+
+size_t MemoryPool::numChunks() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_.size();
+}
+
+size_t MemoryPool::numFree() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numFree_;
+}
+
+void MemoryPool::newChunk()
+{
+    char* chunk = static_cast<char*>(::malloc(blockSize_ * blocksPerChunk_));
+    if(chunk == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    chunks_.push_back(chunk);
+    for(size_t i = 0; i < blocksPerChunk_; ++i)
+    {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize_);
+        block->next = freeList_;
+        freeList_ = block;
+    }
+    numFree_ += blocksPerChunk_;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief
+ * 定长内存块池，每个EventLoop一个，给TcpConnection(连同shared_ptr控制块)使用
+ * 块大小由第一次分配决定，其它大小直接走operator new
+ * 释放的块放回空闲链表复用，池析构时才把内存还给系统
+ * 连接可能在任意线程析构，所以分配和回收都加锁；不同loop的池互不竞争
+ */
+class MemoryPool : noncopyable
+{
+public:
+    explicit MemoryPool(size_t blocksPerChunk = 64);
+    ~MemoryPool();
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    size_t blockSize() const { return blockSize_; }
+    size_t numChunks() const;
+    size_t numFree() const;
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    void newChunk();    // 加锁后调用
+
+    const size_t blocksPerChunk_;
+    mutable std::mutex mutex_;
+    size_t blockSize_;
+    FreeBlock* freeList_;
+    size_t numFree_;
+    std::vector<void*> chunks_;
+};
+
+/// 通过shared_ptr持有池，控制块中保存的分配器副本保证池活得比对象长
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const std::shared_ptr<MemoryPool>& pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n)
+    {
+        pool_->deallocate(p, n * sizeof(T));
+    }
+
+    const std::shared_ptr<MemoryPool>& pool() const { return pool_; }
+
+    // C++11分配器要求rebind，libstdc++通过allocator_traits推导也可以，这里显式给出
+    template <typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U>;
+    };
+
+private:
+    std::shared_ptr<MemoryPool> pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return !(lhs == rhs);
+}
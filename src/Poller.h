@@ -32,6 +32,8 @@ protected:
     using ChannelMap = std::unordered_map<int, Channel*>;
     ChannelMap channels_;
 
+    EventLoop* ownerLoop() const { return ownerLoop_; }
+
 private:
     EventLoop *ownerLoop_;
 };
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "RespCodec.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#include <stdio.h>
+
+namespace
+{
+
+// 解析从p开始、以CRLF结尾的十进制整数, 返回CRLF之后的位置;
+// 数据不足返回nullptr并置*incomplete, 格式错误返回nullptr
+const char* parseNumber(const char* p, const char* end, int64_t* value, bool* incomplete)
+{
+    bool negative = false;
+    if(p < end && *p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+    int64_t n = 0;
+    const char* digits = p;
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+        n = n * 10 + (*p - '0');
+        if(n > (static_cast<int64_t>(1) << 40))
+        {
+            return nullptr;
+        }
+        ++p;
+    }
+    if(end - p < 2)
+    {
+        *incomplete = true;
+        return nullptr;
+    }
+    if(p == digits || p[0] != '\r' || p[1] != '\n')
+    {
+        return nullptr;
+    }
+    *value = negative ? -n : n;
+    return p + 2;
+}
+
+}
+
+RespCodec::RespCodec(const CommandCallback& cb, size_t maxBulkLen)
+    : commandCallback_(cb)
+    , maxBulkLen_(maxBulkLen)
+{
+}
+
+void RespCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    std::vector<StringPiece> args;
+    while(buf->readableBytes() > 0)
+    {
+        ssize_t n = parseCommand(buf->peek(), buf->readableBytes(), &args);
+        if(n == 0)
+        {
+            break;
+        }
+        if(n < 0)
+        {
+            LOG_ERROR("RespCodec::onMessage [%s] protocol error", conn->name().c_str());
+            Buffer reply;
+            appendError(&reply, "ERR Protocol error");
+            conn->send(&reply);
+            conn->shutdown();
+            buf->retrieveAll();
+            break;
+        }
+        if(!args.empty())   // 空的内联命令直接跳过
+        {
+            commandCallback_(conn, args, receiveTime);
+        }
+        buf->retrieve(n);
+    }
+    if(batchEndCallback_)
+    {
+        batchEndCallback_(conn);
+    }
+}
+
+ssize_t RespCodec::parseCommand(const char* data, size_t len, std::vector<StringPiece>* args) const
+{
+    args->clear();
+    if(len == 0)
+    {
+        return 0;
+    }
+    if(data[0] != '*')
+    {
+        return parseInline(data, len, args);
+    }
+
+    const char* end = data + len;
+    bool incomplete = false;
+    int64_t count = 0;
+    const char* p = parseNumber(data + 1, end, &count, &incomplete);
+    if(p == nullptr)
+    {
+        return incomplete ? 0 : -1;
+    }
+    if(count < 0 || static_cast<size_t>(count) > kMaxArgs)
+    {
+        return -1;
+    }
+    for(int64_t i = 0; i < count; ++i)
+    {
+        if(p == end)
+        {
+            return 0;
+        }
+        if(*p != '$')
+        {
+            return -1;
+        }
+        int64_t bulkLen = 0;
+        p = parseNumber(p + 1, end, &bulkLen, &incomplete);
+        if(p == nullptr)
+        {
+            return incomplete ? 0 : -1;
+        }
+        if(bulkLen < 0 || static_cast<size_t>(bulkLen) > maxBulkLen_)
+        {
+            return -1;
+        }
+        if(static_cast<size_t>(end - p) < static_cast<size_t>(bulkLen) + 2)
+        {
+            return 0;   // 大value分多次到达时只重新解析长度, 不重新扫描内容
+        }
+        if(p[bulkLen] != '\r' || p[bulkLen + 1] != '\n')
+        {
+            return -1;
+        }
+        args->push_back(StringPiece(p, static_cast<size_t>(bulkLen)));
+        p += bulkLen + 2;
+    }
+    return p - data;
+}
+
+ssize_t RespCodec::parseInline(const char* data, size_t len, std::vector<StringPiece>* args) const
+{
+    const char* eol = static_cast<const char*>(::memchr(data, '\n', len));
+    if(eol == nullptr)
+    {
+        return len > kMaxInlineLen ? -1 : 0;
+    }
+    const char* lineEnd = (eol > data && eol[-1] == '\r') ? eol - 1 : eol;
+    const char* p = data;
+    while(p < lineEnd)
+    {
+        while(p < lineEnd && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        const char* word = p;
+        while(p < lineEnd && *p != ' ' && *p != '\t')
+        {
+            ++p;
+        }
+        if(p > word)
+        {
+            args->push_back(StringPiece(word, p - word));
+        }
+    }
+    return eol + 1 - data;
+}
+
+void RespCodec::appendSimpleString(Buffer* buf, StringPiece s)
+{
+    buf->append("+", 1);
+    buf->append(s.data(), s.size());
+    buf->append("\r\n", 2);
+}
+
+void RespCodec::appendError(Buffer* buf, StringPiece message)
+{
+    buf->append("-", 1);
+    buf->append(message.data(), message.size());
+    buf->append("\r\n", 2);
+}
+
+void RespCodec::appendInteger(Buffer* buf, int64_t value)
+{
+    char tmp[32];
+    int n = ::snprintf(tmp, sizeof tmp, ":%lld\r\n", static_cast<long long>(value));
+    buf->append(tmp, n);
+}
+
+void RespCodec::appendBulkString(Buffer* buf, StringPiece s)
+{
+    char tmp[32];
+    int n = ::snprintf(tmp, sizeof tmp, "$%zu\r\n", s.size());
+    buf->ensureWritableBytes(n + s.size() + 2);
+    buf->append(tmp, n);
+    buf->append(s.data(), s.size());
+    buf->append("\r\n", 2);
+}
+
+void RespCodec::appendNullBulkString(Buffer* buf)
+{
+    buf->append("$-1\r\n", 5);
+}
+
+void RespCodec::appendArrayHeader(Buffer* buf, size_t count)
+{
+    char tmp[32];
+    int n = ::snprintf(tmp, sizeof tmp, "*%zu\r\n", count);
+    buf->append(tmp, n);
+}
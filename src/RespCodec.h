@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "noncopyable.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief RESP2(Redis协议)编解码
+ * 请求是bulk string数组(*2\r\n$3\r\nGET\r\n$1\r\nk\r\n), 也接受telnet式的内联命令(GET k\r\n)
+ * 命令参数是指向inputBuffer的StringPiece, 只在回调期间有效
+ *
+ * RespCodec codec(onCommand);
+ * server.setMessageCallback(std::bind(&RespCodec::onMessage, &codec, _1, _2, _3));
+ */
+class RespCodec : noncopyable
+{
+public:
+    using CommandCallback = std::function<void(const TcpConnectionPtr&, const std::vector<StringPiece>& args, Timestamp)>;
+    /// 一次onMessage中的命令都处理完后调用, 用于批量发送响应
+    using BatchEndCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    static const size_t kMaxInlineLen = 64 * 1024;
+    static const size_t kMaxArgs = 1024 * 1024;
+
+    explicit RespCodec(const CommandCallback& cb, size_t maxBulkLen = 512 * 1024 * 1024);
+
+    void setBatchEndCallback(const BatchEndCallback& cb) { batchEndCallback_ = cb; }
+
+    /// 作为TcpConnection的MessageCallback, 解出buf中所有完整的命令
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    /// 解析一条命令, 返回占用的字节数; 数据不足返回0, 格式错误返回-1
+    ssize_t parseCommand(const char* data, size_t len, std::vector<StringPiece>* args) const;
+
+    static void appendSimpleString(Buffer* buf, StringPiece s);
+    static void appendError(Buffer* buf, StringPiece message);
+    static void appendInteger(Buffer* buf, int64_t value);
+    static void appendBulkString(Buffer* buf, StringPiece s);
+    static void appendNullBulkString(Buffer* buf);
+    static void appendArrayHeader(Buffer* buf, size_t count);
+
+private:
+    ssize_t parseInline(const char* data, size_t len, std::vector<StringPiece>* args) const;
+
+    CommandCallback commandCallback_;
+    BatchEndCallback batchEndCallback_;
+    const size_t maxBulkLen_;
+};
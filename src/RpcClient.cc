@@ -0,0 +1,196 @@
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name)
+    : loop_(loop)
+    , codec_(LengthHeaderCodec::kHeader32,
+             std::bind(&RpcClient::onFrame, this,
+                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))
+    , client_(loop, serverAddr, name)
+    , nextCallId_(1)
+    , connect_(false)
+    , flushQueued_(false)
+    , token_(std::make_shared<char>(0))
+{
+    client_.setConnectionCallback(std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec_,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+RpcClient::~RpcClient()
+{
+    // 已排队的flush不会再执行, 还没发出的调用在这里失败
+    for(OutgoingCall& c : takeOutgoing())
+    {
+        c.callback(rpc::kConnectionClosed, StringPiece());
+    }
+    failAll(rpc::kConnectionClosed);
+}
+
+void RpcClient::connect()
+{
+    connect_ = true;
+    client_.connect();
+}
+
+void RpcClient::disconnect()
+{
+    connect_ = false;
+    client_.stop();
+    client_.disconnect();
+}
+
+bool RpcClient::connected() const
+{
+    TcpConnectionPtr conn = client_.connection();
+    return conn && conn->connected();
+}
+
+void RpcClient::call(uint32_t methodId, StringPiece request, const ResponseCallback& cb, double timeoutSeconds)
+{
+    uint64_t callId = nextCallId_.fetch_add(1, std::memory_order_relaxed);
+    bool queueFlush = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rpc::appendFrame(&outgoingFrames_, callId, methodId, request);
+        outgoingCalls_.push_back(OutgoingCall{ callId, cb, timeoutSeconds });
+        if(!flushQueued_)
+        {
+            flushQueued_ = true;
+            queueFlush = true;
+        }
+    }
+    if(queueFlush)
+    {
+        // 总是排队: loop线程中连续发起的调用也在本轮事件结束后一起发出
+        std::weak_ptr<char> token(token_);
+        RpcClient* self = this;
+        loop_->queueInLoop([token, self]() {
+            if(token.lock())
+            {
+                self->flushInLoop();
+            }
+        });
+    }
+}
+
+std::vector<RpcClient::OutgoingCall> RpcClient::takeOutgoing()
+{
+    std::vector<OutgoingCall> calls;
+    std::lock_guard<std::mutex> lock(mutex_);
+    calls.swap(outgoingCalls_);
+    outgoingFrames_.retrieveAll();
+    flushQueued_ = false;
+    return calls;
+}
+
+void RpcClient::flushInLoop()
+{
+    Buffer frames;
+    std::vector<OutgoingCall> calls;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames.swap(outgoingFrames_);
+        calls.swap(outgoingCalls_);
+        flushQueued_ = false;
+    }
+    if(!connect_)
+    {
+        for(OutgoingCall& c : calls)
+        {
+            c.callback(rpc::kConnectionClosed, StringPiece());
+        }
+        return;
+    }
+    // 先登记再发送, 响应不会早于登记到达
+    for(OutgoingCall& c : calls)
+    {
+        PendingCall& p = pending_[c.callId];
+        p.callback = std::move(c.callback);
+        p.hasTimer = c.timeout > 0;
+        if(p.hasTimer)
+        {
+            p.timer = loop_->runAfter(c.timeout, std::bind(&RpcClient::onTimeout, this, c.callId));
+        }
+    }
+    TcpConnectionPtr conn = client_.connection();
+    if(conn && conn->connected())
+    {
+        conn->send(&frames);
+    }
+    else
+    {
+        unsentFrames_.append(frames.peek(), frames.readableBytes());    // 连接建立后发出
+    }
+}
+
+void RpcClient::onFrame(const TcpConnectionPtr& conn, StringPiece frame, Timestamp)
+{
+    uint64_t callId = 0;
+    uint32_t status = 0;
+    StringPiece response;
+    if(!rpc::parseHeader(frame, &callId, &status, &response))
+    {
+        LOG_ERROR("RpcClient::onFrame [%s] frame too short", conn->name().c_str());
+        conn->shutdown();
+        return;
+    }
+    auto it = pending_.find(callId);
+    if(it == pending_.end())
+    {
+        return;     // 已超时
+    }
+    PendingCall call = std::move(it->second);
+    pending_.erase(it);
+    if(call.hasTimer)
+    {
+        loop_->cancel(call.timer);
+    }
+    call.callback(static_cast<rpc::RpcStatus>(status),
+                  status == rpc::kOk ? response : StringPiece());
+}
+
+void RpcClient::onTimeout(uint64_t callId)
+{
+    auto it = pending_.find(callId);
+    if(it == pending_.end())
+    {
+        return;
+    }
+    ResponseCallback callback = std::move(it->second.callback);
+    pending_.erase(it);
+    callback(rpc::kDeadlineExceeded, StringPiece());
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        if(unsentFrames_.readableBytes() > 0)
+        {
+            conn->send(&unsentFrames_);
+        }
+    }
+    else
+    {
+        unsentFrames_.retrieveAll();
+        failAll(rpc::kConnectionClosed);
+    }
+}
+
+void RpcClient::failAll(rpc::RpcStatus status)
+{
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    for(auto& p : pending)
+    {
+        if(p.second.hasTimer)
+        {
+            loop_->cancel(p.second.timer);
+        }
+        p.second.callback(status, StringPiece());
+    }
+}
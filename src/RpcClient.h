@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "LengthHeaderCodec.h"
+#include "noncopyable.h"
+#include "RpcMessage.h"
+#include "StringPiece.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief RPC客户端, 一个连接上可以同时有任意多个未完成的调用, 按callId对应响应
+ * call线程安全; 同一轮事件里发起的调用合并成一次写; 超时由loop的定时器负责.
+ * 连接建立前发起的调用排队等待, 超时照常计算. 回调都在loop线程中执行
+ */
+class RpcClient : noncopyable
+{
+public:
+    /// response只在回调期间有效; status不为kOk时response为空
+    using ResponseCallback = std::function<void(rpc::RpcStatus status, StringPiece response)>;
+
+    RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name);
+    /// 应在loop线程中或loop退出后析构, 其他线程应先停止发起调用. 连接不应迁移到其他loop
+    /// 析构时还没发出和未完成的调用都以kConnectionClosed失败
+    ~RpcClient();
+
+    /// 非阻塞连接, 失败时按退避间隔重试
+    void connect();
+    /// 断开连接, 之后的调用立即以kConnectionClosed失败
+    void disconnect();
+    bool connected() const;
+    /// 连接断开后自动重连, 断开时未完成的调用仍以kConnectionClosed失败
+    void enableRetry() { client_.enableRetry(); }
+
+    /// 发起调用, timeoutSeconds <= 0表示不设超时. Thread safe.
+    void call(uint32_t methodId, StringPiece request, const ResponseCallback& cb, double timeoutSeconds = 0);
+    void call(const std::string& method, StringPiece request, const ResponseCallback& cb, double timeoutSeconds = 0)
+    {
+        call(rpc::methodId(method), request, cb, timeoutSeconds);
+    }
+
+    /// 已发出还未完成的调用数, 只在loop线程中准确
+    size_t inflight() const { return pending_.size(); }
+
+private:
+    struct OutgoingCall
+    {
+        uint64_t callId;
+        ResponseCallback callback;
+        double timeout;
+    };
+    struct PendingCall
+    {
+        ResponseCallback callback;
+        TimerId timer;
+        bool hasTimer;
+    };
+
+    void flushInLoop();
+    std::vector<OutgoingCall> takeOutgoing();
+    void onFrame(const TcpConnectionPtr& conn, StringPiece frame, Timestamp receiveTime);
+    void onTimeout(uint64_t callId);
+    void onConnection(const TcpConnectionPtr& conn);
+    void failAll(rpc::RpcStatus status);
+
+    EventLoop* loop_;
+    LengthHeaderCodec codec_;
+    TcpClient client_;      // 先于codec_析构, 析构时换下连接上绑定了codec_的回调
+    std::atomic<uint64_t> nextCallId_;
+    std::atomic_bool connect_;
+
+    mutable std::mutex mutex_;
+    Buffer outgoingFrames_;                     // guarded by mutex_, 等待flush的请求帧
+    std::vector<OutgoingCall> outgoingCalls_;   // guarded by mutex_
+    bool flushQueued_;                          // guarded by mutex_
+    std::shared_ptr<char> token_;               // 排队的flush持有weak_ptr, 析构后不再执行
+
+    // 以下只在loop线程中访问
+    std::unordered_map<uint64_t, PendingCall> pending_;
+    Buffer unsentFrames_;       // 连接建立前已登记的调用
+};
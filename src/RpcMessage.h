@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Buffer.h"
+#include "StringPiece.h"
+
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * RPC帧格式, 外层由LengthHeaderCodec(kHeader32)分帧:
+ * | length(4) | callId(8) | code(4) | payload |
+ * 请求中code是方法ID, 响应中code是RpcStatus; 整数都是网络字节序
+ */
+namespace rpc
+{
+
+enum RpcStatus
+{
+    kOk = 0,
+    kMethodNotFound = 1,
+    kBadRequest = 2,
+    kDeadlineExceeded = 3,     // 客户端本地产生
+    kConnectionClosed = 4,     // 客户端本地产生
+};
+
+static const size_t kRpcHeaderLen = sizeof(uint64_t) + sizeof(uint32_t);
+
+/// 方法名的FNV-1a哈希, 服务端注册和客户端调用前各算一次, 线上只传ID
+inline uint32_t methodId(StringPiece name)
+{
+    uint32_t h = 2166136261u;
+    for(char c : name)
+    {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+}
+
+/// 把一帧(含外层长度头)追加到out, 多帧攒在一起一次发送
+inline void appendFrame(Buffer* out, uint64_t callId, uint32_t code, StringPiece payload)
+{
+    char header[sizeof(uint32_t) + kRpcHeaderLen];
+    uint32_t length = htobe32(static_cast<uint32_t>(kRpcHeaderLen + payload.size()));
+    uint64_t be64 = htobe64(callId);
+    uint32_t be32 = htobe32(code);
+    ::memcpy(header, &length, sizeof length);
+    ::memcpy(header + sizeof length, &be64, sizeof be64);
+    ::memcpy(header + sizeof length + sizeof be64, &be32, sizeof be32);
+    out->ensureWritableBytes(sizeof header + payload.size());
+    out->append(header, sizeof header);
+    out->append(payload.data(), payload.size());
+}
+
+/// 解析帧头, 帧太短返回false
+inline bool parseHeader(StringPiece frame, uint64_t* callId, uint32_t* code, StringPiece* payload)
+{
+    if(frame.size() < kRpcHeaderLen)
+    {
+        return false;
+    }
+    uint64_t be64;
+    uint32_t be32;
+    ::memcpy(&be64, frame.data(), sizeof be64);
+    ::memcpy(&be32, frame.data() + sizeof be64, sizeof be32);
+    *callId = be64toh(be64);
+    *code = be32toh(be32);
+    *payload = StringPiece(frame.data() + kRpcHeaderLen, frame.size() - kRpcHeaderLen);
+    return true;
+}
+
+}
@@ -0,0 +1,154 @@
+#include "RpcServer.h"
+#include "Logger.h"
+
+RpcServer::RpcServer(EventLoop* loop,
+                     const InetAddress& listenAddr,
+                     const std::string& name,
+                     TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , codec_(LengthHeaderCodec::kHeader32,
+             std::bind(&RpcServer::onFrame, this,
+                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))
+{
+    server_.setConnectionCallback(
+        std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&LengthHeaderCodec::onMessage, &codec_,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    codec_.setBatchEndCallback(&RpcServer::flush);
+}
+
+uint32_t RpcServer::registerMethod(const std::string& name, const Handler& handler)
+{
+    Method method;
+    method.name = name;
+    method.handler = handler;
+    return addMethod(name, method);
+}
+
+uint32_t RpcServer::registerAsyncMethod(const std::string& name, const AsyncHandler& handler)
+{
+    Method method;
+    method.name = name;
+    method.asyncHandler = handler;
+    return addMethod(name, method);
+}
+
+uint32_t RpcServer::addMethod(const std::string& name, const Method& method)
+{
+    uint32_t id = rpc::methodId(name);
+    auto result = methods_.insert(std::make_pair(id, method));
+    if(!result.second && result.first->second.name != name)
+    {
+        LOG_FATAL("RpcServer::registerMethod method id of %s collides with %s",
+                name.c_str(), result.first->second.name.c_str());
+    }
+    result.first->second = method;
+    return id;
+}
+
+void RpcServer::start()
+{
+    LOG_INFO("RpcServer[%s] starts listening on %s with %zu methods",
+            server_.name().c_str(), server_.ipPort().c_str(), methods_.size());
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if(conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->setContext(std::make_shared<ConnectionState>());
+    }
+}
+
+void RpcServer::onFrame(const TcpConnectionPtr& conn, StringPiece frame, Timestamp)
+{
+    ConnectionState* state = static_cast<ConnectionState*>(conn->getContext().get());
+    uint64_t callId = 0;
+    uint32_t methodId = 0;
+    StringPiece request;
+    if(!rpc::parseHeader(frame, &callId, &methodId, &request))
+    {
+        LOG_ERROR("RpcServer::onFrame [%s] frame too short", conn->name().c_str());
+        conn->shutdown();
+        return;
+    }
+    auto it = methods_.find(methodId);
+    if(it == methods_.end())
+    {
+        rpc::appendFrame(&state->output, callId, rpc::kMethodNotFound, StringPiece());
+        return;
+    }
+    const Method& method = it->second;
+    if(method.handler)
+    {
+        state->response.retrieveAll();
+        method.handler(request, &state->response);
+        rpc::appendFrame(&state->output, callId, rpc::kOk,
+                StringPiece(state->response.peek(), state->response.readableBytes()));
+    }
+    else
+    {
+        method.asyncHandler(request, Reply(conn, callId));
+    }
+}
+
+// 一批请求处理完, 或异步回复在loop中到达时发送
+void RpcServer::flush(const TcpConnectionPtr& conn)
+{
+    if(!conn->getLoop()->isInLoopThread())     // 连接已迁移, 到新loop上发送
+    {
+        conn->getLoop()->queueInLoop(std::bind(&RpcServer::flush, conn));
+        return;
+    }
+    ConnectionState* state = static_cast<ConnectionState*>(conn->getContext().get());
+    state->flushQueued = false;
+    if(state->output.readableBytes() > 0)
+    {
+        conn->send(&state->output);
+    }
+}
+
+void RpcServer::replyInLoop(const TcpConnectionPtr& conn, uint64_t callId, uint32_t status, StringPiece response)
+{
+    ConnectionState* state = static_cast<ConnectionState*>(conn->getContext().get());
+    rpc::appendFrame(&state->output, callId, status, response);
+    if(!state->flushQueued)
+    {
+        // 同一轮事件里的多个异步回复合并成一次发送
+        state->flushQueued = true;
+        conn->getLoop()->queueInLoop(std::bind(&RpcServer::flush, conn));
+    }
+}
+
+void RpcServer::Reply::send(StringPiece response, uint32_t status) const
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if(!conn || !conn->connected())
+    {
+        return;
+    }
+    if(conn->getLoop()->isInLoopThread())
+    {
+        replyInLoop(conn, callId_, status, response);
+    }
+    else
+    {
+        std::string data = response.asString();
+        uint64_t callId = callId_;
+        conn->getLoop()->queueInLoop([conn, callId, status, data]() {
+            if(conn->getLoop()->isInLoopThread())
+            {
+                replyInLoop(conn, callId, status, data);
+            }
+            else    // 连接已迁移
+            {
+                Buffer frame;
+                rpc::appendFrame(&frame, callId, status, data);
+                conn->send(&frame);
+            }
+        });
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Buffer.h"
+#include "LengthHeaderCodec.h"
+#include "noncopyable.h"
+#include "RpcMessage.h"
+#include "StringPiece.h"
+#include "TcpServer.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief 多路复用的RPC服务端, 一个连接上可以有任意多个未完成的调用
+ * 方法在start()前注册, 注册时把方法名换算成ID, 请求只带ID查表分发.
+ * 同步方法的响应在一次读到的请求处理完后合并发送
+ */
+class RpcServer : noncopyable
+{
+public:
+    /// 异步方法的回复句柄, 可复制, send线程安全, 每个调用只应send一次
+    class Reply
+    {
+    public:
+        Reply(const TcpConnectionPtr& conn, uint64_t callId) : conn_(conn), callId_(callId) {}
+        void send(StringPiece response, uint32_t status = rpc::kOk) const;
+    private:
+        std::weak_ptr<TcpConnection> conn_;
+        uint64_t callId_;
+    };
+
+    /// 同步方法: 在连接所属loop中执行, 响应写入response
+    using Handler = std::function<void(StringPiece request, Buffer* response)>;
+    /// 异步方法: 可以把reply交给其他线程稍后回复
+    using AsyncHandler = std::function<void(StringPiece request, const Reply& reply)>;
+
+    RpcServer(EventLoop* loop,
+              const InetAddress& listenAddr,
+              const std::string& name,
+              TcpServer::Option option = TcpServer::kNoReusePort);
+
+    /// 返回方法ID, 与rpc::methodId(name)相同; 名字哈希冲突时LOG_FATAL. Call before start().
+    uint32_t registerMethod(const std::string& name, const Handler& handler);
+    uint32_t registerAsyncMethod(const std::string& name, const AsyncHandler& handler);
+
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    /// 底层TcpServer, 用于设置分发策略等. Call before start().
+    TcpServer& tcpServer() { return server_; }
+    void start();
+
+private:
+    friend class Reply;
+
+    struct Method
+    {
+        std::string name;
+        Handler handler;
+        AsyncHandler asyncHandler;
+    };
+    // 每个连接的状态, 只在连接所属loop中访问
+    struct ConnectionState
+    {
+        Buffer output;      // 待发送的响应帧
+        Buffer response;    // 同步方法的响应体, 复用
+        bool flushQueued = false;
+    };
+
+    uint32_t addMethod(const std::string& name, const Method& method);
+    void onConnection(const TcpConnectionPtr& conn);
+    void onFrame(const TcpConnectionPtr& conn, StringPiece frame, Timestamp receiveTime);
+    static void flush(const TcpConnectionPtr& conn);
+    static void replyInLoop(const TcpConnectionPtr& conn, uint64_t callId, uint32_t status, StringPiece response);
+
+    TcpServer server_;
+    LengthHeaderCodec codec_;
+    std::unordered_map<uint32_t, Method> methods_;    // start()后只读
+};
@@ -0,0 +1,150 @@
+#include "ShmClient.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <unistd.h>
+
+namespace
+{
+
+// ShmClient析构后连接的关闭由它收尾
+void removeDetachedConnection(const ShmConnectionPtr& conn)
+{
+    conn->getLoop()->queueInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+}
+
+}
+
+ShmClient::ShmClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    : loop_(loop)
+    , connector_(std::make_shared<Connector>(loop, serverAddr))
+    , name_(nameArg)
+    , connect_(false)
+    , nextConnId_(0)
+    , handshakeFd_(-1)
+{
+    if(!serverAddr.isUnix())
+    {
+        LOG_FATAL("ShmClient[%s] needs a unix domain address, got %s", name_.c_str(), serverAddr.toIpPort().c_str());
+    }
+    connector_->setNewConnectionCallback(std::bind(&ShmClient::newConnection, this, std::placeholders::_1));
+}
+
+ShmClient::~ShmClient()
+{
+    connect_ = false;
+    connector_->stop();
+    if(handshakeChannel_)
+    {
+        int fd = handshakeFd_;
+        resetHandshake();
+        ::close(fd);
+    }
+    ShmConnectionPtr conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn.swap(connection_);
+    }
+    if(conn)
+    {
+        // 连接可能比ShmClient活得久, 换掉绑定了使用者对象的回调
+        conn->setConnectionCallback(ShmConnectionCallback());
+        conn->setMessageCallback(ShmMessageCallback());
+        conn->setCloseCallback(removeDetachedConnection);
+        conn->shutdown();
+    }
+}
+
+void ShmClient::connect()
+{
+    LOG_INFO("ShmClient::connect [%s] - connecting to %s",
+            name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void ShmClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void ShmClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+// socket已连上, 等服务端发来memfd和eventfd
+void ShmClient::newConnection(int sockfd)
+{
+    handshakeFd_ = sockfd;
+    handshakeChannel_.reset(new Channel(loop_, sockfd));
+    handshakeChannel_->setReadCallback(std::bind(&ShmClient::handleHandshake, this));
+    handshakeChannel_->setCloseCallback(std::bind(&ShmClient::handleHandshake, this));
+    handshakeChannel_->enableReading();
+}
+
+void ShmClient::handleHandshake()
+{
+    int serverNotifyFd = -1;
+    int clientNotifyFd = -1;
+    bool again = false;
+    std::unique_ptr<ShmRegion> region =
+        ShmRegion::receiveHandshake(handshakeFd_, &serverNotifyFd, &clientNotifyFd, &again);
+    if(again)
+    {
+        return;
+    }
+    int sockfd = handshakeFd_;
+    resetHandshake();
+    if(!region)
+    {
+        ::close(sockfd);
+        if(connect_)
+        {
+            connector_->restart();
+        }
+        return;
+    }
+
+    // 客户端读环1(服务端->客户端), 写环0
+    std::string connName = name_ + "-" + connector_->serverAddress().toIpPort() + "#" + std::to_string(++nextConnId_);
+    ShmConnectionPtr conn = std::make_shared<ShmConnection>(loop_, connName, sockfd, std::move(region), 1,
+                                                             clientNotifyFd, serverNotifyFd);
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setCloseCallback(std::bind(&ShmClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+// 可能在handshakeChannel_自己的回调中调用, 推迟析构
+void ShmClient::resetHandshake()
+{
+    handshakeChannel_->disableAll();
+    handshakeChannel_->remove();
+    std::shared_ptr<Channel> dead(handshakeChannel_.release());
+    loop_->queueInLoop([dead]() {});
+    handshakeFd_ = -1;
+}
+
+void ShmClient::removeConnection(const ShmConnectionPtr& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(connection_ == conn)
+        {
+            connection_.reset();
+        }
+    }
+    loop_->queueInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+}
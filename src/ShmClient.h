@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Connector.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "ShmConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class Channel;
+class EventLoop;
+
+/**
+ * @brief 共享内存连接的客户端: 连上ShmServer的Unix域socket, 收到memfd和eventfd后建立ShmConnection.
+ * 服务端还没启动时按Connector的退避间隔重试
+ */
+class ShmClient : noncopyable
+{
+public:
+    /// serverAddr须为InetAddress::unixDomain()
+    ShmClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    /// 应在loop线程中或loop退出后析构
+    ~ShmClient();
+
+    void connect();
+    /// 发完暂存的数据后关闭已建立的连接
+    void disconnect();
+    /// 放弃正在进行的连接和重试
+    void stop();
+
+    ShmConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    void setRetryDelay(int initMs, int maxMs) { connector_->setRetryDelay(initMs, maxMs); }
+
+    /// Not thread safe.
+    void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+    /// Not thread safe.
+    void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+
+private:
+    void newConnection(int sockfd);
+    void handleHandshake();
+    void resetHandshake();
+    void removeConnection(const ShmConnectionPtr& conn);
+
+    EventLoop* loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+    std::atomic_bool connect_;
+    int nextConnId_;
+    int handshakeFd_;                           // 已连上, 等待服务端的握手消息
+    std::unique_ptr<Channel> handshakeChannel_;
+    mutable std::mutex mutex_;
+    ShmConnectionPtr connection_;               // guarded by mutex_
+};
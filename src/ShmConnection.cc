@@ -0,0 +1,296 @@
+#include "ShmConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static const int kMaxReadRounds = 16;   // 对方持续写入时, 一次唤醒最多交付的轮数, 避免饿死其他fd
+
+ShmConnection::ShmConnection(EventLoop* loop, const std::string& name, int controlFd,
+                             std::unique_ptr<ShmRegion> region, int rxRing, int notifyFd, int peerNotifyFd)
+    : loop_(loop)
+    , name_(name)
+    , state_(kDisconnected)
+    , control_(controlFd)
+    , controlChannel_(loop, controlFd)
+    , region_(std::move(region))
+    , rx_(region_->ring(rxRing))
+    , tx_(region_->ring(1 - rxRing))
+    , rxSeen_(0)
+    , notifyFd_(notifyFd)
+    , peerNotifyFd_(peerNotifyFd)
+    , notifyChannel_(loop, notifyFd)
+    , producerParked_(false)
+    , notifications_(0)
+    , wakeups_(0)
+{
+    controlChannel_.setReadCallback(std::bind(&ShmConnection::handleControl, this, std::placeholders::_1));
+    controlChannel_.setCloseCallback(std::bind(&ShmConnection::handleClose, this));
+    notifyChannel_.setReadCallback(std::bind(&ShmConnection::handleNotify, this, std::placeholders::_1));
+    LOG_INFO("ShmConnection::ctor [%s] control fd = %d ring capacity = %zu",
+            name_.c_str(), controlFd, region_->capacity());
+}
+
+ShmConnection::~ShmConnection()
+{
+    LOG_INFO("ShmConnection::dtor [%s] state = %d", name_.c_str(), static_cast<int>(state_));
+    ::close(notifyFd_);
+    ::close(peerNotifyFd_);
+}
+
+void ShmConnection::send(const void* data, size_t len)
+{
+    if(state_ != kConnected)
+    {
+        return;
+    }
+    if(loop_->isInLoopThread())
+    {
+        sendInLoop(data, len);
+    }
+    else
+    {
+        // 拷贝一份数据, 调用方的data在任务执行时可能已经失效
+        std::string message(static_cast<const char*>(data), len);
+        ShmConnectionPtr self(shared_from_this());
+        loop_->queueInLoop([self, message]() { self->sendInLoop(message.data(), message.size()); });
+    }
+}
+
+void ShmConnection::send(Buffer* buf)
+{
+    if(state_ != kConnected)
+    {
+        return;
+    }
+    if(loop_->isInLoopThread())
+    {
+        sendInLoop(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+    }
+    else
+    {
+        send(buf->retrieveAllAsString());
+    }
+}
+
+void ShmConnection::sendInLoop(const void* data, size_t len)
+{
+    if(state_ == kDisconnected)
+    {
+        LOG_ERROR("ShmConnection::sendInLoop [%s] disconnected, give up writing", name_.c_str());
+        return;
+    }
+    if(producerParked_)
+    {
+        outputBuffer_.append(static_cast<const char*>(data), len);  // 保持顺序, 等对方腾出空间
+        return;
+    }
+    size_t n = tx_.write(data, len);
+    if(n > 0 && tx_.wakeConsumer())
+    {
+        notifyPeer();
+    }
+    if(n < len)
+    {
+        outputBuffer_.append(static_cast<const char*>(data) + n, len - n);
+        flushOutput();
+    }
+}
+
+// 环满时登记等待并返回, 对方读走数据后写我们的eventfd, 在handleWrite中继续
+void ShmConnection::flushOutput()
+{
+    while(outputBuffer_.readableBytes() > 0)
+    {
+        if(tx_.parkProducer())
+        {
+            producerParked_ = true;
+            return;
+        }
+        size_t n = tx_.write(outputBuffer_.peek(), outputBuffer_.readableBytes());
+        outputBuffer_.retrieve(n);
+        if(n > 0 && tx_.wakeConsumer())
+        {
+            notifyPeer();
+        }
+    }
+    if(state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+void ShmConnection::shutdown()
+{
+    int expected = kConnected;
+    if(state_.compare_exchange_strong(expected, kDisconnecting))
+    {
+        loop_->runInLoop(std::bind(&ShmConnection::shutdownInLoop, shared_from_this()));
+    }
+}
+
+void ShmConnection::shutdownInLoop()
+{
+    if(outputBuffer_.readableBytes() == 0)
+    {
+        // 对方读到EOF后交付环中剩余的数据再关闭, 我们随后也读到EOF
+        control_.shutdownWrite();
+    }
+}
+
+void ShmConnection::notifyPeer()
+{
+    uint64_t one = 1;
+    if(::write(peerNotifyFd_, &one, sizeof one) != sizeof one)
+    {
+        LOG_ERROR("ShmConnection::notifyPeer [%s] errno = %d (%s)", name_.c_str(), errno, strerror(errno));
+    }
+    addCounter(notifications_, 1);
+}
+
+void ShmConnection::handleNotify(Timestamp receiveTime)
+{
+    uint64_t count = 0;
+    if(::read(notifyFd_, &count, sizeof count) == sizeof count)
+    {
+        addCounter(wakeups_, 1);
+    }
+    handleRead(receiveTime);
+    if(state_ != kDisconnected)
+    {
+        handleWrite();
+    }
+}
+
+void ShmConnection::handleRead(Timestamp receiveTime)
+{
+    for(int round = 0; round < kMaxReadRounds; ++round)
+    {
+        uint64_t begin = rx_.readBegin();
+        uint64_t end = rx_.readEnd();
+        // head由对方写入, 超出环容量(或回退到tail之前)时按长度读会越过映射区
+        if(end - begin > rx_.capacity())
+        {
+            LOG_ERROR("ShmConnection::handleRead [%s] corrupt ring, head = %llu tail = %llu capacity = %zu",
+                    name_.c_str(), (unsigned long long)end, (unsigned long long)begin, rx_.capacity());
+            closeInLoop();
+            return;
+        }
+        if(end != rxSeen_)
+        {
+            rxSeen_ = end;
+            ShmBuffer input(rx_.at(begin), static_cast<size_t>(end - begin));
+            if(messageCallback_)
+            {
+                messageCallback_(shared_from_this(), &input, receiveTime);
+            }
+            else
+            {
+                input.retrieveAll();
+            }
+            if(input.retrieved() > 0 && rx_.commit(input.retrieved()))
+            {
+                notifyPeer();
+            }
+            continue;
+        }
+        if(rx_.parkConsumer(rxSeen_))
+        {
+            return;
+        }
+    }
+    // 没有登记等待, 对方不会再通知, 自己把eventfd置为可读, 下一轮poll继续
+    uint64_t one = 1;
+    if(::write(notifyFd_, &one, sizeof one) != sizeof one)
+    {
+        LOG_ERROR("ShmConnection::handleRead [%s] rearm errno = %d (%s)", name_.c_str(), errno, strerror(errno));
+    }
+}
+
+void ShmConnection::handleWrite()
+{
+    if(producerParked_)
+    {
+        producerParked_ = false;
+        flushOutput();
+    }
+}
+
+void ShmConnection::handleControl(Timestamp)
+{
+    char buf[64];
+    ssize_t n = ::read(control_.fd(), buf, sizeof buf);
+    if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        handleClose();
+    }
+    else if(n > 0)
+    {
+        LOG_ERROR("ShmConnection::handleControl [%s] unexpected %zd bytes on control socket", name_.c_str(), n);
+    }
+}
+
+void ShmConnection::handleClose()
+{
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    LOG_INFO("ShmConnection::handleClose [%s]", name_.c_str());
+    // 对方关闭前写入的数据还在环里, 先交给使用者
+    handleRead(Timestamp::now());
+    closeInLoop();
+}
+
+void ShmConnection::closeInLoop()
+{
+    if(state_ == kDisconnected)
+    {
+        return;     // handleRead发现环损坏时已经关闭
+    }
+    state_ = kDisconnected;
+    controlChannel_.disableAll();
+    notifyChannel_.disableAll();
+
+    ShmConnectionPtr guard(shared_from_this());
+    if(connectionCallback_)
+    {
+        connectionCallback_(guard);
+    }
+    if(closeCallback_)
+    {
+        closeCallback_(guard);
+    }
+}
+
+void ShmConnection::connectEstablished()
+{
+    state_ = kConnected;
+    controlChannel_.tie(shared_from_this());
+    notifyChannel_.tie(shared_from_this());
+    controlChannel_.enableReading();
+    notifyChannel_.enableReading();
+    if(connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
+}
+
+void ShmConnection::connectDestroyed()
+{
+    if(state_ != kDisconnected)
+    {
+        state_ = kDisconnected;
+        controlChannel_.disableAll();
+        notifyChannel_.disableAll();
+        if(connectionCallback_)
+        {
+            connectionCallback_(shared_from_this());
+        }
+    }
+    controlChannel_.remove();
+    notifyChannel_.remove();
+}
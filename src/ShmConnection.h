@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "noncopyable.h"
+#include "ShmRing.h"
+#include "Socket.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+class EventLoop;
+class ShmConnection;
+
+using ShmConnectionPtr = std::shared_ptr<ShmConnection>;
+using ShmConnectionCallback = std::function<void(const ShmConnectionPtr&)>;
+/// 与MessageCallback相同的形式, input直接指向共享内存中的数据
+using ShmMessageCallback = std::function<void(const ShmConnectionPtr&, ShmBuffer* input, Timestamp)>;
+
+/**
+ * @brief 同一台机器上两个进程之间的共享内存连接, 由ShmServer/ShmClient创建.
+ * 每个方向一个ShmRing, 数据不经过内核; 每端一个eventfd挂在自己的EventLoop上,
+ * 只有对方停下等待时才写对方的eventfd, 对方正忙时连续的发送不产生系统调用.
+ * 握手用的Unix域socket保留下来检测对端退出: 任一端关闭或进程退出, 另一端读到EOF后关闭连接
+ */
+class ShmConnection : noncopyable, public std::enable_shared_from_this<ShmConnection>
+{
+public:
+    /// 接管controlFd、region和两个eventfd. rxRing为本端读取的环的编号
+    ShmConnection(EventLoop* loop, const std::string& name, int controlFd,
+                  std::unique_ptr<ShmRegion> region, int rxRing, int notifyFd, int peerNotifyFd);
+    ~ShmConnection();
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    bool connected() const { return state_ == kConnected; }
+
+    /// 环有空间时直接写入环, 否则暂存在本端, 对方腾出空间后继续写. Thread safe.
+    void send(const void* data, size_t len);
+    void send(const std::string& message) { send(message.data(), message.size()); }
+    /// 发送buf中的全部可读数据并清空buf. Thread safe.
+    void send(Buffer* buf);
+    /// 发完暂存的数据后关闭. Thread safe.
+    void shutdown();
+
+    void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+    void setCloseCallback(const ShmConnectionCallback& cb) { closeCallback_ = cb; }
+
+    /// 还没写进环的字节数
+    size_t outputBytes() const { return outputBuffer_.readableBytes(); }
+    /// 写对方eventfd的次数, 与发送次数之比反映通知被省掉的程度. 任意线程可读
+    uint64_t notifications() const { return notifications_.load(std::memory_order_relaxed); }
+    /// 本端被eventfd唤醒的次数. 任意线程可读
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+    void connectEstablished();
+    void connectDestroyed();
+
+private:
+    enum StateE { kDisconnected, kConnected, kDisconnecting };
+
+    void handleNotify(Timestamp receiveTime);
+    void handleControl(Timestamp receiveTime);
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void flushOutput();
+    void handleClose();
+    void closeInLoop();     // 不再读环, 直接断开并通知使用者
+    void sendInLoop(const void* data, size_t len);
+    void shutdownInLoop();
+    void notifyPeer();
+    static void addCounter(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    EventLoop* loop_;
+    const std::string name_;
+    std::atomic_int state_;
+    Socket control_;
+    Channel controlChannel_;
+    std::unique_ptr<ShmRegion> region_;
+    ShmRing rx_;
+    ShmRing tx_;
+    uint64_t rxSeen_;       // 已交给messageCallback_的数据末尾
+    const int notifyFd_;
+    const int peerNotifyFd_;
+    Channel notifyChannel_;
+    bool producerParked_;   // 环满, 等对方腾出空间
+    Buffer outputBuffer_;   // 环满时暂存
+
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+    ShmConnectionCallback closeCallback_;
+
+    std::atomic<uint64_t> notifications_;
+    std::atomic<uint64_t> wakeups_;
+};
@@ -0,0 +1,231 @@
+#include "ShmRing.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <new>
+
+namespace
+{
+
+struct Hello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+};
+
+const int kHandshakeFds = 3;    // memfd, 服务端eventfd, 客户端eventfd
+
+size_t pageSize()
+{
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+size_t roundCapacity(size_t capacity)
+{
+    size_t n = pageSize();
+    while(n < capacity)
+    {
+        n <<= 1;
+    }
+    return n;
+}
+
+}
+
+ShmRegion::ShmRegion(int memfd, size_t capacity)
+    : memfd_(memfd)
+    , capacity_(capacity)
+    , headers_(MAP_FAILED)
+{
+    data_[0] = data_[1] = nullptr;
+}
+
+ShmRegion::~ShmRegion()
+{
+    for(char* data : data_)
+    {
+        if(data != nullptr)
+        {
+            ::munmap(data, 2 * capacity_);
+        }
+    }
+    if(headers_ != MAP_FAILED)
+    {
+        ::munmap(headers_, pageSize());
+    }
+    ::close(memfd_);
+}
+
+std::unique_ptr<ShmRegion> ShmRegion::create(size_t capacity)
+{
+    capacity = roundCapacity(capacity);
+    int memfd = ::memfd_create("moduo-shm", MFD_CLOEXEC);
+    if(memfd < 0)
+    {
+        LOG_ERROR("ShmRegion::create memfd_create errno = %d (%s)", errno, strerror(errno));
+        return nullptr;
+    }
+    std::unique_ptr<ShmRegion> region(new ShmRegion(memfd, capacity));
+    if(::ftruncate(memfd, static_cast<off_t>(pageSize() + 2 * capacity)) < 0)
+    {
+        LOG_ERROR("ShmRegion::create ftruncate errno = %d (%s)", errno, strerror(errno));
+        return nullptr;
+    }
+    if(!region->map())
+    {
+        return nullptr;
+    }
+    // 新文件内容全为0; 两端开始时都处于等待状态, 第一次写入就会通知对方
+    ShmRingHeader* headers = static_cast<ShmRingHeader*>(region->headers_);
+    for(int i = 0; i < 2; ++i)
+    {
+        new (&headers[i]) ShmRingHeader();
+        headers[i].head.store(0);
+        headers[i].tail.store(0);
+        headers[i].producerWaiting.store(0);
+        headers[i].consumerWaiting.store(1);
+    }
+    return region;
+}
+
+std::unique_ptr<ShmRegion> ShmRegion::attach(int memfd, size_t capacity)
+{
+    std::unique_ptr<ShmRegion> region(new ShmRegion(memfd, capacity));
+    struct stat st;
+    if(capacity == 0 || capacity != roundCapacity(capacity)
+        || ::fstat(memfd, &st) < 0 || static_cast<size_t>(st.st_size) != pageSize() + 2 * capacity)
+    {
+        LOG_ERROR("ShmRegion::attach memfd %d does not hold two rings of %zu bytes", memfd, capacity);
+        return nullptr;
+    }
+    if(!region->map())
+    {
+        return nullptr;
+    }
+    return region;
+}
+
+// 每个环先保留2 * capacity_的地址空间, 再把同一段文件映射到前后两半
+bool ShmRegion::map()
+{
+    headers_ = ::mmap(nullptr, pageSize(), PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+    if(headers_ == MAP_FAILED)
+    {
+        LOG_ERROR("ShmRegion::map headers errno = %d (%s)", errno, strerror(errno));
+        return false;
+    }
+    for(int i = 0; i < 2; ++i)
+    {
+        void* reserved = ::mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(reserved == MAP_FAILED)
+        {
+            LOG_ERROR("ShmRegion::map reserve errno = %d (%s)", errno, strerror(errno));
+            return false;
+        }
+        data_[i] = static_cast<char*>(reserved);
+        off_t offset = static_cast<off_t>(pageSize() + i * capacity_);
+        for(int half = 0; half < 2; ++half)
+        {
+            void* p = ::mmap(data_[i] + half * capacity_, capacity_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_FIXED, memfd_, offset);
+            if(p == MAP_FAILED)
+            {
+                LOG_ERROR("ShmRegion::map ring %d errno = %d (%s)", i, errno, strerror(errno));
+                return false;
+            }
+        }
+        rings_[i] = ShmRing(static_cast<ShmRingHeader*>(headers_) + i, data_[i], capacity_);
+    }
+    return true;
+}
+
+bool ShmRegion::sendHandshake(int sockfd, int serverNotifyFd, int clientNotifyFd) const
+{
+    Hello hello = { kMagic, kVersion, capacity_ };
+    iovec iov = { &hello, sizeof hello };
+    char control[CMSG_SPACE(kHandshakeFds * sizeof(int))];
+    ::memset(control, 0, sizeof control);
+    msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(kHandshakeFds * sizeof(int));
+    int fds[kHandshakeFds] = { memfd_, serverNotifyFd, clientNotifyFd };
+    ::memcpy(CMSG_DATA(cm), fds, sizeof fds);
+
+    // 新连接的发送缓冲区是空的, 这么小的消息不会只发出一部分
+    ssize_t n = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    if(n != static_cast<ssize_t>(sizeof hello))
+    {
+        LOG_ERROR("ShmRegion::sendHandshake fd = %d errno = %d (%s)", sockfd, errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ShmRegion> ShmRegion::receiveHandshake(int sockfd, int* serverNotifyFd, int* clientNotifyFd,
+                                                       bool* again)
+{
+    *again = false;
+    Hello hello;
+    iovec iov = { &hello, sizeof hello };
+    char control[CMSG_SPACE(kHandshakeFds * sizeof(int))];
+    ::memset(control, 0, sizeof control);
+    msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        *again = true;
+        return nullptr;
+    }
+
+    int fds[kHandshakeFds] = { -1, -1, -1 };
+    // 出错或对端关闭时内核不填写msg_controllen, 不能解析control
+    cmsghdr* cm = n > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if(cm != nullptr && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS
+        && cm->cmsg_len == CMSG_LEN(kHandshakeFds * sizeof(int)))
+    {
+        ::memcpy(fds, CMSG_DATA(cm), sizeof fds);
+    }
+    if(n != static_cast<ssize_t>(sizeof hello) || (msg.msg_flags & MSG_CTRUNC)
+        || hello.magic != kMagic || hello.version != kVersion || fds[0] < 0)
+    {
+        LOG_ERROR("ShmRegion::receiveHandshake fd = %d bad handshake, n = %zd errno = %d",
+                sockfd, n, n < 0 ? errno : 0);
+        for(int fd : fds)
+        {
+            if(fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+        return nullptr;
+    }
+    std::unique_ptr<ShmRegion> region = attach(fds[0], hello.capacity);
+    if(!region)
+    {
+        ::close(fds[1]);
+        ::close(fds[2]);
+        return nullptr;
+    }
+    *serverNotifyFd = fds[1];
+    *clientNotifyFd = fds[2];
+    return region;
+}
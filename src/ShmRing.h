@@ -0,0 +1,179 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "StringPiece.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+/// 共享内存中一个方向的环形缓冲区的控制字段, 生产者和消费者各写自己的cache line
+struct ShmRingHeader
+{
+    alignas(64) std::atomic<uint64_t> head;         // 生产者写入的总字节数
+    std::atomic<uint32_t> producerWaiting;          // 生产者因环满而等待, 消费者腾出空间后通知
+    alignas(64) std::atomic<uint64_t> tail;         // 消费者读走的总字节数
+    std::atomic<uint32_t> consumerWaiting;          // 消费者已读空并等待, 生产者写入后通知
+};
+
+/**
+ * @brief 单生产者单消费者的字节流环, 数据区在虚拟地址上连续映射两次,
+ * 任意位置开始的可读/可写区间都是连续的, 收发都不用处理回绕.
+ * 生产者和消费者在不同进程中, 各自只调用自己一侧的函数
+ */
+class ShmRing
+{
+public:
+    ShmRing() : header_(nullptr), data_(nullptr), capacity_(0) {}
+    ShmRing(ShmRingHeader* header, char* data, size_t capacity)
+        : header_(header), data_(data), capacity_(capacity) {}
+
+    size_t capacity() const { return capacity_; }
+
+    // ---- 生产者 ----
+    /// 写入尽可能多的数据, 返回写入的字节数
+    size_t write(const void* data, size_t len)
+    {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        uint64_t tail = header_->tail.load(std::memory_order_acquire);
+        size_t n = std::min(len, capacity_ - static_cast<size_t>(head - tail));
+        ::memcpy(data_ + (head & (capacity_ - 1)), data, n);
+        header_->head.store(head + n, std::memory_order_release);
+        return n;
+    }
+    /// 写入后调用, 消费者已停下等待时返回true, 由调用方写eventfd; 消费者忙时不通知
+    bool wakeConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return header_->consumerWaiting.load(std::memory_order_relaxed) != 0
+            && header_->consumerWaiting.exchange(0) != 0;
+    }
+    /// 环已满时调用. 返回false表示期间消费者已腾出空间, 可以继续写
+    bool parkProducer()
+    {
+        header_->producerWaiting.store(1);
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        if(head - header_->tail.load() < capacity_)
+        {
+            header_->producerWaiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // ---- 消费者 ----
+    uint64_t readEnd() const { return header_->head.load(std::memory_order_acquire); }
+    uint64_t readBegin() const { return header_->tail.load(std::memory_order_relaxed); }
+    const char* at(uint64_t pos) const { return data_ + (pos & (capacity_ - 1)); }
+    /// 读走n字节, 生产者在等待空间时返回true, 由调用方写eventfd
+    bool commit(size_t n)
+    {
+        header_->tail.store(header_->tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return header_->producerWaiting.load(std::memory_order_relaxed) != 0
+            && header_->producerWaiting.exchange(0) != 0;
+    }
+    /// 已处理到seen, 准备等待. 返回false表示期间又有数据写入, 应继续读
+    bool parkConsumer(uint64_t seen)
+    {
+        header_->consumerWaiting.store(1);
+        if(header_->head.load() != seen)
+        {
+            header_->consumerWaiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    ShmRingHeader* header_;
+    char* data_;
+    size_t capacity_;   // 2的幂, 页大小的整数倍
+};
+
+/**
+ * @brief 一对ShmRing所在的共享内存(memfd), 服务端create后把fd随握手传给客户端attach.
+ * 布局: [一页: 两个ShmRingHeader][环0数据][环1数据], 环0为客户端->服务端, 环1为服务端->客户端
+ */
+class ShmRegion : noncopyable
+{
+public:
+    static const uint32_t kMagic = 0x4d534852;    // "RHSM"
+    static const uint32_t kVersion = 1;
+
+    /// capacity向上取到2的幂和页大小的整数倍, 失败返回空
+    static std::unique_ptr<ShmRegion> create(size_t capacity);
+    /// 映射对端传来的memfd, 取得所有权; 失败时关闭memfd并返回空
+    static std::unique_ptr<ShmRegion> attach(int memfd, size_t capacity);
+    ~ShmRegion();
+
+    ShmRing ring(int index) const { return rings_[index]; }
+    size_t capacity() const { return capacity_; }
+
+    /// 服务端: 在刚accept的Unix域socket上发送环的大小, 并用SCM_RIGHTS附带memfd和两个eventfd
+    bool sendHandshake(int sockfd, int serverNotifyFd, int clientNotifyFd) const;
+    /// 客户端: 接收握手. 成功时取得两个eventfd的所有权; *again为true表示还没收到, 等可读后再试
+    static std::unique_ptr<ShmRegion> receiveHandshake(int sockfd, int* serverNotifyFd, int* clientNotifyFd,
+                                                       bool* again);
+
+private:
+    ShmRegion(int memfd, size_t capacity);
+    bool map();
+
+    int memfd_;
+    size_t capacity_;
+    void* headers_;
+    char* data_[2];     // 每个环2 * capacity_的连续虚拟地址
+    ShmRing rings_[2];
+};
+
+/**
+ * @brief ShmConnection交给MessageCallback的输入, 直接指向环里的数据不拷贝.
+ * 接口与Buffer的读取一侧相同; 回调返回后已retrieve的字节才归还给生产者,
+ * 没有retrieve的留在环里, 下次回调时与新数据一起交出. 因此一条完整消息不能大于环的容量
+ */
+class ShmBuffer : noncopyable
+{
+public:
+    ShmBuffer(const char* data, size_t len) : data_(data), readable_(len), retrieved_(0) {}
+
+    size_t readableBytes() const { return readable_ - retrieved_; }
+    const char* peek() const { return data_ + retrieved_; }
+    const char* beginWrite() const { return data_ + readable_; }
+
+    void retrieve(size_t len)
+    {
+        assert(len <= readableBytes());
+        retrieved_ += len;
+    }
+    void retrieveUntil(const char* end) { retrieve(end - peek()); }
+    void retrieveAll() { retrieved_ = readable_; }
+    std::string retrieveAsString(size_t len)
+    {
+        std::string result(peek(), len);
+        retrieve(len);
+        return result;
+    }
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+    StringPiece toStringPiece() const { return StringPiece(peek(), readableBytes()); }
+
+    const char* findByte(char c) const
+    {
+        const void* p = ::memchr(peek(), c, readableBytes());
+        return static_cast<const char*>(p);
+    }
+    const char* findEOL() const { return findByte('\n'); }
+
+    size_t retrieved() const { return retrieved_; }
+
+private:
+    const char* data_;
+    size_t readable_;
+    size_t retrieved_;
+};
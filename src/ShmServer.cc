@@ -0,0 +1,90 @@
+#include "ShmServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+ShmServer::ShmServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg)
+    : loop_(loop)
+    , ipPort_(listenAddr.toIpPort())
+    , name_(nameArg)
+    , acceptor_(new Acceptor(loop, listenAddr, false))
+    , threadPool_(new EventLoopThreadPool(loop, nameArg))
+    , ringCapacity_(kDefaultRingCapacity)
+    , started_(0)
+    , nextConnId_(1)
+{
+    if(!listenAddr.isUnix())
+    {
+        LOG_FATAL("ShmServer[%s] must listen on a unix domain address, got %s", name_.c_str(), ipPort_.c_str());
+    }
+    acceptor_->setNewConnectionCallback(std::bind(&ShmServer::newConnection, this,
+            std::placeholders::_1, std::placeholders::_2));
+}
+
+ShmServer::~ShmServer()
+{
+    for(auto& item : connections_)
+    {
+        ShmConnectionPtr conn(item.second);
+        item.second.reset();
+        conn->getLoop()->runInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+    }
+}
+
+void ShmServer::start()
+{
+    if(started_++ == 0)
+    {
+        threadPool_->start(threadInitCallback_);
+        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+    }
+}
+
+void ShmServer::newConnection(int sockfd, const InetAddress&)
+{
+    std::string connName = name_ + "-" + ipPort_ + "#" + std::to_string(nextConnId_++);
+    std::unique_ptr<ShmRegion> region = ShmRegion::create(ringCapacity_);
+    int serverNotifyFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int clientNotifyFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(!region || serverNotifyFd < 0 || clientNotifyFd < 0
+        || !region->sendHandshake(sockfd, serverNotifyFd, clientNotifyFd))
+    {
+        LOG_ERROR("ShmServer::newConnection [%s] setup failed, errno = %d (%s)",
+                connName.c_str(), errno, strerror(errno));
+        for(int fd : { sockfd, serverNotifyFd, clientNotifyFd })
+        {
+            if(fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+        return;
+    }
+    LOG_INFO("ShmServer::newConnection [%s] - new connection [%s]", name_.c_str(), connName.c_str());
+
+    EventLoop* ioLoop = threadPool_->getNextLoop();
+    // 服务端读环0(客户端->服务端), 写环1
+    ShmConnectionPtr conn = std::make_shared<ShmConnection>(ioLoop, connName, sockfd, std::move(region), 0,
+                                                             serverNotifyFd, clientNotifyFd);
+    connections_[connName] = conn;
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setCloseCallback(std::bind(&ShmServer::removeConnection, this, std::placeholders::_1));
+    ioLoop->runInLoop(std::bind(&ShmConnection::connectEstablished, conn));
+}
+
+void ShmServer::removeConnection(const ShmConnectionPtr& conn)
+{
+    loop_->runInLoop(std::bind(&ShmServer::removeConnectionInLoop, this, conn));
+}
+
+void ShmServer::removeConnectionInLoop(const ShmConnectionPtr& conn)
+{
+    LOG_INFO("ShmServer::removeConnectionInLoop [%s] - connection %s", name_.c_str(), conn->name().c_str());
+    connections_.erase(conn->name());
+    conn->getLoop()->queueInLoop(std::bind(&ShmConnection::connectDestroyed, conn));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Acceptor.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "ShmConnection.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+class EventLoop;
+
+/**
+ * @brief 共享内存连接的服务端, 在Unix域socket上监听.
+ * 每accept一个客户端, 创建一对ShmRing和两个eventfd, 经该socket用SCM_RIGHTS交给客户端(ShmClient),
+ * 之后数据只走共享内存, socket只用来发现对端关闭. 连接按轮询分给各loop
+ */
+class ShmServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+    static const size_t kDefaultRingCapacity = 1024 * 1024;
+
+    /// listenAddr须为InetAddress::unixDomain()
+    ShmServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg);
+    ~ShmServer();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    /// 每个方向环的大小, 向上取到2的幂. 单条消息不能超过它. Call before start().
+    void setRingCapacity(size_t capacity) { ringCapacity_ = capacity; }
+    /// Not thread safe.
+    void setConnectionCallback(const ShmConnectionCallback& cb) { connectionCallback_ = cb; }
+    /// Not thread safe.
+    void setMessageCallback(const ShmMessageCallback& cb) { messageCallback_ = cb; }
+
+    /// Thread safe, harmless to call it multiple times.
+    void start();
+
+private:
+    void newConnection(int sockfd, const InetAddress& peerAddr);
+    /// Thread safe. 在连接所属的ioLoop中调用
+    void removeConnection(const ShmConnectionPtr& conn);
+    void removeConnectionInLoop(const ShmConnectionPtr& conn);
+
+    EventLoop* loop_;
+    const std::string ipPort_;
+    const std::string name_;
+    std::unique_ptr<Acceptor> acceptor_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    size_t ringCapacity_;
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+    std::atomic_int started_;
+    int nextConnId_;
+    std::map<std::string, ShmConnectionPtr> connections_;   // 只在loop_中访问
+};
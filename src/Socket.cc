@@ -12,9 +12,10 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress& localaddr)
 {
-    if(0 != ::bind(sockfd_, (sockaddr*)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if(0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockLen()))
     {
-        LOG_FATAL("bind sockfd %d fail\n", sockfd_);
+        LOG_FATAL("bind %s sockfd %d fail, errno=%d (%s)\n",
+                localaddr.toIpPort().c_str(), sockfd_, errno, strerror(errno));
     }
 }
 void Socket::listen()
@@ -26,7 +27,7 @@ void Socket::listen()
 }
 int Socket::accept(InetAddress* peeraddr)
 {
-    sockaddr_in addr;
+    sockaddr_storage addr;     // 监听socket可能是AF_INET或AF_UNIX
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof addr);
     int connfd = ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
@@ -36,7 +37,7 @@ int Socket::accept(InetAddress* peeraddr)
         LOG_ERROR("Socket::accept failed: errno=%d (%s)", err, strerror(err));
         return -1;
     }
-    peeraddr->setSockAddr(addr);
+    *peeraddr = InetAddress((sockaddr*)&addr, len);
     LOG_INFO("Socket::accept succeeded: connfd=%d", connfd);
     return connfd;
 }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string.h>
+#include <string>
+
+/**
+ * @brief 不持有数据的只读字符串视图(C++11下代替std::string_view)
+ * 指向的内存由调用方保证有效，例如回调期间Buffer中的可读数据
+ */
+class StringPiece
+{
+public:
+    StringPiece() : data_(nullptr), size_(0) {}
+    StringPiece(const char* str) : data_(str), size_(strlen(str)) {}
+    StringPiece(const char* data, size_t size) : data_(data), size_(size) {}
+    StringPiece(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    void removePrefix(size_t n) { data_ += n; size_ -= n; }
+    void removeSuffix(size_t n) { size_ -= n; }
+    StringPiece substr(size_t pos, size_t n) const
+    {
+        return StringPiece(data_ + pos, n < size_ - pos ? n : size_ - pos);
+    }
+
+    std::string asString() const { return std::string(data_, size_); }
+
+    bool operator==(const StringPiece& other) const
+    {
+        return size_ == other.size_ && (size_ == 0 || memcmp(data_, other.data_, size_) == 0);
+    }
+    bool operator!=(const StringPiece& other) const { return !(*this == other); }
+
+private:
+    const char* data_;
+    size_t size_;
+};
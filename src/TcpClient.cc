@@ -0,0 +1,130 @@
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace
+{
+
+void defaultConnectionCallback(const TcpConnectionPtr&)
+{
+}
+
+void defaultMessageCallback(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+// TcpClient析构后连接的关闭由它收尾
+void removeDetachedConnection(const TcpConnectionPtr& conn)
+{
+    conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+}
+
+}
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    : loop_(loop)
+    , connector_(std::make_shared<Connector>(loop, serverAddr))
+    , name_(nameArg)
+    , connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + serverAddr.toIpPort()))
+    , connectionCallback_(defaultConnectionCallback)
+    , messageCallback_(defaultMessageCallback)
+    , retry_(false)
+    , connect_(false)
+    , nextConnId_(0)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+}
+
+TcpClient::~TcpClient()
+{
+    TcpConnectionPtr conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn.swap(connection_);
+    }
+    connect_ = false;
+    connector_->stop();
+    if(conn)
+    {
+        // 连接可能比TcpClient活得久, 换掉绑定了使用者对象的回调
+        conn->setConnectionCallback(defaultConnectionCallback);
+        conn->setMessageCallback(defaultMessageCallback);
+        conn->setWriteCompleteCallback(WriteCompleteCallback());
+        conn->setCloseCallback(removeDetachedConnection);
+        conn->shutdown();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect [%s] - connecting to %s",
+            name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+
+    // 与TcpServer相同, 连接对象从loop的连接池分配
+    loop_->addConnectionCount(1);
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(loop_->connectionPool()),
+        loop_,
+        ++nextConnId_,
+        connNamePrefix_,
+        sockfd,
+        InetAddress::localAddressOf(sockfd),
+        InetAddress::peerAddressOf(sockfd));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(
+        std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectionEstablished();
+}
+
+// 在连接所属loop中调用, 连接迁移过时不一定是loop_
+void TcpClient::removeConnection(const TcpConnectionPtr& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(connection_ == conn)
+        {
+            connection_.reset();
+        }
+    }
+    conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectionDestroyed, conn));
+    if(retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection [%s] - reconnecting to %s",
+                name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        loop_->runInLoop(std::bind(&Connector::restart, connector_));
+    }
+}
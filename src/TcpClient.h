@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "Connector.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "TcpConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class EventLoop;
+
+/**
+ * @brief 主动连接的TCP客户端, 一个TcpClient同时最多持有一条连接
+ * 连接对象与TcpServer产生的相同: 同样的回调类型和Buffer, 从所属loop的连接池分配,
+ * 计入loop的连接数. 把loop设为某个TcpServer的subloop即可与服务端连接共用线程
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    /// 应在loop线程中或loop退出后析构; 连接还被别处持有时, 关闭后由loop回收
+    ~TcpClient();
+
+    void connect();
+    /// 半关闭已建立的连接
+    void disconnect();
+    /// 放弃正在进行的连接和重试
+    void stop();
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    bool retry() const { return retry_; }
+    /// 已建立的连接断开后自动重连
+    void enableRetry() { retry_ = true; }
+    /// 连接失败后的重试间隔, 见Connector::setRetryDelay. Call before connect().
+    void setRetryDelay(int initMs, int maxMs) { connector_->setRetryDelay(initMs, maxMs); }
+
+    /// Set connection callback. Not thread safe.
+    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    /// Set message callback. Not thread safe.
+    void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+    /// Set write complete callback. Not thread safe.
+    void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+
+private:
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    const std::shared_ptr<const std::string> connNamePrefix_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    ConnectionId nextConnId_;       // 只在loop线程中访问, 每次重连加一
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;   // guarded by mutex_
+};
@@ -5,6 +5,9 @@
 #include "TcpConnection.h"
 
 #include <assert.h>
+#include <sys/uio.h>
+
+static const int kMaxWriteIov = 64;     // handleWrite一次writev最多的分段数
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -19,55 +22,154 @@ TcpConnection::TcpConnection(
         int sockfd, 
         const InetAddress& localAddr, 
         const InetAddress& peerAddr )
+        : TcpConnection(loop, 0, std::make_shared<const std::string>(name), sockfd, localAddr, peerAddr)
+{
+    getLoop()->addConnectionCount(1);   // TcpServer/TcpClient在分发时计数，直接构造的连接在这里计数
+}
+
+TcpConnection::TcpConnection(
+        EventLoop* loop,
+        ConnectionId id,
+        const std::shared_ptr<const std::string>& namePrefix,
+        int sockfd,
+        const InetAddress& localAddr,
+        const InetAddress& peerAddr )
         : loop_(CheckLoopNotNull(loop))
-        , name_(name)
+        , id_(id)
+        , namePrefix_(namePrefix)
         , state_(kConnecting)
         , reading_(true)
-        , socket_(new Socket(sockfd))
-        , channel_(new Channel(loop, sockfd))
+        , socket_(sockfd)
+        , channel_(loop, sockfd)
         , localAddr_(localAddr)
         , peerAddr_(peerAddr)
         , highWaterMark_(64*1024*1024)  // 64MB
+        , sliceBytes_(0)
+        , migrating_(false)
 {
-    channel_->setReadCallback(
+    channel_.setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
-    LOG_INFO("pConnection::ctor[%s] at %p fd = %d\n", name_.c_str(), this, sockfd);
-    socket_->setKeepAlive(true);
+    LOG_INFO("pConnection::ctor[%s#%llu] at %p fd = %d\n", namePrefix_->c_str(), (unsigned long long)id_, this, sockfd);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_DEBUG("TcpConnection::dtor[%s] at %p fd = %d state = %s\n", name_.c_str(), this, channel_->fd(), stateToString());
+    LOG_DEBUG("TcpConnection::dtor[%s] at %p fd = %d state = %d\n", name().c_str(), this, channel_.fd(), (int)state_);
+}
+
+std::string TcpConnection::name() const
+{
+    if(id_ == 0)
+    {
+        return *namePrefix_;
+    }
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%llu", static_cast<unsigned long long>(id_));
+    return *namePrefix_ + buf;
+}
+
+ConnectionStatsSnapshot TcpConnection::stats() const
+{
+    ConnectionStatsSnapshot s = stats_.snapshot(Timestamp::now().microSecondsSinceEpoch());
+    s.id = id_;
+    s.peer = peerAddr_;
+    return s;
 }
 
 void TcpConnection::send(const std::string& buf)
 {
     if(state_ == kConnected)
     {
-        if(loop_->isInLoopThread())     // 如果当前线程是IO线程，则直接发送
+        if(getLoop()->isInLoopThread())     // 如果当前线程是IO线程，则直接发送
         {
             sendInLoop(buf.c_str(), buf.size());
         }
         else
         {
-            loop_->runInLoop(
-                std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size())
-            );
+            // 拷贝一份数据，调用方的buf在任务执行时可能已经析构
+            TcpConnectionPtr self(shared_from_this());
+            std::lock_guard<std::mutex> lock(loopMutex_);   // 与迁移时切换loop_互斥
+            getLoop()->queueInLoop([self, buf]() {
+                self->sendInLoop(buf.c_str(), buf.size());
+            });
+        }
+    }
+}
+
+void TcpConnection::send(const void* data, size_t len)
+{
+    if(state_ == kConnected)
+    {
+        if(getLoop()->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            send(std::string(static_cast<const char*>(data), len));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer* buf)
+{
+    if(state_ == kConnected)
+    {
+        if(getLoop()->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            send(buf->retrieveAllAsString());
+        }
+    }
+}
+
+void TcpConnection::send(const SharedMessage& message)
+{
+    if(state_ == kConnected)
+    {
+        if(getLoop()->isInLoopThread())
+        {
+            sendMessageInLoop(message);
+        }
+        else
+        {
+            TcpConnectionPtr self(shared_from_this());
+            std::lock_guard<std::mutex> lock(loopMutex_);
+            getLoop()->queueInLoop([self, message]() {
+                self->sendMessageInLoop(message);
+            });
         }
     }
 }
 
 void TcpConnection::sendInLoop(const void* message, size_t len)
 {
-    ssize_t nwrote = 0;         // 已经发送的字节数
-    ssize_t remaining = len;    // 剩余未发送的字节数
-    bool faultError = false;    // 是否发生错误
+    stats_.addMessageOut();
+    if(migrating_)
+    {
+        // 源loop上排在切换之前的发送直接追加到待发送数据，
+        // 目标loop上的发送先暂存，attachInLoop时按顺序接在后面
+        if(getLoop()->isInLoopThread())
+        {
+            migrationBacklog_.append(static_cast<const char*>(message), len);
+        }
+        else
+        {
+            appendOutput(static_cast<const char*>(message), len);
+        }
+        return;
+    }
 
     // 之前调用过shutdown，不能发送
     if(state_ == kDisconnected)
@@ -75,53 +177,168 @@ void TcpConnection::sendInLoop(const void* message, size_t len)
         LOG_ERROR("disconnected, give up writing\n");
         return;
     }
-    else
+
+    size_t nwrote = 0;      // 已经发送的字节数
+    if(!writeIfIdle(message, len, &nwrote))
     {
-        if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0)    // 如果当前没有正在写，并且缓冲区没有数据
+        return;
+    }
+    size_t remaining = len - nwrote;    // 剩余未发送的字节数
+    if(remaining > 0)    // 如果没有错误，并且还有剩余数据没有写完
+    {   
+        // 保存剩余数据到缓冲区，给channel注册EPOLLOUT，等待下次写
+        // poller会监听到channel可写事件，然后调用handleWrite
+        // 用tcpconnection::handleWrite来继续写
+        size_t oldlen = outputBytes();
+        appendOutput(static_cast<const char*>(message) + nwrote, remaining);
+        outputQueued(oldlen, remaining);
+    }
+}
+
+void TcpConnection::sendMessageInLoop(const SharedMessage& message)
+{
+    if(migrating_)
+    {
+        sendInLoop(message->data(), message->size());   // 迁移期间很少见，按普通数据处理
+        return;
+    }
+    stats_.addMessageOut();
+    if(state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing\n");
+        return;
+    }
+
+    size_t nwrote = 0;
+    if(!writeIfIdle(message->data(), message->size(), &nwrote))
+    {
+        return;
+    }
+    size_t remaining = message->size() - nwrote;
+    if(remaining > 0)
+    {
+        // 只保存引用和偏移
+        size_t oldlen = outputBytes();
+        OutputSlice slice = { message, nwrote };
+        outputSlices_.push_back(slice);
+        sliceBytes_ += remaining;
+        outputQueued(oldlen, remaining);
+    }
+}
+
+// 没有待发送数据时直接写socket，返回false表示连接出错，不必再保存数据
+bool TcpConnection::writeIfIdle(const void* data, size_t len, size_t* nwrote)
+{
+    *nwrote = 0;
+    if(channel_.isWriting() || outputBytes() > 0)    // 正在写或还有数据没发完，只能排队
+    {
+        return true;
+    }
+    ssize_t n = ::write(channel_.fd(), data, len);     // 写入socket
+    stats_.addWrite(n);
+    if(n >= 0) // 写入成功
+    {
+        *nwrote = n;
+        getLoop()->stats().addBytesWritten(n);
+        if(static_cast<size_t>(n) == len)    // 写入完成
         {
-            nwrote = ::write(channel_->fd(), message, len);     // 写入socket
-            if(nwrote >= 0) // 写入成功
+            outputDrained();
+            if(writeCompleteCallback_)
             {
-                remaining = len - nwrote;
-                if(remaining == 0 && writeCompleteCallback_)    // 写入完成
-                {
-                    // 发送完成，不需要EPOLLOUT，再去执行handleWrite
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));      // 写入完成回调
-                }
+                // 发送完成，不需要EPOLLOUT，再去执行handleWrite
+                getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));      // 写入完成回调
             }
-            else    // 写入失败 nwrote < 0
+        }
+    }
+    else    // 写入失败 n < 0
+    {
+        if(errno != EWOULDBLOCK)    // EWOULDBLOCK表示缓冲区满了，可以继续写, 表示有真正的错误
+        {
+            LOG_ERROR("TcpConnection::sendInLoop");
+            if(errno == EPIPE || errno == ECONNRESET)    // 对端关闭了连接
             {
-                nwrote = 0;
-                if(errno != EWOULDBLOCK)    // EWOULDBLOCK表示缓冲区满了，可以继续写, 表示有真正的错误
-                {
-                    LOG_ERROR("TcpConnection::sendInLoop");
-                    if(errno == EPIPE || errno == ECONNRESET)    // 对端关闭了连接
-                    {
-                        faultError = true;
-                    }
-                }
+                return false;
             }
         }
     }
+    return true;
+}
 
-    if(!faultError && remaining > 0)    // 如果没有错误，并且还有剩余数据没有写完
-    {   
-        // 保存剩余数据到缓冲区，给channel注册EPOLLOUT，等待下次写
-        // poller会监听到channel可写事件，然后调用handleWrite
-        // 用tcpconnection::handleWrite来继续写
-        size_t oldlen = outputBuffer_.readableBytes();
-        if(oldlen + remaining >= highWaterMark_
-            && oldlen < highWaterMark_
-            && highWaterMarkCallback_)
+// 有共享消息在排队时，普通数据只能拷贝成新的分段接在后面，保证顺序
+void TcpConnection::appendOutput(const char* data, size_t len)
+{
+    if(outputSlices_.empty())
+    {
+        outputBuffer_.append(data, len);
+    }
+    else
+    {
+        OutputSlice slice = { std::make_shared<const std::string>(data, len), 0 };
+        outputSlices_.push_back(slice);
+        sliceBytes_ += len;
+    }
+}
+
+// 数据已加入待发送队列: 检查高水位，计入loop负载，注册EPOLLOUT
+void TcpConnection::outputQueued(size_t oldlen, size_t added)
+{
+    if(oldlen + added >= highWaterMark_ && oldlen < highWaterMark_)
+    {
+        stats_.enterHighWater(Timestamp::now().microSecondsSinceEpoch());
+        if(highWaterMarkCallback_)
+        {
+            getLoop()->queueInLoop(
+                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + added));
+        }
+    }
+    stats_.setOutputBytes(oldlen + added);
+    getLoop()->addPendingBytes(added);
+    if(!channel_.isWriting())
+    {
+        channel_.enableWriting();  // 注册channel的写事件，否则poller不会给channel通知可写事件EPOLLOUT
+    }
+}
+
+// 按顺序消耗已写出的数据: 先outputBuffer_，再各个分段
+void TcpConnection::retrieveOutput(size_t len)
+{
+    size_t fromBuffer = std::min(len, outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(fromBuffer);
+    len -= fromBuffer;
+    while(len > 0 && !outputSlices_.empty())
+    {
+        OutputSlice& slice = outputSlices_.front();
+        size_t left = slice.message->size() - slice.offset;
+        if(len < left)
         {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            slice.offset += len;
+            sliceBytes_ -= len;
+            break;
         }
-        outputBuffer_.append(static_cast<const char*>(message) + nwrote, remaining);
-        if(!channel_->isWriting())
+        len -= left;
+        sliceBytes_ -= left;
+        outputSlices_.pop_front();
+    }
+    size_t remaining = outputBytes();
+    stats_.setOutputBytes(remaining);
+    if(remaining < highWaterMark_ && stats_.inHighWater())
+    {
+        stats_.leaveHighWater(Timestamp::now().microSecondsSinceEpoch());   // 只在离开高水位时读时钟
+    }
+}
+
+// 待发送数据全部写进socket: 记录从最早未响应的请求到此刻的响应时间
+void TcpConnection::outputDrained()
+{
+    if(requestTime_.valid())
+    {
+        int64_t micros = Timestamp::now().microSecondsSinceEpoch() - requestTime_.microSecondsSinceEpoch();
+        stats_.addResponse(micros);
+        if(histograms_)
         {
-            channel_->enableWriting();  // 注册channel的写事件，否则poller不会给channel通知可写事件EPOLLOUT
+            histograms_->responseMicros.record(micros > 0 ? micros : 0);
         }
+        requestTime_ = Timestamp();
     }
 }
 
@@ -131,27 +348,103 @@ void TcpConnection::shutdown()
     if(state_ == kConnected)
     {
         setState(kDisconnecting);
-        // FIX ME: shared_from_this()?
-        loop_->runInLoop(
-            std::bind(&TcpConnection::shutdownInLoop, this));
+        std::lock_guard<std::mutex> lock(loopMutex_);
+        getLoop()->runInLoop(
+            std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
     }
 }
 
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting())     // 如果没有正在写，则直接关闭写端
+    if(migrating_)
+    {
+        return;     // attachInLoop时检查kDisconnecting再关闭写端
+    }
+    if (!channel_.isWriting())     // 如果没有正在写，则直接关闭写端
     {
       // we are not writing
-      socket_->shutdownWrite();
+      socket_.shutdownWrite();
+    }
+}
+
+void TcpConnection::migrateTo(EventLoop* targetLoop)
+{
+    getLoop()->runInLoop(
+        std::bind(&TcpConnection::migrateInLoop, shared_from_this(), targetLoop));
+}
+
+/**
+ * 迁移分两步:
+ * 1. 源loop: 把channel从poller中摘下，在loopMutex_保护下把loop_切换到目标loop，
+ *    此后跨线程的send都投递到目标loop；再往源loop队尾放一个任务
+ * 2. 源loop队列中切换前投递的任务执行完后，队尾任务把attachInLoop交给目标loop，
+ *    目标loop把暂存的数据接到outputBuffer_后面，重新注册channel
+ * 从摘下到重新注册之间连接只被一个线程访问，缓冲区跟随连接对象本身，无需拷贝
+ */
+void TcpConnection::migrateInLoop(EventLoop* targetLoop)
+{
+    EventLoop* source = getLoop();
+    if(!source->isInLoopThread())
+    {
+        // 已被并发的另一次迁移挪走，交给新的owner处理
+        source->runInLoop(
+            std::bind(&TcpConnection::migrateInLoop, shared_from_this(), targetLoop));
+        return;
+    }
+    if(state_ != kConnected || migrating_ || targetLoop == source)
+    {
+        return;
+    }
+    LOG_INFO("TcpConnection::migrateInLoop [%s] fd = %d from %p to %p\n",
+            name().c_str(), channel_.fd(), source, targetLoop);
+
+    migrating_ = true;
+    channel_.disableAll();
+    channel_.remove();
+    channel_.set_revents(0);   // 本轮activeChannels_中若还有它，不再处理
+    source->addPendingBytes(-static_cast<int64_t>(outputBytes()));
+    source->addConnectionCount(-1);
+    targetLoop->addConnectionCount(1);
+    {
+        std::lock_guard<std::mutex> lock(loopMutex_);
+        loop_ = targetLoop;
+    }
+    // 当前可能还在处理本轮的活跃channel，channel对象要到下一步才能交给目标loop
+    TcpConnectionPtr self(shared_from_this());
+    source->queueInLoop([self, targetLoop]() {
+        self->channel_.setOwnerLoop(targetLoop);
+        targetLoop->queueInLoop(std::bind(&TcpConnection::attachInLoop, self));
+    });
+}
+
+void TcpConnection::attachInLoop()
+{
+    appendOutput(migrationBacklog_.peek(), migrationBacklog_.readableBytes());
+    migrationBacklog_.retrieveAll();
+    migrating_ = false;
+    getLoop()->addPendingBytes(outputBytes());
+
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    channel_.enableReading();
+    if(outputBytes() > 0)
+    {
+        channel_.enableWriting();
+    }
+    else if(state_ == kDisconnecting)
+    {
+        shutdownInLoop();
     }
 }
 
 void TcpConnection::connectionEstablished()
 {
     setState(kConnected);
-    channel_->tie(shared_from_this());          // 防止channel_被析构, tie_是一个weakptr
-    channel_->enableReading();                  // 注册channel的读事件，否则poller不会给channel通知可读事件EPOLLIN
+    channel_.tie(shared_from_this());          // 防止channel_被析构, tie_是一个weakptr
+    channel_.enableReading();                  // 注册channel的读事件，否则poller不会给channel通知可读事件EPOLLIN
     connectionCallback_(shared_from_this());    // 连接建立，执行回调
 }
 
@@ -160,20 +453,40 @@ void TcpConnection::connectionDestroyed()
     if(state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll();                     // 禁用channel的读写事件
+        channel_.disableAll();                     // 禁用channel的读写事件
         connectionCallback_(shared_from_this());    // 连接断开，执行回调
     }
 
-    channel_->remove();                             // 将channel从poller中移除
+    channel_.remove();                             // 将channel从poller中移除
+    if(stats_.inHighWater())
+    {
+        stats_.leaveHighWater(Timestamp::now().microSecondsSinceEpoch());
+    }
+    if(histograms_)
+    {
+        histograms_->highWaterMicros.record(stats_.highWaterMicros());
+        histograms_->bytesIn.record(stats_.bytesIn());
+        histograms_->bytesOut.record(stats_.bytesOut());
+    }
+    getLoop()->addPendingBytes(-static_cast<int64_t>(outputBytes()));
+    getLoop()->addConnectionCount(-1);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &saveErrno);
+    stats_.addRead(n);
     if(n > 0)
     {
+        getLoop()->stats().addBytesRead(n);
+        if(!requestTime_.valid())
+        {
+            requestTime_ = receiveTime;
+        }
+        stats_.addMessageIn();
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        stats_.setInputBytes(inputBuffer_.readableBytes());
     }
     else if(n == 0)     // 对方关闭连接
     {
@@ -188,19 +501,38 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 }
 void TcpConnection::handleWrite()
 {
-    if(channel_->isWriting())
+    if(channel_.isWriting())
     {
-        int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        // outputBuffer_和排队的共享消息一起writev出去
+        iovec vec[kMaxWriteIov];
+        int iovcnt = 0;
+        if(outputBuffer_.readableBytes() > 0)
+        {
+            vec[iovcnt].iov_base = const_cast<char*>(outputBuffer_.peek());
+            vec[iovcnt].iov_len = outputBuffer_.readableBytes();
+            ++iovcnt;
+        }
+        for(size_t i = 0; i < outputSlices_.size() && iovcnt < kMaxWriteIov; ++i)
+        {
+            const OutputSlice& slice = outputSlices_[i];
+            vec[iovcnt].iov_base = const_cast<char*>(slice.message->data() + slice.offset);
+            vec[iovcnt].iov_len = slice.message->size() - slice.offset;
+            ++iovcnt;
+        }
+        ssize_t n = ::writev(channel_.fd(), vec, iovcnt);
+        stats_.addWrite(n);
         if(n > 0)
         {
-            outputBuffer_.retrieve(n);
-            if(outputBuffer_.readableBytes() == 0)
+            retrieveOutput(n);
+            getLoop()->addPendingBytes(-n);
+            getLoop()->stats().addBytesWritten(n);
+            if(outputBytes() == 0)
             {
-                channel_->disableWriting();
+                channel_.disableWriting();
+                outputDrained();
                 if(writeCompleteCallback_)      // 如果设置了回调函数，则调用回调函数
                 {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
                 }
                 if(state_ == kDisconnecting)
                 {
@@ -215,15 +547,15 @@ void TcpConnection::handleWrite()
     }
     else
     {
-        LOG_ERROR("TcpConnection::handleWrite fd = %d is down, no more writing\n", channel_->fd());
+        LOG_ERROR("TcpConnection::handleWrite fd = %d is down, no more writing\n", channel_.fd());
     }
 }
 
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd = %d state = %s\n", channel_->fd(), to_string(state_).c_str());
+    LOG_INFO("TcpConnection::handleClose fd = %d state = %s\n", channel_.fd(), to_string(state_).c_str());
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr);   // 通知连接建立
@@ -234,7 +566,7 @@ void TcpConnection::handleError()
     int optval;
     socklen_t optlen = sizeof(optval);
     int err = 0;
-    if(::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if(::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -242,5 +574,5 @@ void TcpConnection::handleError()
     {
         err = optval;    
     }
-    LOG_ERROR("TcpConnection::handleError name = [%s] - SO_ERROR = %d\n", name_.c_str(), err);
+    LOG_ERROR("TcpConnection::handleError name = [%s] - SO_ERROR = %d\n", name().c_str(), err);
 }
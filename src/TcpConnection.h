@@ -1,18 +1,21 @@
 #pragma once
 
 #include "Callbacks.h"
+#include "Channel.h"
+#include "ConnectionStats.h"
 #include "noncopyable.h"
 #include "Buffer.h"
 #include "InetAddress.h"
+#include "Socket.h"
 #include "Timestamp.h"
 
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * @brief TcpConnection represents a TCP connection
@@ -30,15 +33,38 @@ private:
 
 public:
     TcpConnection(EventLoop* loop, const std::string& name, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr);
+    /// 名字为 namePrefix#id，只在调用name()时才格式化
+    /// 不计入loop的connectionCount，由选定loop的调用方计数，connectionDestroyed时减去
+    TcpConnection(EventLoop* loop, ConnectionId id, const std::shared_ptr<const std::string>& namePrefix,
+                  int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr);
     ~TcpConnection();
 
-    EventLoop* getLoop() const { return loop_; }
-    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }     // 迁移后会变化
+    ConnectionId id() const { return id_; }
+    std::string name() const;
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
     bool connected() const { return state_ == kConnected; }
     void send(const std::string& buf);
+    /// 在loop线程中调用时不拷贝; 其他线程调用时拷贝一份再排队. Thread safe.
+    void send(const void* data, size_t len);
+    /// 发送buf中的全部可读数据并清空buf. Thread safe.
+    void send(Buffer* buf);
+    /// 发送共享的只读消息，排队时只保存引用不拷贝数据. Thread safe.
+    void send(const SharedMessage& message);
     void shutdown();
+    /// outputBuffer_和排队的共享消息中还没写进socket的字节数. 只在loop线程中调用
+    size_t outputBytes() const { return outputBuffer_.readableBytes() + sliceBytes_; }
+    void setTcpNoDelay(bool on) { socket_.setTcpNoDelay(on); }
+
+    /// 本连接的收发统计. Thread safe.
+    ConnectionStatsSnapshot stats() const;
+    /// 响应时间和连接销毁时的整条连接统计记入h，由TcpServer在连接建立前设置
+    void setStatsHistograms(const std::shared_ptr<ConnectionHistograms>& h) { histograms_ = h; }
+
+    /// 将连接迁移到targetLoop上继续收发. Thread safe.
+    /// 仅对已建立的连接生效，迁移前后发送的数据保持顺序
+    void migrateTo(EventLoop* targetLoop);
 
     // set callback
     void setConnectionCallback(const ConnectionCallback& cb){
@@ -58,6 +84,10 @@ public:
         closeCallback_ = cb;
     }
 
+    /// 协议层挂在连接上的状态，例如HttpContext. 只在连接所属loop中访问
+    void setContext(const std::shared_ptr<void>& context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+
     // connecton ctl
     void connectionEstablished();
     void connectionDestroyed();
@@ -70,15 +100,24 @@ private:
     void handleClose();
     void handleError();
     void sendInLoop(const void* message, size_t len);
+    void sendMessageInLoop(const SharedMessage& message);
+    bool writeIfIdle(const void* data, size_t len, size_t* nwrote);
+    void appendOutput(const char* data, size_t len);
+    void outputQueued(size_t oldlen, size_t added);
+    void retrieveOutput(size_t len);
+    void outputDrained();
     void shutdownInLoop();
+    void migrateInLoop(EventLoop* targetLoop);
+    void attachInLoop();
 
-    EventLoop* loop_;
-    const std::string name_;
+    std::atomic<EventLoop*> loop_;
+    const ConnectionId id_;
+    const std::shared_ptr<const std::string> namePrefix_;  // 同一TcpServer的连接共用
     std::atomic_int state_;
     bool reading_;
 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    Socket socket_;     // 与连接对象同一块内存，在channel_之前构造
+    Channel channel_;
 
     const InetAddress localAddr_;   // 当前主机
     const InetAddress peerAddr_;    // 客户端主机
@@ -86,4 +125,24 @@ private:
     size_t highWaterMark_;
     Buffer inputBuffer_;
     Buffer outputBuffer_;
+
+    // 排在outputBuffer_之后的共享消息，非空时新发送的数据也要排在它们后面
+    struct OutputSlice
+    {
+        SharedMessage message;
+        size_t offset;      // 已发送的字节数
+    };
+    std::deque<OutputSlice> outputSlices_;
+    size_t sliceBytes_;     // outputSlices_中待发送的字节数
+
+    std::shared_ptr<void> context_;
+
+    ConnectionStats stats_;
+    std::shared_ptr<ConnectionHistograms> histograms_;
+    Timestamp requestTime_;     // 最早一次还没有写完响应的读事件时间，无效表示没有
+
+    // 迁移: loop_切换期间由loopMutex_保护，保证跨线程投递的任务不乱序
+    std::mutex loopMutex_;
+    std::atomic_bool migrating_;    // 已从源loop摘下，还未挂到目标loop
+    Buffer migrationBacklog_;       // 迁移期间目标loop上收到的待发送数据
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "TcpServer.h"
 #include <assert.h>
 #include <string.h>
+#include <unistd.h>
 
 EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -23,7 +24,12 @@ TcpServer::TcpServer(EventLoop* loop,
             threadPool_(new EventLoopThreadPool(loop_, name_)),
             connectionCallback_(),
             messageCallback_(),
-            nextConnId_(1)
+            started_(0),
+            connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_)),
+            pendingCreations_(std::make_shared<PendingCreations>()),
+            steerByIncomingCpu_(false),
+            rebalanceInterval_(0.0),
+            rebalanceThreshold_(2)
 {
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
             std::placeholders::_1, std::placeholders::_2)); // this的tcpserver的newconnection
@@ -33,10 +39,18 @@ TcpServer::~TcpServer()
 {
   LOG_INFO("TcpServer::~TcpServer [%s] destructing", name_.c_str());
 
-  for (auto& item : connections_)
   {
-    TcpConnectionPtr conn(item.second);
-    item.second.reset();
+    // 还在ioLoop队列中的创建任务取消掉: 关闭sockfd，撤销分发时的计数
+    std::lock_guard<std::mutex> lock(pendingCreations_->mutex);
+    for (const auto& entry : pendingCreations_->fds)
+    {
+      ::close(entry.first);
+      entry.second->addConnectionCount(-1);
+    }
+    pendingCreations_->fds.clear();
+  }
+  for (TcpConnectionPtr& conn : registry_.clear())
+  {
     conn->getLoop()->runInLoop(
       std::bind(&TcpConnection::connectionDestroyed, conn));
   }
@@ -52,62 +66,228 @@ void TcpServer::start()
 {
     if(started_++ == 0) // start多次
     {
-        threadPool_->start();
+        threadPool_->start(threadInitCallback_);
+        for(EventLoop* ioLoop : threadPool_->getAllLoops())
+        {
+            histograms_[ioLoop] = std::make_shared<ConnectionHistograms>();
+        }
+        if(rebalanceInterval_ > 0)
+        {
+            loop_->runEvery(rebalanceInterval_, std::bind(&TcpServer::rebalance, this));
+        }
     }
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
     LOG_INFO("sockfd = %d", sockfd);
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++ nextConnId_;
-    std::string connName = name_ + buf; // name_是TcpServer的名字，buf是连接id
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s",
-            name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    EventLoop *ioLoop = selectLoop(sockfd, peerAddr);
+    ioLoop->addConnectionCount(1);      // 分发时就计入，连续到来的连接看到的是最新负载
+    ConnectionId id = registry_.allocate();     // 连接名只在需要时由TcpConnection::name()格式化
+    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s#%llu] from %s",
+            name_.c_str(), connNamePrefix_->c_str(), (unsigned long long)id, peerAddr.toIpPort().c_str());
     
-    // 通过sockfd获取绑定的本机ip和port
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if(::getsockname(sockfd, (sockaddr*)&local, &addrlen) == -1)
+    // 通过sockfd获取绑定的本机地址
+    InetAddress localAddr = InetAddress::localAddressOf(sockfd);
+    assert(sockfd >= 0);
+    if(threadPool_->hasCpuAffinity() && ioLoop != loop_)
     {
-        LOG_ERROR("TcpServer::newConnection getsockname error");
+        // 连接对象在绑核的subloop线程上分配，内存落在本地NUMA节点
+        {
+            std::lock_guard<std::mutex> lock(pendingCreations_->mutex);
+            pendingCreations_->fds[sockfd] = ioLoop;
+        }
+        ioLoop->queueInLoop(std::bind(&TcpServer::createPendingConnection, pendingCreations_, this,
+                ioLoop, id, sockfd, localAddr, peerAddr));
     }
-    InetAddress localAddr(local);
-    assert(sockfd >= 0);
-    TcpConnectionPtr conn(
-        new TcpConnection(ioLoop,
-                          connName,
-                          sockfd,
-                          localAddr,
-                          peerAddr)
-    );
-    connections_[connName] = conn;
+    else
+    {
+        TcpConnectionPtr conn = createConnection(ioLoop, id, sockfd, localAddr, peerAddr);
+        if(conn)
+        {
+            ioLoop->runInLoop(std::bind(&TcpConnection::connectionEstablished, conn));
+        }
+    }
+}
+
+void TcpServer::createPendingConnection(const std::shared_ptr<PendingCreations>& pending, TcpServer* server,
+                                        EventLoop* ioLoop, ConnectionId id, int sockfd,
+                                        const InetAddress& localAddr, const InetAddress& peerAddr)
+{
+    TcpConnectionPtr conn;
+    {
+        // 持锁创建，~TcpServer要么等创建完成后从注册表清理，要么先取消掉sockfd
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        if(pending->fds.erase(sockfd) == 0)
+        {
+            return;
+        }
+        conn = server->createConnection(ioLoop, id, sockfd, localAddr, peerAddr);
+    }
+    if(conn)
+    {
+        conn->connectionEstablished();  // 用户回调不在锁内执行
+    }
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop, ConnectionId id, int sockfd,
+                                 const InetAddress& localAddr, const InetAddress& peerAddr)
+{
+    // 连接对象、Socket、Channel和shared_ptr控制块一次分配，内存来自ioLoop的池，析构后回池复用
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(ioLoop->connectionPool()),
+        ioLoop,
+        id,
+        connNamePrefix_,
+        sockfd,
+        localAddr,
+        peerAddr);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    auto it = histograms_.find(ioLoop);
+    if(it != histograms_.end())
+    {
+        conn->setStatsHistograms(it->second);
+    }
     // 设置连接关闭的回调函数
     conn->setCloseCallback(
         std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-    // 直接调用TcpConnection::connectionEstablished
-    ioLoop->runInLoop(
-        std::bind(&TcpConnection::connectionEstablished, conn));
+    // 先于connectionEstablished，关闭时一定能找到
+    if(!registry_.attach(id, conn))
+    {
+        // id已失效(注册表已清空)，连接不会被任何人管理: 释放conn，由Socket析构关闭sockfd
+        LOG_ERROR("TcpServer::createConnection [%s] - connection [%s#%llu] fd = %d no longer registered, closing",
+                name_.c_str(), connNamePrefix_->c_str(), (unsigned long long)id, sockfd);
+        ioLoop->addConnectionCount(-1);
+        return TcpConnectionPtr();
+    }
+    return conn;
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr& conn)
+EventLoop* TcpServer::selectLoop(int sockfd, const InetAddress& peerAddr)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+#ifdef SO_INCOMING_CPU
+    if(steerByIncomingCpu_)
+    {
+        int cpu = -1;
+        socklen_t len = sizeof cpu;
+        if(::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0 && cpu >= 0)
+        {
+            EventLoop* loop = threadPool_->getLoopForCpu(cpu);
+            if(loop != nullptr)
+            {
+                return loop;
+            }
+        }
+    }
+#endif
+    return threadPool_->getNextLoop(peerAddr);
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
+// 注册表线程安全，直接在ioLoop中移除，不必再绕道baseLoop
+void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - %s", conn->name().c_str(), conn->peerAddress().toIpPort().c_str());
-    size_t n = connections_.erase(conn->name());
-    (void)n;
+    LOG_INFO("TcpServer::removeConnection [%s] - connection [%s#%llu]",
+            name_.c_str(), connNamePrefix_->c_str(), (unsigned long long)conn->id());
+    registry_.remove(conn->id());
     EventLoop* ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectionDestroyed, conn));
-}
\ No newline at end of file
+}
+
+std::vector<ConnectionStatsSnapshot> TcpServer::connectionStats() const
+{
+    std::vector<ConnectionStatsSnapshot> stats;
+    registry_.forEach([&stats](const TcpConnectionPtr& conn) {
+        stats.push_back(conn->stats());
+        return true;
+    });
+    return stats;
+}
+
+ConnectionHistograms::Snapshot TcpServer::connectionHistograms() const
+{
+    ConnectionHistograms::Snapshot total;
+    for(const auto& entry : histograms_)
+    {
+        total.merge(entry.second->snapshot());
+    }
+    return total;
+}
+
+void TcpServer::rebalance()
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    if(loops.size() < 2)
+    {
+        return;
+    }
+    EventLoop* busiest = loops[0];
+    EventLoop* idlest = loops[0];
+    for(EventLoop* loop : loops)
+    {
+        if(loop->connectionCount() > busiest->connectionCount())
+        {
+            busiest = loop;
+        }
+        if(loop->connectionCount() < idlest->connectionCount())
+        {
+            idlest = loop;
+        }
+    }
+    int diff = busiest->connectionCount() - idlest->connectionCount();
+    if(diff <= rebalanceThreshold_)
+    {
+        return;
+    }
+    // 移走一半差值，迁移是异步的，计数在下一次检查时才准确
+    int toMove = diff / 2;
+    LOG_INFO("TcpServer::rebalance [%s] - move %d connections from %p to %p",
+            name_.c_str(), toMove, busiest, idlest);
+    registry_.forEach([&](const TcpConnectionPtr& conn) {
+        if(conn->getLoop() == busiest && conn->connected())
+        {
+            conn->migrateTo(idlest);
+            --toMove;
+        }
+        return toMove > 0;
+    });
+}
+
+void TcpServer::broadcast(const std::vector<TcpConnectionPtr>& conns, const SharedMessage& message)
+{
+    std::map<EventLoop*, std::vector<TcpConnectionPtr>> groups;
+    for(const TcpConnectionPtr& conn : conns)
+    {
+        groups[conn->getLoop()].push_back(conn);
+    }
+    broadcastGroups(groups, message);
+}
+
+void TcpServer::broadcast(const SharedMessage& message)
+{
+    std::map<EventLoop*, std::vector<TcpConnectionPtr>> groups;
+    registry_.forEach([&](const TcpConnectionPtr& conn) {
+        groups[conn->getLoop()].push_back(conn);
+        return true;
+    });
+    broadcastGroups(groups, message);
+}
+
+void TcpServer::broadcastGroups(std::map<EventLoop*, std::vector<TcpConnectionPtr>>& groups,
+                                const SharedMessage& message)
+{
+    for(auto& group : groups)
+    {
+        // 分组后连接若被迁移，send会转投到新的loop，不会丢也不会乱序
+        std::shared_ptr<std::vector<TcpConnectionPtr>> conns =
+            std::make_shared<std::vector<TcpConnectionPtr>>(std::move(group.second));
+        group.first->runInLoop([conns, message]() {
+            for(const TcpConnectionPtr& conn : *conns)
+            {
+                conn->send(message);
+            }
+        });
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "Acceptor.h"
 #include "Callbacks.h"
+#include "ConnectionRegistry.h"
 #include "const.h"
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
@@ -12,6 +13,10 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 class TcpServer : noncopyable
 {
@@ -35,8 +40,16 @@ public:
         Option option = kNoReusePort);
     ~TcpServer();
 
+    const std::string& ipPort() const { return ipPort_; }
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
     /// Set the number of threads for handling input.
     void setThreadNum(int numThreads);
+    /// 新连接分发到subloop的策略，默认round-robin. Call before start().
+    void setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy) {
+        threadPool_->setDispatchPolicy(policy);
+    }
     void setThreadInitCallback(const ThreadInitCallback& cb) { 
         threadInitCallback_ = cb; 
     }
@@ -53,6 +66,43 @@ public:
         writeCompleteCallback_ = cb; 
     }
 
+    /// subloop之间互相窃取EventLoop::queueStealable提交的任务. Call before start().
+    void setWorkStealing(bool on) { threadPool_->setWorkStealing(on); }
+    /// 第i个subloop线程绑定到cpuSets[i % cpuSets.size()]，新连接对象改在所属subloop线程中创建，
+    /// 连接和缓冲区的内存按first-touch分配在该线程的本地NUMA节点. Call before start().
+    void setThreadCpuSets(const std::vector<std::vector<int>>& cpuSets) {
+        threadPool_->setThreadCpuSets(cpuSets);
+    }
+    /// 按SO_INCOMING_CPU把新连接交给绑定了网卡队列所在cpu的subloop，
+    /// 没有对应的subloop时按分发策略选择. 需配合setThreadCpuSets使用
+    void setSteerByIncomingCpu(bool on) { steerByIncomingCpu_ = on; }
+
+    /// 每隔interval秒比较各subloop的连接数，最多与最少相差超过threshold时
+    /// 从最忙的loop迁移连接到最闲的loop. interval <= 0 关闭. Call before start().
+    void setRebalance(double interval, int threshold = 2) {
+        rebalanceInterval_ = interval;
+        rebalanceThreshold_ = threshold;
+    }
+
+    /// 把conn迁移到targetLoop，targetLoop应取自threadPool()->getAllLoops(). Thread safe.
+    void migrate(const TcpConnectionPtr& conn, EventLoop* targetLoop) {
+        conn->migrateTo(targetLoop);
+    }
+
+    /// 按id查找连接，id已失效返回空指针. Thread safe.
+    TcpConnectionPtr getConnection(ConnectionId id) const { return registry_.find(id); }
+    size_t numConnections() const { return registry_.size(); }
+
+    /// 当前所有连接的收发统计，用来找出拖慢尾延迟的慢客户端或异常客户端. Thread safe.
+    std::vector<ConnectionStatsSnapshot> connectionStats() const;
+    /// 各subloop的连接统计直方图合并后的结果. Thread safe, valid after calling start()
+    ConnectionHistograms::Snapshot connectionHistograms() const;
+
+    /// 把同一份消息发给conns，按所属loop分组，每个loop只投递一个任务，消息不拷贝. Thread safe.
+    void broadcast(const std::vector<TcpConnectionPtr>& conns, const SharedMessage& message);
+    /// 发给当前所有连接. Thread safe.
+    void broadcast(const SharedMessage& message);
+
     /// valid after calling start()
     std::shared_ptr<EventLoopThreadPool> threadPool(){ 
         return threadPool_; 
@@ -65,12 +115,28 @@ public:
 private:
     /// Not thread safe, but in loop
     void newConnection(int sockfd, const InetAddress& peerAddr);
-    /// Thread safe.
+    /// 在ioLoop或baseLoop中创建TcpConnection并放入注册表，由调用方connectionEstablished
+    /// id已失效时关闭sockfd并返回空指针
+    TcpConnectionPtr createConnection(EventLoop* ioLoop, ConnectionId id, int sockfd,
+                                      const InetAddress& localAddr, const InetAddress& peerAddr);
+
+    /// 已分发到ioLoop、还没创建TcpConnection的sockfd; 任务持有shared_ptr，TcpServer析构后也能安全访问
+    struct PendingCreations
+    {
+        std::mutex mutex;
+        std::unordered_map<int, EventLoop*> fds;    // sockfd -> ioLoop，TcpServer析构时清空
+    };
+    /// 在ioLoop中执行，sockfd已不在pending中(TcpServer已析构)时直接返回
+    static void createPendingConnection(const std::shared_ptr<PendingCreations>& pending, TcpServer* server,
+                                        EventLoop* ioLoop, ConnectionId id, int sockfd,
+                                        const InetAddress& localAddr, const InetAddress& peerAddr);
+    EventLoop* selectLoop(int sockfd, const InetAddress& peerAddr);
+    /// Thread safe. 在连接所属的ioLoop中调用
     void removeConnection(const TcpConnectionPtr& conn);
-    /// Not thread safe, but in loop
-    void removeConnectionInLoop(const TcpConnectionPtr& conn);
-    using ConnectionMap = std::unordered_map<std::string, std::shared_ptr<TcpConnection>>;
-   
+    /// in loop, 定时检查subloop负载
+    void rebalance();
+    void broadcastGroups(std::map<EventLoop*, std::vector<TcpConnectionPtr>>& groups,
+                         const SharedMessage& message);
     EventLoop *loop_;
     const std::string ipPort_;
     const std::string name_;
@@ -78,6 +144,13 @@ private:
     std::shared_ptr<EventLoopThreadPool> threadPool_;
 
     std::atomic_int started_;
-    int nextConnId_;
-    ConnectionMap connections_; // connId -> conn
+    const std::shared_ptr<const std::string> connNamePrefix_;  // 连接名 name_-ipPort_#id 的前缀
+    ConnectionRegistry registry_;   // connId -> conn
+    const std::shared_ptr<PendingCreations> pendingCreations_;
+    // 每个loop一份直方图，start()之后只读; 连接持有shared_ptr，可以比TcpServer活得长
+    std::unordered_map<EventLoop*, std::shared_ptr<ConnectionHistograms>> histograms_;
+
+    bool steerByIncomingCpu_;
+    double rebalanceInterval_;
+    int rebalanceThreshold_;
 };
\ No newline at end of file
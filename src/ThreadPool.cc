@@ -0,0 +1,241 @@
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+#include "ThreadPool.h"
+
+// worker线程中记录自己的队列下标，worker里再提交的任务放进自己的队列
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local size_t t_workerIndex = 0;
+
+ThreadPool::ThreadPool(const std::string& nameArg)
+    : name_(nameArg),
+      numThreads_(0),
+      maxQueueSize_(kDefaultMaxQueueSize),
+      running_(false),
+      next_(0),
+      queued_(0)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    if(running_)
+    {
+        stop();
+    }
+}
+
+void ThreadPool::start()
+{
+    running_ = true;
+    if(numThreads_ <= 0)
+    {
+        numThreads_ = 1;
+    }
+    for(int i = 0; i < numThreads_; ++i)
+    {
+        queues_.push_back(std::unique_ptr<WorkStealingQueue<Task>>(new WorkStealingQueue<Task>));
+    }
+    for(int i = 0; i < numThreads_; ++i)
+    {
+        char buf[name_.size() + 32];
+        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
+        threads_.push_back(std::unique_ptr<Thread>(
+            new Thread(std::bind(&ThreadPool::workerFunc, this, i), buf)));
+        threads_.back()->start();
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    notEmpty_.notify_all();
+    for(auto& thr : threads_)
+    {
+        thr->join();
+    }
+}
+
+bool ThreadPool::run(Task task)
+{
+    return push(std::move(task));
+}
+
+bool ThreadPool::push(Task task)
+{
+    if(queues_.empty())
+    {
+        task();     // 未启动，直接执行
+        return true;
+    }
+    {
+        // 检查上限和计数在同一把锁内完成，先占位再入队，worker取走时计数不会减到0以下
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return false;   // 已stop()，没有worker会再取任务
+        }
+        if(maxQueueSize_ > 0 && queued_ >= maxQueueSize_)
+        {
+            return false;
+        }
+        ++queued_;
+    }
+    size_t index = (t_pool == this) ? t_workerIndex : next_++ % queues_.size();
+    queues_[index]->push(std::move(task));
+    notEmpty_.notify_one();
+    return true;
+}
+
+bool ThreadPool::submit(EventLoop* loop, Task task, Task done)
+{
+    return push([this, loop, task, done]() {
+        task();
+        complete(loop, done);
+    });
+}
+
+bool ThreadPool::submit(const TcpConnectionPtr& conn, Task task, Task done)
+{
+    EventLoop* loop = conn->getLoop();
+    std::shared_ptr<LoopState> state = loopState(loop);
+    Sequence& sequence = state->sequences[conn.get()];
+    uint64_t seq = sequence.nextSubmit++;
+    bool ok = push([this, loop, state, conn, seq, task, done]() {
+        task();
+        complete(loop, std::bind(&ThreadPool::completeInOrder, state, conn, seq, done));
+    });
+    if(!ok)
+    {
+        // 回退序号，否则后面的完成回调会一直等这个序号
+        --sequence.nextSubmit;
+        if(sequence.nextSubmit == sequence.nextComplete)
+        {
+            state->sequences.erase(conn.get());
+        }
+    }
+    return ok;
+}
+
+void ThreadPool::workerFunc(size_t index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    for(;;)
+    {
+        Task task;
+        if(take(index, task))
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this]() { return !running_ || queued_ > 0; });
+        if(!running_ && queued_ == 0)
+        {
+            break;
+        }
+    }
+    t_pool = nullptr;
+}
+
+// 先取自己的队列，再依次从其它worker窃取
+bool ThreadPool::take(size_t index, Task& task)
+{
+    bool found = queues_[index]->pop(task);
+    for(size_t i = 1; !found && i < queues_.size(); ++i)
+    {
+        found = queues_[(index + i) % queues_.size()]->steal(task);
+    }
+    if(found)
+    {
+        --queued_;
+    }
+    return found;
+}
+
+std::shared_ptr<ThreadPool::LoopState> ThreadPool::loopState(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(loopsMutex_);
+    std::shared_ptr<LoopState>& state = loops_[loop];
+    if(!state)
+    {
+        state = std::make_shared<LoopState>(name_);
+    }
+    return state;
+}
+
+// worker线程: 放入loop的完成队列，队列由空变非空时才投递一次flush
+void ThreadPool::complete(EventLoop* loop, Task done)
+{
+    std::shared_ptr<LoopState> state = loopState(loop);
+    bool queueFlush = false;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->completed.push_back(std::move(done));
+        if(!state->flushQueued)
+        {
+            state->flushQueued = true;
+            queueFlush = true;
+        }
+    }
+    if(queueFlush)
+    {
+        loop->queueInLoop(std::bind(&ThreadPool::flush, state));
+    }
+}
+
+void ThreadPool::flush(const std::shared_ptr<LoopState>& state)
+{
+    std::vector<Task> completed;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        completed.swap(state->completed);
+        state->flushQueued = false;
+    }
+    for(const Task& done : completed)
+    {
+        done();
+    }
+}
+
+// loop线程: 按提交顺序执行同一连接的完成回调
+void ThreadPool::completeInOrder(const std::shared_ptr<LoopState>& state, const TcpConnectionPtr& conn,
+                                 uint64_t seq, Task done)
+{
+    auto it = state->sequences.find(conn.get());
+    if(it == state->sequences.end())
+    {
+        LOG_ERROR("ThreadPool::completeInOrder [%s] unknown connection %s",
+                state->poolName.c_str(), conn->name().c_str());
+        return;
+    }
+    if(seq != it->second.nextComplete)
+    {
+        it->second.ready[seq] = std::move(done);
+        return;
+    }
+    Task task = std::move(done);
+    for(;;)
+    {
+        task();
+        // task中可能再次submit使sequences重新哈希，每次重新查找
+        it = state->sequences.find(conn.get());
+        Sequence& sequence = it->second;
+        ++sequence.nextComplete;
+        auto ready = sequence.ready.find(sequence.nextComplete);
+        if(ready == sequence.ready.end())
+        {
+            if(sequence.nextComplete == sequence.nextSubmit)
+            {
+                state->sequences.erase(it);
+            }
+            break;
+        }
+        task = std::move(ready->second);
+        sequence.ready.erase(ready);
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "const.h"
+#include "noncopyable.h"
+#include "Thread.h"
+#include "WorkStealingQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+class EventLoop;
+
+/**
+ * @brief ThreadPool
+ * 计算线程池，与IO线程(EventLoopThread)分开，把耗时的解析、压缩等从MessageCallback中挪出去
+ * 每个worker一个工作窃取队列，空闲worker从其它队列窃取
+ * 任务完成后，完成回调批量交回提交任务的EventLoop：一批完成回调只queueInLoop一次
+ *
+ *   pool.submit(conn, [data]() { return compress(data); },
+ *               [conn](std::string out) { conn->send(out); });
+ */
+class ThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    static const size_t kDefaultMaxQueueSize = 65536;
+
+    explicit ThreadPool(const std::string& nameArg = std::string("ThreadPool"));
+    ~ThreadPool();
+
+    /// Call before start().
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    /// 所有队列中等待的任务总数上限，超过后提交失败. 默认kDefaultMaxQueueSize，0表示不限制. Call before start().
+    void setMaxQueueSize(size_t maxSize) { maxQueueSize_ = maxSize; }
+
+    void start();
+    void stop();    // 执行完已提交的任务后退出，之后的提交返回false
+
+    const std::string& name() const { return name_; }
+    size_t queueSize() const { return queued_; }
+
+    /// 在worker线程执行task，队列已满或已stop()返回false. Thread safe.
+    bool run(Task task);
+
+    /// 在worker线程执行task，完成后在loop线程执行done. Thread safe.
+    bool submit(EventLoop* loop, Task task, Task done);
+
+    /// 同上，done在conn所属loop按提交顺序执行. 须在conn所属loop线程调用
+    bool submit(const TcpConnectionPtr& conn, Task task, Task done);
+
+    /// work的返回值交给done，Result须可默认构造. 返回void的work走上面的重载
+    template <typename Work, typename Done,
+              typename Result = decltype(std::declval<Work&>()()),
+              typename = typename std::enable_if<!std::is_void<Result>::value>::type>
+    bool submit(const TcpConnectionPtr& conn, Work work, Done done)
+    {
+        std::shared_ptr<Result> result = std::make_shared<Result>();
+        return submit(conn,
+                      Task([result, work]() mutable { *result = work(); }),
+                      Task([result, done]() mutable { done(std::move(*result)); }));
+    }
+
+private:
+    // 每个连接的完成序号，只在所属loop线程访问
+    struct Sequence
+    {
+        uint64_t nextSubmit = 0;
+        uint64_t nextComplete = 0;
+        std::map<uint64_t, Task> ready;     // 已完成但前面还有未完成的
+    };
+    // 每个EventLoop一个，收集worker完成的回调
+    // 投递到loop的flush和完成回调持有shared_ptr，ThreadPool先于loop析构时仍然有效
+    struct LoopState
+    {
+        explicit LoopState(const std::string& name) : poolName(name) {}
+
+        const std::string poolName;                     // 只用于日志
+        std::mutex mutex;
+        std::vector<Task> completed;                    // guarded by mutex
+        bool flushQueued = false;                       // guarded by mutex
+        std::unordered_map<TcpConnection*, Sequence> sequences;   // loop线程
+    };
+
+    void workerFunc(size_t index);
+    bool take(size_t index, Task& task);
+    bool push(Task task);
+    std::shared_ptr<LoopState> loopState(EventLoop* loop);
+    void complete(EventLoop* loop, Task done);
+    // 以下两个在loop线程中执行，不访问ThreadPool
+    static void flush(const std::shared_ptr<LoopState>& state);
+    static void completeInOrder(const std::shared_ptr<LoopState>& state, const TcpConnectionPtr& conn,
+                                uint64_t seq, Task done);
+
+    std::string name_;
+    int numThreads_;
+    size_t maxQueueSize_;
+    std::atomic_bool running_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::vector<std::unique_ptr<WorkStealingQueue<Task>>> queues_;
+    std::atomic<size_t> next_;      // 外部提交时轮流放入各worker队列
+
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::atomic<size_t> queued_;    // 所有队列中的任务数，在mutex_下先占位再入队，等待时在mutex_下检查
+
+    std::mutex loopsMutex_;
+    std::unordered_map<EventLoop*, std::shared_ptr<LoopState>> loops_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <typeinfo>
+
+// 定时器，由TimerQueue管理，interval > 0 时为周期定时器
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(++numCreated_)
+    {}
+
+    void run() const { callback_(); }
+    const std::type_info& callbackType() const { return callback_.target_type(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    void restart(Timestamp now);    // 周期定时器重新计算到期时间
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;     // 秒
+    const bool repeat_;
+    const int64_t sequence_;    // 区分地址被复用的Timer
+
+    static std::atomic<int64_t> numCreated_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+
+class EventLoop;
+class Timer;
+
+/**
+ * @brief
+ * 定时器队列，一个EventLoop一个
+ * 用timerfd把定时事件接入poller，按到期时间排序，timerfd总是设置为最早的到期时间
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    /// Thread safe.
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    /// Thread safe.
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    void handleRead();      // timerfd可读，处理到期定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    void reset(const std::vector<Entry>& expired, Timestamp now);
+    bool insert(Timer* timer);  // 返回是否成为最早到期的定时器
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;              // 按到期时间排序
+    ActiveTimerSet activeTimers_;   // 按Timer地址排序，与timers_保存同一批定时器
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;    // 回调执行期间被取消的周期定时器
+};
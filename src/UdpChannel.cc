@@ -0,0 +1,305 @@
+#include "UdpChannel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <netinet/udp.h>
+#include <string.h>
+
+#include <algorithm>
+
+static const int kMaxReadRounds = 8;            // 一次可读事件最多调用recvmmsg的次数, 避免饿死其他fd
+static const size_t kGroSlotSize = 64 * 1024;   // GRO合并后的报文最大64KB
+static const size_t kMaxGsoBytes = 60 * 1024;   // 一个GSO消息的总长度上限
+static const int kMaxGsoSegments = 64;          // 老内核UDP_MAX_SEGMENTS为64
+static const size_t kMaxGsoSegmentSize = 1472;  // 以太网MTU下不分片的最大UDP负载
+
+static int createNonblockingUdp()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("createNonblockingUdp: socket() failed, errno=%d (%s)", errno, strerror(errno));
+    }
+    return sockfd;
+}
+
+UdpChannel::UdpChannel(EventLoop* loop, const InetAddress& bindAddr, const Options& options)
+    : loop_(loop)
+    , socket_(createNonblockingUdp())
+    , channel_(loop, socket_.fd())
+    , batchSize_(options.batchSize)
+    , slotSize_(options.maxDatagramSize)
+    , gro_(false)
+    , gso_(false)
+    , sendUsed_(0)
+    , packetsReceived_(0)
+    , bytesReceived_(0)
+    , packetsSent_(0)
+    , recvSyscalls_(0)
+    , drops_(0)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(options.reusePort);
+    socket_.bindAddress(bindAddr);
+
+#ifdef UDP_GRO
+    int on = 1;
+    if(options.gro && ::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &on, sizeof on) == 0)
+    {
+        gro_ = true;
+        slotSize_ = kGroSlotSize;
+    }
+#endif
+#ifdef UDP_SEGMENT
+    // 设置0不改变行为, 只用来探测内核是否支持, 实际的段长随每个消息的cmsg传入
+    int zero = 0;
+    gso_ = options.gso && ::setsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &zero, sizeof zero) == 0;
+#endif
+
+    const size_t recvControlLen = CMSG_SPACE(sizeof(int));
+    recvSlab_.resize(batchSize_ * slotSize_);
+    recvMsgs_.resize(batchSize_);
+    recvIovecs_.resize(batchSize_);
+    recvAddrs_.resize(batchSize_);
+    recvControl_.resize(batchSize_ * recvControlLen);
+    for(int i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvSlab_[i * slotSize_];
+        recvIovecs_[i].iov_len = slotSize_;
+        msghdr& hdr = recvMsgs_[i].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &recvAddrs_[i];
+        hdr.msg_iov = &recvIovecs_[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    sendSlab_.resize(std::max(batchSize_ * options.maxDatagramSize, kMaxGsoBytes));
+    pendingSends_.reserve(batchSize_);
+    sendMsgs_.resize(batchSize_);
+    sendIovecs_.resize(batchSize_);
+    sendControl_.resize(batchSize_ * CMSG_SPACE(sizeof(uint16_t)));
+
+    channel_.setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+    LOG_INFO("UdpChannel bound to %s fd = %d gro = %d gso = %d",
+            bindAddr.toIpPort().c_str(), socket_.fd(), gro_, gso_);
+}
+
+UdpChannel::~UdpChannel()
+{
+    channel_.disableAll();
+    channel_.remove();
+}
+
+void UdpChannel::start()
+{
+    loop_->runInLoop([this]() { channel_.enableReading(); });
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    const size_t recvControlLen = CMSG_SPACE(sizeof(int));
+    for(int round = 0; round < kMaxReadRounds; ++round)
+    {
+        for(int i = 0; i < batchSize_; ++i)
+        {
+            msghdr& hdr = recvMsgs_[i].msg_hdr;
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_control = gro_ ? &recvControl_[i * recvControlLen] : nullptr;
+            hdr.msg_controllen = gro_ ? recvControlLen : 0;
+            hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        if(n < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpChannel::handleRead fd = %d recvmmsg errno = %d (%s)",
+                        socket_.fd(), errno, strerror(errno));
+            }
+            break;
+        }
+        addCounter(recvSyscalls_, 1);
+        for(int i = 0; i < n; ++i)
+        {
+            dispatch(i, receiveTime);
+        }
+        if(n < batchSize_)
+        {
+            break;      // 已读空
+        }
+    }
+    flush();
+}
+
+void UdpChannel::dispatch(int slot, Timestamp receiveTime)
+{
+    const msghdr& hdr = recvMsgs_[slot].msg_hdr;
+    size_t len = recvMsgs_[slot].msg_len;
+    if(hdr.msg_flags & MSG_TRUNC)
+    {
+        addCounter(drops_, 1);
+        return;
+    }
+    size_t segmentSize = len;
+#ifdef UDP_GRO
+    if(gro_)
+    {
+        for(cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm != nullptr; cm = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cm))
+        {
+            if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+            {
+                int gsoSize = 0;
+                ::memcpy(&gsoSize, CMSG_DATA(cm), sizeof gsoSize);
+                if(gsoSize > 0)
+                {
+                    segmentSize = gsoSize;
+                }
+            }
+        }
+    }
+#endif
+    const char* data = &recvSlab_[slot * slotSize_];
+    InetAddress peer(recvAddrs_[slot]);
+    size_t packets = 0;
+    size_t offset = 0;
+    do
+    {
+        size_t n = std::min(segmentSize, len - offset);
+        if(messageCallback_)
+        {
+            messageCallback_(this, peer, StringPiece(data + offset, n), receiveTime);
+        }
+        offset += n;
+        ++packets;
+    } while(offset < len);
+    addCounter(packetsReceived_, packets);
+    addCounter(bytesReceived_, len);
+}
+
+void UdpChannel::send(const InetAddress& peer, StringPiece datagram)
+{
+    const sockaddr_in& addr = *peer.getSockAddrInet();
+    size_t len = datagram.size();
+    if(len > sendSlab_.size())
+    {
+        LOG_ERROR("UdpChannel::send datagram of %zu bytes is too large", len);
+        addCounter(drops_, 1);
+        return;
+    }
+    if(!pendingSends_.empty() && gso_)
+    {
+        // 接在上一个发往同一对端的消息后面, 由内核按segmentSize切分
+        PendingSend& last = pendingSends_.back();
+        if(!last.lastShort
+            && last.segmentSize > 0
+            && len > 0 && len <= last.segmentSize
+            && last.segments < kMaxGsoSegments
+            && last.length + len <= kMaxGsoBytes
+            && last.offset + last.length == sendUsed_
+            && sendUsed_ + len <= sendSlab_.size()
+            && last.peer.sin_port == addr.sin_port
+            && last.peer.sin_addr.s_addr == addr.sin_addr.s_addr)
+        {
+            ::memcpy(&sendSlab_[sendUsed_], datagram.data(), len);
+            sendUsed_ += len;
+            last.length += len;
+            ++last.segments;
+            last.lastShort = len < last.segmentSize;
+            return;
+        }
+    }
+    if(static_cast<int>(pendingSends_.size()) == batchSize_ || sendUsed_ + len > sendSlab_.size())
+    {
+        flush();
+    }
+    PendingSend ps;
+    ps.peer = addr;
+    ps.offset = sendUsed_;
+    ps.length = len;
+    ps.segmentSize = (gso_ && len <= kMaxGsoSegmentSize) ? static_cast<uint16_t>(len) : 0;
+    ps.segments = 1;
+    ps.lastShort = false;
+    ::memcpy(&sendSlab_[sendUsed_], datagram.data(), len);
+    sendUsed_ += len;
+    pendingSends_.push_back(ps);
+}
+
+void UdpChannel::flush()
+{
+    int count = static_cast<int>(pendingSends_.size());
+    if(count == 0)
+    {
+        return;
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        PendingSend& ps = pendingSends_[i];
+        sendIovecs_[i].iov_base = &sendSlab_[ps.offset];
+        sendIovecs_[i].iov_len = ps.length;
+        msghdr& hdr = sendMsgs_[i].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &ps.peer;
+        hdr.msg_namelen = sizeof ps.peer;
+        hdr.msg_iov = &sendIovecs_[i];
+        hdr.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+        if(ps.segments > 1)
+        {
+            const size_t controlLen = CMSG_SPACE(sizeof(uint16_t));
+            hdr.msg_control = &sendControl_[i * controlLen];
+            hdr.msg_controllen = controlLen;
+            cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            ::memcpy(CMSG_DATA(cm), &ps.segmentSize, sizeof ps.segmentSize);
+        }
+#endif
+    }
+
+    int sent = 0;
+    uint64_t packets = 0;
+    while(sent < count)
+    {
+        int n = ::sendmmsg(socket_.fd(), &sendMsgs_[sent], count - sent, MSG_DONTWAIT);
+        if(n > 0)
+        {
+            for(int i = sent; i < sent + n; ++i)
+            {
+                packets += pendingSends_[i].segments;
+            }
+            sent += n;
+            continue;
+        }
+        if(errno == EINTR)
+        {
+            continue;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // UDP尽力而为, 发送缓冲区满时丢弃剩余的报文
+            for(int i = sent; i < count; ++i)
+            {
+                addCounter(drops_, pendingSends_[i].segments);
+            }
+            break;
+        }
+        if(errno == EIO && gso_ && pendingSends_[sent].segments > 1)
+        {
+            // 出口网卡不支持校验和卸载时GSO会失败, 之后不再合并
+            LOG_ERROR("UdpChannel::flush fd = %d UDP_SEGMENT failed, disabling GSO", socket_.fd());
+            gso_ = false;
+        }
+        else
+        {
+            LOG_ERROR("UdpChannel::flush fd = %d sendmmsg to %s errno = %d (%s)", socket_.fd(),
+                    InetAddress(pendingSends_[sent].peer).toIpPort().c_str(), errno, strerror(errno));
+        }
+        addCounter(drops_, pendingSends_[sent].segments);
+        ++sent;     // 跳过出错的消息
+    }
+    addCounter(packetsSent_, packets);
+    pendingSends_.clear();
+    sendUsed_ = 0;
+}
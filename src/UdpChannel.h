@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Channel.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "Socket.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <sys/socket.h>
+
+class EventLoop;
+class UdpChannel;
+
+/// datagram只在回调期间有效. 开启GRO时内核合并的报文已按原始边界拆开, 每个报文回调一次
+using UdpMessageCallback = std::function<void(UdpChannel* channel, const InetAddress& peer,
+                                              StringPiece datagram, Timestamp receiveTime)>;
+
+/**
+ * @brief 绑定在一个EventLoop上的UDP socket
+ * 可读时用recvmmsg批量收包到预先分配的slab中, 不逐包分配内存;
+ * 回复先攒在发送slab里, 一批收包处理完后用sendmmsg一次发出,
+ * 发往同一对端的等长报文合并成一个UDP_SEGMENT(GSO)消息.
+ * 除统计计数外只能在所属loop线程中使用
+ */
+class UdpChannel : noncopyable
+{
+public:
+    struct Options
+    {
+        int batchSize;              // recvmmsg/sendmmsg每次最多的报文数
+        size_t maxDatagramSize;     // 不开GRO时每个接收槽的大小, 超长的报文被截断丢弃
+        bool reusePort;             // 多个loop各自绑定同一端口, 由内核按四元组分散报文
+        bool gro;                   // 内核支持时开启UDP_GRO
+        bool gso;                   // 内核支持时回复使用UDP_SEGMENT
+        Options() : batchSize(64), maxDatagramSize(2048), reusePort(true), gro(true), gso(true) {}
+    };
+
+    UdpChannel(EventLoop* loop, const InetAddress& bindAddr, const Options& options = Options());
+    ~UdpChannel();
+
+    void setMessageCallback(const UdpMessageCallback& cb) { messageCallback_ = cb; }
+    /// 开始接收. Thread safe.
+    void start();
+
+    /// 排队一个发往peer的报文, 在本批收包处理完或发送slab满时发出. 只能在loop线程中调用
+    void send(const InetAddress& peer, StringPiece datagram);
+    /// 立即发出排队的报文, 在收包回调之外发送时调用
+    void flush();
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    bool groEnabled() const { return gro_; }
+    bool gsoEnabled() const { return gso_; }
+
+    // 统计, 任意线程可读
+    uint64_t packetsReceived() const { return packetsReceived_.load(std::memory_order_relaxed); }
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
+    uint64_t packetsSent() const { return packetsSent_.load(std::memory_order_relaxed); }
+    uint64_t recvSyscalls() const { return recvSyscalls_.load(std::memory_order_relaxed); }
+    uint64_t drops() const { return drops_.load(std::memory_order_relaxed); }   // 截断和发送失败
+
+private:
+    struct PendingSend
+    {
+        sockaddr_in peer;
+        size_t offset;          // 在sendSlab_中的位置
+        size_t length;          // 总字节数
+        uint16_t segmentSize;   // 合并多个报文时每段的长度
+        int segments;
+        bool lastShort;         // 最后一段短于segmentSize, 之后不能再合并
+    };
+
+    void handleRead(Timestamp receiveTime);
+    void dispatch(int slot, Timestamp receiveTime);
+    static void addCounter(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    EventLoop* loop_;
+    Socket socket_;
+    Channel channel_;
+    UdpMessageCallback messageCallback_;
+    const int batchSize_;
+    size_t slotSize_;
+    bool gro_;
+    bool gso_;
+
+    // 接收slab: batchSize_个槽, 与mmsghdr等一起在构造时分配, 之后复用
+    std::vector<char> recvSlab_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovecs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<char> recvControl_;
+
+    std::vector<char> sendSlab_;
+    size_t sendUsed_;
+    std::vector<PendingSend> pendingSends_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovecs_;
+    std::vector<char> sendControl_;
+
+    std::atomic<uint64_t> packetsReceived_;
+    std::atomic<uint64_t> bytesReceived_;
+    std::atomic<uint64_t> packetsSent_;
+    std::atomic<uint64_t> recvSyscalls_;
+    std::atomic<uint64_t> drops_;
+};
@@ -0,0 +1,58 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <future>
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg)
+    : loop_(loop)
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , threadPool_(new EventLoopThreadPool(loop, nameArg))
+    , started_(0)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    // UdpChannel须在所属loop线程中注销, subloop在threadPool_析构时才退出
+    for(std::unique_ptr<UdpChannel>& channel : channels_)
+    {
+        std::promise<void> destroyed;
+        channel->getLoop()->runInLoop([&channel, &destroyed]() {
+            channel.reset();
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+    }
+}
+
+void UdpServer::start()
+{
+    if(started_++ != 0)
+    {
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    if(loops.size() > 1 && !options_.reusePort)
+    {
+        LOG_FATAL("UdpServer[%s] needs SO_REUSEPORT to run on %zu loops", name_.c_str(), loops.size());
+    }
+    channels_.resize(loops.size());
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        std::promise<void> created;
+        EventLoop* ioLoop = loops[i];
+        std::unique_ptr<UdpChannel>* slot = &channels_[i];
+        ioLoop->runInLoop([this, ioLoop, slot, &created]() {
+            slot->reset(new UdpChannel(ioLoop, listenAddr_, options_));
+            (*slot)->setMessageCallback(messageCallback_);
+            (*slot)->start();
+            created.set_value();
+        });
+        created.get_future().wait();
+    }
+    LOG_INFO("UdpServer[%s] listening on %s with %zu loops, gro = %d gso = %d", name_.c_str(),
+            listenAddr_.toIpPort().c_str(), loops.size(), channels_[0]->groEnabled(), channels_[0]->gsoEnabled());
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "UdpChannel.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief UDP服务端, 每个loop一个绑定同一端口的UdpChannel(SO_REUSEPORT),
+ * 由内核按四元组把报文分散到各loop, loop之间不共享任何状态.
+ * 回复在收到请求的UdpChannel上发送: channel->send(peer, data)
+ */
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg);
+    ~UdpServer();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
+    /// 为0时只在loop上收发. Call before start().
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    /// 批量大小、GRO/GSO等, 见UdpChannel::Options. Call before start().
+    void setOptions(const UdpChannel::Options& options) { options_ = options; }
+    /// Set message callback. Not thread safe.
+    void setMessageCallback(const UdpMessageCallback& cb) { messageCallback_ = cb; }
+
+    /// 在每个loop线程中创建UdpChannel, 接收slab在本线程首次写入. Call in loop thread.
+    void start();
+
+    /// 各loop的UdpChannel, 用于读取统计. start()之后有效
+    const std::vector<std::unique_ptr<UdpChannel>>& channels() const { return channels_; }
+
+private:
+    EventLoop* loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpChannel::Options options_;
+    UdpMessageCallback messageCallback_;
+    std::atomic_int started_;
+    std::vector<std::unique_ptr<UdpChannel>> channels_;     // 与threadPool_->getAllLoops()一一对应
+};
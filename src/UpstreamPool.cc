@@ -0,0 +1,334 @@
+#include "UpstreamPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+
+#include <assert.h>
+#include <string.h>
+
+struct UpstreamPool::Member
+{
+    enum State { kConnecting, kIdle, kBusy, kClosed };
+
+    Upstream* upstream;
+    std::unique_ptr<TcpClient> client;
+    TcpConnectionPtr conn;                  // 建立后非空
+    State state;
+    std::list<Member*>::iterator idlePos;   // state为kIdle时有效
+    uint64_t lease;                         // 每次借出加一
+    MessageCallback onMessage;              // 以下借出期间有效
+    ConnectionCallback onClose;
+};
+
+struct UpstreamPool::Waiter
+{
+    uint64_t id;
+    CheckoutCallback callback;
+    MessageCallback onMessage;
+    ConnectionCallback onClose;
+    TimerId timer;
+    bool hasTimer;
+};
+
+struct UpstreamPool::Upstream
+{
+    explicit Upstream(const InetAddress& a, const Options& o) : addr(a), options(o), connecting(0) {}
+
+    const InetAddress addr;
+    Options options;
+    std::unordered_map<Member*, std::unique_ptr<Member>> members;
+    std::list<Member*> idle;        // 前端是最近归还的, 最可能仍然有效
+    std::list<Waiter> waiters;      // 先到先得
+    int connecting;
+};
+
+UpstreamPool::UpstreamPool(EventLoop* loop)
+    : loop_(loop)
+    , nextWaiterId_(0)
+{
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    for(auto& entry : upstreams_)
+    {
+        for(Waiter& w : entry.second->waiters)
+        {
+            if(w.hasTimer)
+            {
+                loop_->cancel(w.timer);
+            }
+        }
+    }
+    // Member析构时TcpClient换下连接上绑定了this的回调
+}
+
+std::string UpstreamPool::keyOf(const InetAddress& addr)
+{
+    if(addr.isUnix())
+    {
+        return "u" + addr.toIp();
+    }
+    const sockaddr_in* sa = addr.getSockAddrInet();
+    char key[1 + sizeof sa->sin_addr + sizeof sa->sin_port];
+    key[0] = 'i';
+    memcpy(key + 1, &sa->sin_addr, sizeof sa->sin_addr);
+    memcpy(key + 1 + sizeof sa->sin_addr, &sa->sin_port, sizeof sa->sin_port);
+    return std::string(key, sizeof key);
+}
+
+UpstreamPool::Upstream* UpstreamPool::getUpstream(const InetAddress& addr)
+{
+    std::unique_ptr<Upstream>& up = upstreams_[keyOf(addr)];
+    if(!up)
+    {
+        up.reset(new Upstream(addr, defaultOptions_));
+    }
+    return up.get();
+}
+
+void UpstreamPool::setOptions(const InetAddress& addr, const Options& options)
+{
+    Upstream* up = getUpstream(addr);
+    up->options = options;
+    fill(up);
+}
+
+void UpstreamPool::checkout(const InetAddress& addr, const CheckoutCallback& cb, const MessageCallback& onMessage,
+                            const ConnectionCallback& onClose)
+{
+    Upstream* up = getUpstream(addr);
+    Waiter w;
+    w.id = ++nextWaiterId_;
+    w.callback = cb;
+    w.onMessage = onMessage;
+    w.onClose = onClose;
+    while(!up->idle.empty())
+    {
+        Member* m = up->idle.front();
+        up->idle.pop_front();
+        if(m->conn->connected())
+        {
+            handOut(m, w);
+            fill(up);
+            return;
+        }
+        destroyMember(m);   // 已断开, 断开通知还在路上
+    }
+
+    w.hasTimer = up->options.checkoutTimeout > 0;
+    if(w.hasTimer)
+    {
+        w.timer = loop_->runAfter(up->options.checkoutTimeout,
+                std::bind(&UpstreamPool::onCheckoutTimeout, this, up, w.id));
+    }
+    up->waiters.push_back(std::move(w));
+    fill(up);
+}
+
+void UpstreamPool::release(const TcpConnectionPtr& conn, bool reusable)
+{
+    auto it = busy_.find(conn.get());
+    if(it == busy_.end())
+    {
+        LOG_ERROR("UpstreamPool::release [%s] is not checked out", conn->name().c_str());
+        return;
+    }
+    Member* m = it->second;
+    busy_.erase(it);
+    Upstream* up = m->upstream;
+    if(!reusable || !conn->connected())
+    {
+        destroyMember(m);
+        fill(up);
+    }
+    else if(!up->waiters.empty())
+    {
+        Waiter w = std::move(up->waiters.front());
+        up->waiters.pop_front();
+        if(w.hasTimer)
+        {
+            loop_->cancel(w.timer);
+        }
+        handOut(m, w);
+    }
+    else if(static_cast<int>(up->idle.size()) >= up->options.maxIdle)
+    {
+        destroyMember(m);
+    }
+    else
+    {
+        makeIdle(m);
+    }
+}
+
+size_t UpstreamPool::idleCount(const InetAddress& addr) const
+{
+    auto it = upstreams_.find(keyOf(addr));
+    return it == upstreams_.end() ? 0 : it->second->idle.size();
+}
+
+size_t UpstreamPool::connectionCount(const InetAddress& addr) const
+{
+    auto it = upstreams_.find(keyOf(addr));
+    return it == upstreams_.end() ? 0 : it->second->members.size();
+}
+
+// 建立中和空闲的连接补足到 minIdle + 等待者数, 不超过maxConnections
+void UpstreamPool::fill(Upstream* up)
+{
+    const Options& opts = up->options;
+    size_t want = static_cast<size_t>(opts.minIdle) + up->waiters.size();
+    size_t have = up->idle.size() + up->connecting;
+    while(have < want
+        && (opts.maxConnections <= 0 || up->members.size() < static_cast<size_t>(opts.maxConnections)))
+    {
+        openConnection(up);
+        ++have;
+    }
+}
+
+void UpstreamPool::openConnection(Upstream* up)
+{
+    std::unique_ptr<Member> m(new Member);
+    m->upstream = up;
+    m->state = Member::kConnecting;
+    m->lease = 0;
+    m->client.reset(new TcpClient(loop_, up->addr, "upstream"));
+    m->client->setRetryDelay(up->options.retryDelayMs, Connector::kMaxRetryDelayMs);
+    m->client->setConnectionCallback(
+        std::bind(&UpstreamPool::onConnection, this, m.get(), std::placeholders::_1));
+    m->client->setMessageCallback(std::bind(&UpstreamPool::onMessage, this, m.get(),
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    Member* p = m.get();
+    up->members[p] = std::move(m);
+    ++up->connecting;
+    p->client->connect();
+}
+
+void UpstreamPool::onConnection(Member* m, const TcpConnectionPtr& conn)
+{
+    if(m->state == Member::kClosed)
+    {
+        return;     // 等待析构, TcpClient析构时会关闭连接
+    }
+    Upstream* up = m->upstream;
+    if(conn->connected())
+    {
+        assert(m->state == Member::kConnecting);
+        --up->connecting;
+        m->conn = conn;
+        conn->setTcpNoDelay(true);
+        if(!up->waiters.empty())
+        {
+            Waiter w = std::move(up->waiters.front());
+            up->waiters.pop_front();
+            if(w.hasTimer)
+            {
+                loop_->cancel(w.timer);
+            }
+            handOut(m, w);
+        }
+        else
+        {
+            makeIdle(m);
+        }
+        return;
+    }
+
+    // 连接断开(对端关闭或RST), 立即换一条新连接补上
+    ConnectionCallback onClose;
+    if(m->state == Member::kIdle)
+    {
+        up->idle.erase(m->idlePos);
+    }
+    else if(m->state == Member::kBusy)
+    {
+        busy_.erase(conn.get());
+        onClose.swap(m->onClose);
+    }
+    destroyMember(m);
+    fill(up);
+    if(onClose)
+    {
+        onClose(conn);
+    }
+}
+
+void UpstreamPool::onMessage(Member* m, const TcpConnectionPtr& conn, Buffer* input, Timestamp receiveTime)
+{
+    if(m->state != Member::kBusy)
+    {
+        // 空闲连接不应收到数据, 收到说明协议状态已乱, 关闭它
+        LOG_ERROR("UpstreamPool::onMessage idle connection [%s] received %zu bytes, closing",
+                conn->name().c_str(), input->readableBytes());
+        input->retrieveAll();
+        conn->shutdown();
+        return;
+    }
+    // 使用者可能在回调中归还连接甚至再次借出, 回调执行期间先移出来, 同一次借出时再放回
+    uint64_t lease = m->lease;
+    MessageCallback cb;
+    cb.swap(m->onMessage);
+    if(!cb)
+    {
+        input->retrieveAll();
+        return;
+    }
+    cb(conn, input, receiveTime);
+    if(m->state == Member::kBusy && m->lease == lease)
+    {
+        m->onMessage.swap(cb);
+    }
+}
+
+void UpstreamPool::makeIdle(Member* m)
+{
+    m->state = Member::kIdle;
+    m->onMessage = MessageCallback();
+    m->onClose = ConnectionCallback();
+    Upstream* up = m->upstream;
+    up->idle.push_front(m);
+    m->idlePos = up->idle.begin();
+}
+
+void UpstreamPool::handOut(Member* m, Waiter& w)
+{
+    m->state = Member::kBusy;
+    ++m->lease;
+    m->onMessage.swap(w.onMessage);
+    m->onClose.swap(w.onClose);
+    busy_[m->conn.get()] = m;
+    w.callback(m->conn);
+}
+
+// 可能在m自己的TcpClient回调中调用, 析构推迟到本轮事件之后
+void UpstreamPool::destroyMember(Member* m)
+{
+    Upstream* up = m->upstream;
+    if(m->state == Member::kConnecting)
+    {
+        --up->connecting;
+    }
+    m->state = Member::kClosed;
+    auto it = up->members.find(m);
+    std::shared_ptr<Member> dead(it->second.release());
+    up->members.erase(it);
+    loop_->queueInLoop([dead]() {});
+}
+
+void UpstreamPool::onCheckoutTimeout(Upstream* up, uint64_t waiterId)
+{
+    for(auto it = up->waiters.begin(); it != up->waiters.end(); ++it)
+    {
+        if(it->id == waiterId)
+        {
+            CheckoutCallback cb = std::move(it->callback);
+            up->waiters.erase(it);
+            cb(TcpConnectionPtr());
+            return;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "noncopyable.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class EventLoop;
+class TcpClient;
+
+/**
+ * @brief 每个EventLoop一个的上游连接池, 按InetAddress区分上游, 通过EventLoop::upstreamPool()获取
+ * 只在所属loop线程中使用, 不加锁. 空闲连接按后进先出复用, 借出和归还都是O(1);
+ * 空闲连接断开时立即移出并按minIdle补建, 借到的连接已断开时换下一条或新建一条
+ */
+class UpstreamPool : noncopyable
+{
+public:
+    /// conn为空表示在checkoutTimeout内没有拿到连接
+    using CheckoutCallback = std::function<void(const TcpConnectionPtr& conn)>;
+
+    struct Options
+    {
+        int minIdle;            // 保持的最少空闲连接数, 不足时后台补建
+        int maxIdle;            // 归还后空闲连接超过此数则关闭归还的连接
+        int maxConnections;     // 连接总数上限(含借出和建立中), 0表示不限
+        double checkoutTimeout; // 等待连接的秒数, <= 0表示一直等待
+        int retryDelayMs;       // 连接失败后的首次重试间隔, 之后指数退避
+        Options() : minIdle(0), maxIdle(8), maxConnections(0), checkoutTimeout(1.0), retryDelayMs(100) {}
+    };
+
+    explicit UpstreamPool(EventLoop* loop);
+    ~UpstreamPool();
+
+    /// 未设置的上游使用默认Options
+    void setDefaultOptions(const Options& options) { defaultOptions_ = options; }
+    /// 设置上游的Options并立即预建minIdle条连接
+    void setOptions(const InetAddress& addr, const Options& options);
+
+    /// 借出一条已建立的连接, 有空闲连接时cb在本次调用中执行.
+    /// 借出期间连接上的数据交给onMessage, 连接断开时调用onClose(如果设置).
+    /// 连接的回调由连接池持有, 使用者不要直接设置
+    void checkout(const InetAddress& addr, const CheckoutCallback& cb, const MessageCallback& onMessage,
+                  const ConnectionCallback& onClose = ConnectionCallback());
+    /// 归还借出的连接, 可以在onMessage中调用. reusable为false(例如协议状态已乱)时直接关闭
+    void release(const TcpConnectionPtr& conn, bool reusable = true);
+
+    size_t idleCount(const InetAddress& addr) const;
+    size_t connectionCount(const InetAddress& addr) const;
+
+private:
+    struct Upstream;
+    struct Member;
+    struct Waiter;
+
+    Upstream* getUpstream(const InetAddress& addr);
+    void fill(Upstream* up);
+    void openConnection(Upstream* up);
+    void onConnection(Member* m, const TcpConnectionPtr& conn);
+    void onMessage(Member* m, const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void makeIdle(Member* m);
+    void handOut(Member* m, Waiter& w);
+    void destroyMember(Member* m);
+    void onCheckoutTimeout(Upstream* up, uint64_t waiterId);
+
+    /// 地址族加地址本身，不同上游的键一定不同; IPv4的键在SSO范围内，不分配内存
+    static std::string keyOf(const InetAddress& addr);
+
+    EventLoop* loop_;
+    Options defaultOptions_;
+    std::unordered_map<std::string, std::unique_ptr<Upstream>> upstreams_;
+    std::unordered_map<TcpConnection*, Member*> busy_;     // 借出中的连接
+    uint64_t nextWaiterId_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <deque>
+#include <mutex>
+
+/**
+ * @brief
+ * 工作窃取队列，每个工作线程一个
+ * 所属线程从头部取最早的任务，空闲的其它线程从尾部窃取
+ * 两端在不同位置，竞争只发生在队列很短时，用一把小锁保护即可
+ */
+template <typename T>
+class WorkStealingQueue : noncopyable
+{
+public:
+    WorkStealingQueue() = default;
+
+    void push(T item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deque_.push_back(std::move(item));
+    }
+
+    // 所属线程调用
+    bool pop(T& item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(deque_.empty())
+        {
+            return false;
+        }
+        item = std::move(deque_.front());
+        deque_.pop_front();
+        return true;
+    }
+
+    // 其它线程调用
+    bool steal(T& item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(deque_.empty())
+        {
+            return false;
+        }
+        item = std::move(deque_.back());
+        deque_.pop_back();
+        return true;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return deque_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::deque<T> deque_;
+};